@@ -0,0 +1,891 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "acct_common.h"
+#include "acct_index.h"
+
+static int map_file(struct acct_file *f, const char *path)
+{
+	struct stat st;
+	void *p;
+
+	f->data = NULL;
+	f->size = 0;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+	f->dev = st.st_dev;
+	f->ino = st.st_ino;
+	f->mtime = st.st_mtim;
+
+	// mmap() refuses empty files; an empty database is still valid
+	if (st.st_size == 0) {
+		close(fd);
+		f->data = "";
+		return 0;
+	}
+
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return -1;
+	}
+	f->data = p;
+	f->size = st.st_size;
+	return 0;
+}
+
+static void unmap_file(struct acct_file *f)
+{
+	if (f->data && f->size > 0) {
+		munmap((void *)f->data, f->size);
+	}
+	memset(f, 0, sizeof(*f));
+}
+
+int acct_open(struct acct_db *db, int which)
+{
+	int ret = 0;
+
+	memset(db, 0, sizeof(*db));
+#ifndef ACCT_NSS
+	// The index only covers the flat files, so NSS builds never use it
+	if (which & ACCT_INDEX) {
+		db->index = acct_index_open(ACCT_INDEX_FILE);
+		if (db->index)
+			which &= ~(ACCT_PASSWD | ACCT_GROUP);
+	}
+#endif
+	if ((which & ACCT_PASSWD) && map_file(&db->passwd, ACCT_PASSWD_FILE) < 0)
+		ret = -1;
+	if ((which & ACCT_GROUP) && map_file(&db->group, ACCT_GROUP_FILE) < 0)
+		ret = -1;
+	if ((which & ACCT_SHADOW) && map_file(&db->shadow, ACCT_SHADOW_FILE) < 0)
+		ret = -1;
+	return ret;
+}
+
+void acct_close(struct acct_db *db)
+{
+	unmap_file(&db->passwd);
+	unmap_file(&db->group);
+	unmap_file(&db->shadow);
+	acct_index_close(db->index);
+	db->index = NULL;
+}
+
+void acct_iter_init(struct acct_iter *it, const struct acct_file *f)
+{
+	it->pos = f->data;
+	it->end = f->data ? f->data + f->size : NULL;
+}
+
+/*
+ * Return the next line that can hold an entry, skipping blank lines,
+ * comments and NIS compat (+/-) lines like the glibc files backend.
+ */
+static int next_line(struct acct_iter *it, const char **start,
+		     const char **end)
+{
+	while (it->pos && it->pos < it->end) {
+		const char *s = it->pos;
+		const char *nl = memchr(s, '\n', it->end - s);
+		const char *e = nl ? nl : it->end;
+
+		it->pos = nl ? nl + 1 : it->end;
+		if (s == e || *s == '#' || *s == '+' || *s == '-') {
+			continue;
+		}
+		*start = s;
+		*end = e;
+		return 1;
+	}
+	return 0;
+}
+
+// Split a line on ':'; returns the number of fields found
+static int split_fields(const char *s, const char *end, struct acct_str *f,
+			int max)
+{
+	int n = 0;
+
+	for (;;) {
+		const char *c = memchr(s, ':', end - s);
+		const char *e = c ? c : end;
+
+		if (n < max) {
+			f[n].s = s;
+			f[n].len = e - s;
+		}
+		n++;
+		if (!c) {
+			return n;
+		}
+		s = c + 1;
+	}
+}
+
+static int parse_id(const struct acct_str *f, unsigned long *out)
+{
+	unsigned long v = 0;
+
+	if (f->len == 0 || f->len > 10) {
+		return -1;
+	}
+	for (size_t i = 0; i < f->len; i++) {
+		if (f->s[i] < '0' || f->s[i] > '9') {
+			return -1;
+		}
+		v = v * 10 + (f->s[i] - '0');
+	}
+	if (v > 0xffffffffUL) {
+		return -1;
+	}
+	*out = v;
+	return 0;
+}
+
+// Shadow numeric fields: empty means "not set" and reads as -1
+static int parse_long(const struct acct_str *f, long *out)
+{
+	long v = 0;
+	size_t i = 0;
+	int neg = 0;
+
+	if (f->len == 0) {
+		*out = -1;
+		return 0;
+	}
+	if (f->s[0] == '-') {
+		neg = 1;
+		i = 1;
+	}
+	if (i == f->len || f->len > 19) {
+		return -1;
+	}
+	for (; i < f->len; i++) {
+		if (f->s[i] < '0' || f->s[i] > '9') {
+			return -1;
+		}
+		v = v * 10 + (f->s[i] - '0');
+	}
+	*out = neg ? -v : v;
+	return 0;
+}
+
+int acct_next_pw(struct acct_iter *it, struct acct_pwent *e)
+{
+	const char *s, *end;
+	struct acct_str f[7];
+	unsigned long uid, gid;
+
+	while (next_line(it, &s, &end)) {
+		if (split_fields(s, end, f, 7) != 7 || f[0].len == 0 ||
+		    parse_id(&f[2], &uid) < 0 || parse_id(&f[3], &gid) < 0) {
+			continue;
+		}
+		e->name = f[0];
+		e->passwd = f[1];
+		e->uid = uid;
+		e->gid = gid;
+		e->gecos = f[4];
+		e->dir = f[5];
+		e->shell = f[6];
+		return 1;
+	}
+	return 0;
+}
+
+int acct_next_gr(struct acct_iter *it, struct acct_grent *e)
+{
+	const char *s, *end;
+	struct acct_str f[4];
+	unsigned long gid;
+
+	while (next_line(it, &s, &end)) {
+		if (split_fields(s, end, f, 4) != 4 || f[0].len == 0 ||
+		    parse_id(&f[2], &gid) < 0) {
+			continue;
+		}
+		e->name = f[0];
+		e->passwd = f[1];
+		e->gid = gid;
+		e->mem = f[3];
+		return 1;
+	}
+	return 0;
+}
+
+int acct_next_sp(struct acct_iter *it, struct acct_spent *e)
+{
+	const char *s, *end;
+	struct acct_str f[9];
+	long flag;
+
+	while (next_line(it, &s, &end)) {
+		if (split_fields(s, end, f, 9) != 9 || f[0].len == 0 ||
+		    parse_long(&f[2], &e->lstchg) < 0 ||
+		    parse_long(&f[3], &e->min) < 0 ||
+		    parse_long(&f[4], &e->max) < 0 ||
+		    parse_long(&f[5], &e->warn) < 0 ||
+		    parse_long(&f[6], &e->inact) < 0 ||
+		    parse_long(&f[7], &e->expire) < 0 ||
+		    parse_long(&f[8], &flag) < 0) {
+			continue;
+		}
+		e->name = f[0];
+		e->pwdp = f[1];
+		e->flag = f[8].len ? (unsigned long)flag : ~0UL;
+		return 1;
+	}
+	return 0;
+}
+
+uint32_t acct_hash(const char *s, size_t len)
+{
+	uint32_t h = 2166136261u;	// FNV-1a
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+int acct_str_eq(const struct acct_str *f, const char *s)
+{
+	return strncmp(f->s, s, f->len) == 0 && s[f->len] == '\0';
+}
+
+int acct_has_member(const struct acct_grent *e, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p = e->mem.s;
+	const char *end = e->mem.s + e->mem.len;
+
+	// Search the whole list at once, then check the match is a full name
+	while (len > 0 && (size_t)(end - p) >= len) {
+		const char *m = memmem(p, end - p, name, len);
+		if (!m) {
+			return 0;
+		}
+		if ((m == e->mem.s || m[-1] == ',') &&
+		    (m + len == end || m[len] == ',')) {
+			return 1;
+		}
+		p = m + 1;
+	}
+	return 0;
+}
+
+static char *copy_str(char **dst, const struct acct_str *f)
+{
+	char *s = *dst;
+
+	memcpy(s, f->s, f->len);
+	s[f->len] = '\0';
+	*dst += f->len + 1;
+	return s;
+}
+
+struct passwd *acct_pw_dup(const struct acct_pwent *e)
+{
+	size_t need = sizeof(struct passwd) + e->name.len + e->passwd.len +
+	    e->gecos.len + e->dir.len + e->shell.len + 5;
+	struct passwd *pw = malloc(need);
+	if (!pw) {
+		return NULL;
+	}
+
+	char *p = (char *)(pw + 1);
+	pw->pw_name = copy_str(&p, &e->name);
+	pw->pw_passwd = copy_str(&p, &e->passwd);
+	pw->pw_uid = e->uid;
+	pw->pw_gid = e->gid;
+	pw->pw_gecos = copy_str(&p, &e->gecos);
+	pw->pw_dir = copy_str(&p, &e->dir);
+	pw->pw_shell = copy_str(&p, &e->shell);
+	return pw;
+}
+
+struct group *acct_gr_dup(const struct acct_grent *e)
+{
+	size_t nmem = 0;
+
+	if (e->mem.len > 0) {
+		nmem = 1;
+		for (size_t i = 0; i < e->mem.len; i++) {
+			if (e->mem.s[i] == ',')
+				nmem++;
+		}
+	}
+
+	size_t need = sizeof(struct group) + (nmem + 1) * sizeof(char *) +
+	    e->name.len + e->passwd.len + e->mem.len + 3;
+	struct group *gr = malloc(need);
+	if (!gr) {
+		return NULL;
+	}
+
+	char **mem = (char **)(gr + 1);
+	char *p = (char *)(mem + nmem + 1);
+	gr->gr_name = copy_str(&p, &e->name);
+	gr->gr_passwd = copy_str(&p, &e->passwd);
+	gr->gr_gid = e->gid;
+	gr->gr_mem = mem;
+
+	// Copy the member list once, then cut it at the commas
+	char *m = copy_str(&p, &e->mem);
+	for (size_t i = 0; i < nmem; i++) {
+		mem[i] = m;
+		m = strchr(m, ',');
+		if (m)
+			*m++ = '\0';
+	}
+	mem[nmem] = NULL;
+	return gr;
+}
+
+struct spwd *acct_sp_dup(const struct acct_spent *e)
+{
+	struct spwd *sp = malloc(sizeof(struct spwd) + e->name.len +
+				 e->pwdp.len + 2);
+	if (!sp) {
+		return NULL;
+	}
+
+	char *p = (char *)(sp + 1);
+	sp->sp_namp = copy_str(&p, &e->name);
+	sp->sp_pwdp = copy_str(&p, &e->pwdp);
+	sp->sp_lstchg = e->lstchg;
+	sp->sp_min = e->min;
+	sp->sp_max = e->max;
+	sp->sp_warn = e->warn;
+	sp->sp_inact = e->inact;
+	sp->sp_expire = e->expire;
+	sp->sp_flag = e->flag;
+	return sp;
+}
+
+static struct acct_str str_of(const char *s)
+{
+	struct acct_str f = { s ? s : "", s ? strlen(s) : 0 };
+	return f;
+}
+
+void acct_pw_view(const struct passwd *pw, struct acct_pwent *e)
+{
+	e->name = str_of(pw->pw_name);
+	e->passwd = str_of(pw->pw_passwd);
+	e->uid = pw->pw_uid;
+	e->gid = pw->pw_gid;
+	e->gecos = str_of(pw->pw_gecos);
+	e->dir = str_of(pw->pw_dir);
+	e->shell = str_of(pw->pw_shell);
+}
+
+void acct_sp_view(const struct spwd *sp, struct acct_spent *e)
+{
+	e->name = str_of(sp->sp_namp);
+	e->pwdp = str_of(sp->sp_pwdp);
+	e->lstchg = sp->sp_lstchg;
+	e->min = sp->sp_min;
+	e->max = sp->sp_max;
+	e->warn = sp->sp_warn;
+	e->inact = sp->sp_inact;
+	e->expire = sp->sp_expire;
+	e->flag = sp->sp_flag;
+}
+
+#ifdef ACCT_NSS
+static struct passwd *nss_pw_dup(const struct passwd *pw)
+{
+	struct acct_pwent e;
+
+	if (!pw) {
+		return NULL;
+	}
+	acct_pw_view(pw, &e);
+	return acct_pw_dup(&e);
+}
+
+static struct group *nss_gr_dup(const struct group *gr)
+{
+	struct acct_grent e;
+
+	if (!gr) {
+		return NULL;
+	}
+	// Members are dropped; callers of the point lookups only need name/gid
+	e.name = str_of(gr->gr_name);
+	e.passwd = str_of(gr->gr_passwd);
+	e.gid = gr->gr_gid;
+	e.mem = str_of(NULL);
+	return acct_gr_dup(&e);
+}
+
+static struct spwd *nss_sp_dup(const struct spwd *sp)
+{
+	struct acct_spent e;
+
+	if (!sp) {
+		return NULL;
+	}
+	acct_sp_view(sp, &e);
+	return acct_sp_dup(&e);
+}
+#endif
+
+struct passwd *acct_getpwnam(const struct acct_db *db, const char *name)
+{
+	struct acct_iter it;
+	struct acct_pwent e;
+
+	acct_iter_init(&it, &db->passwd);
+	while (acct_next_pw(&it, &e)) {
+		if (acct_str_eq(&e.name, name)) {
+			return acct_pw_dup(&e);
+		}
+	}
+#ifdef ACCT_NSS
+	return nss_pw_dup(getpwnam(name));
+#else
+	return NULL;
+#endif
+}
+
+struct passwd *acct_getpwuid(const struct acct_db *db, uid_t uid)
+{
+	struct acct_iter it;
+	struct acct_pwent e;
+
+	acct_iter_init(&it, &db->passwd);
+	while (acct_next_pw(&it, &e)) {
+		if (e.uid == uid) {
+			return acct_pw_dup(&e);
+		}
+	}
+#ifdef ACCT_NSS
+	return nss_pw_dup(getpwuid(uid));
+#else
+	return NULL;
+#endif
+}
+
+struct group *acct_getgrnam(const struct acct_db *db, const char *name)
+{
+	struct acct_iter it;
+	struct acct_grent e;
+
+	acct_iter_init(&it, &db->group);
+	while (acct_next_gr(&it, &e)) {
+		if (acct_str_eq(&e.name, name)) {
+			return acct_gr_dup(&e);
+		}
+	}
+#ifdef ACCT_NSS
+	return nss_gr_dup(getgrnam(name));
+#else
+	return NULL;
+#endif
+}
+
+struct group *acct_getgrgid(const struct acct_db *db, gid_t gid)
+{
+	struct acct_iter it;
+	struct acct_grent e;
+
+	acct_iter_init(&it, &db->group);
+	while (acct_next_gr(&it, &e)) {
+		if (e.gid == gid) {
+			return acct_gr_dup(&e);
+		}
+	}
+#ifdef ACCT_NSS
+	return nss_gr_dup(getgrgid(gid));
+#else
+	return NULL;
+#endif
+}
+
+struct spwd *acct_getspnam(const struct acct_db *db, const char *name)
+{
+	struct acct_iter it;
+	struct acct_spent e;
+
+	acct_iter_init(&it, &db->shadow);
+	while (acct_next_sp(&it, &e)) {
+		if (acct_str_eq(&e.name, name)) {
+			return acct_sp_dup(&e);
+		}
+	}
+#ifdef ACCT_NSS
+	return nss_sp_dup(getspnam(name));
+#else
+	return NULL;
+#endif
+}
+
+int acct_getgrouplist(const struct acct_db *db, const char *user, gid_t group,
+		      gid_t **groups, int *ngroups)
+{
+#ifdef ACCT_NSS
+	// Memberships may live in any NSS source, so ask NSS for all of them
+	int n = 0;
+	gid_t *list = NULL;
+
+	(void)db;
+	getgrouplist(user, group, NULL, &n);
+	if (n <= 0) {
+		n = 1;
+	}
+	for (;;) {
+		gid_t *tmp = realloc(list, n * sizeof(gid_t));
+		if (!tmp) {
+			free(list);
+			return -1;
+		}
+		list = tmp;
+		int want = n;
+		if (getgrouplist(user, group, list, &n) >= 0) {
+			break;
+		}
+		if (n <= want) {
+			n = want * 2;
+		}
+	}
+	*groups = list;
+	*ngroups = n;
+	return 0;
+#else
+	struct acct_iter it;
+	struct acct_grent e;
+	int n = 1, cap = 16;
+	gid_t *list = malloc(cap * sizeof(gid_t));
+
+	if (!list) {
+		return -1;
+	}
+	list[0] = group;
+
+	acct_iter_init(&it, &db->group);
+	while (acct_next_gr(&it, &e)) {
+		if (!acct_has_member(&e, user)) {
+			continue;
+		}
+		int dup = 0;
+		for (int i = 0; i < n; i++) {
+			if (list[i] == e.gid) {
+				dup = 1;
+				break;
+			}
+		}
+		if (dup) {
+			continue;
+		}
+		if (n == cap) {
+			gid_t *tmp = realloc(list, cap * 2 * sizeof(gid_t));
+			if (!tmp) {
+				free(list);
+				return -1;
+			}
+			list = tmp;
+			cap *= 2;
+		}
+		list[n++] = e.gid;
+	}
+
+	*groups = list;
+	*ngroups = n;
+	return 0;
+#endif
+}
+
+// gid -> first group name seen, open addressing
+struct gid_names {
+	struct acct_gname *slots;
+	size_t mask;
+	size_t used;
+};
+
+static struct acct_gname *gid_names_slot(const struct gid_names *t,
+					 gid_t gid)
+{
+	size_t h = ((uint32_t)gid * 2654435761u) & t->mask;
+
+	while (t->slots[h].name.s && t->slots[h].gid != gid)
+		h = (h + 1) & t->mask;
+	return &t->slots[h];
+}
+
+static int gid_names_add(struct gid_names *t, gid_t gid,
+			 const struct acct_str *name)
+{
+	if ((t->used + 1) * 2 > t->mask + 1) {
+		struct gid_names n = { NULL, t->mask * 2 + 1, t->used };
+
+		n.slots = calloc(n.mask + 1, sizeof(*n.slots));
+		if (!n.slots) {
+			return -1;
+		}
+		for (size_t i = 0; i <= t->mask; i++) {
+			if (t->slots[i].name.s)
+				*gid_names_slot(&n, t->slots[i].gid) =
+				    t->slots[i];
+		}
+		free(t->slots);
+		*t = n;
+	}
+
+	struct acct_gname *slot = gid_names_slot(t, gid);
+	if (!slot->name.s) {
+		slot->gid = gid;
+		slot->name = *name;
+		t->used++;
+	}
+	return 0;
+}
+
+int acct_getgroupnames(const struct acct_db *db, const char *user,
+		       gid_t group, struct acct_gname **list, int *n)
+{
+	struct gid_names names = { NULL, 63, 0 };
+	struct acct_iter it;
+	struct acct_grent e;
+	gid_t *gids = NULL;
+	int ngids = 0;
+
+	*list = NULL;
+	*n = 0;
+	names.slots = calloc(names.mask + 1, sizeof(*names.slots));
+	if (!names.slots) {
+		return -1;
+	}
+#ifdef ACCT_NSS
+	// Memberships come from NSS; names still come from one file scan
+	if (acct_getgrouplist(db, user, group, &gids, &ngids) < 0) {
+		free(names.slots);
+		return -1;
+	}
+#else
+	int cap = 16;
+
+	gids = malloc(cap * sizeof(gid_t));
+	if (!gids) {
+		free(names.slots);
+		return -1;
+	}
+	gids[ngids++] = group;
+#endif
+
+	acct_iter_init(&it, &db->group);
+	while (acct_next_gr(&it, &e)) {
+		if (gid_names_add(&names, e.gid, &e.name) < 0) {
+			goto fail;
+		}
+#ifndef ACCT_NSS
+		if (!acct_has_member(&e, user)) {
+			continue;
+		}
+		if (ngids == cap) {
+			gid_t *tmp = realloc(gids, cap * 2 * sizeof(gid_t));
+			if (!tmp) {
+				goto fail;
+			}
+			gids = tmp;
+			cap *= 2;
+		}
+		gids[ngids++] = e.gid;
+#endif
+	}
+
+	*list = malloc(ngids * sizeof(**list));
+	if (!*list) {
+		goto fail;
+	}
+	for (int i = 0; i < ngids; i++) {
+		// Same order and de-duplication as getgrouplist()
+		int dup = 0;
+		for (int j = 0; j < i && !dup; j++) {
+			dup = gids[j] == gids[i];
+		}
+		if (dup) {
+			continue;
+		}
+
+		struct acct_gname *g = &(*list)[*n];
+		struct acct_gname *slot = gid_names_slot(&names, gids[i]);
+		g->gid = gids[i];
+		g->storage = NULL;
+		if (slot->name.s) {
+			g->name = slot->name;
+		} else {
+#ifdef ACCT_NSS
+			struct group *gr = acct_getgrgid(db, gids[i]);
+			if (!gr) {
+				continue;
+			}
+			g->name = str_of(gr->gr_name);
+			g->storage = gr;
+#else
+			continue;
+#endif
+		}
+		(*n)++;
+	}
+
+	free(gids);
+	free(names.slots);
+	return 0;
+ fail:
+	free(gids);
+	free(names.slots);
+	return -1;
+}
+
+void acct_gnames_free(struct acct_gname *list, int n)
+{
+	for (int i = 0; i < n; i++) {
+		free(list[i].storage);
+	}
+	free(list);
+}
+
+// Names from a group's member list, open addressing on acct_hash()
+struct name_set {
+	struct acct_str *slots;
+	size_t mask;
+};
+
+static struct acct_str *name_set_slot(const struct name_set *t,
+				      const char *s, size_t len)
+{
+	size_t h = acct_hash(s, len) & t->mask;
+
+	while (t->slots[h].s && (t->slots[h].len != len ||
+				 memcmp(t->slots[h].s, s, len) != 0))
+		h = (h + 1) & t->mask;
+	return &t->slots[h];
+}
+
+static int name_set_init(struct name_set *t, const struct acct_str *mem)
+{
+	size_t n = 1;
+
+	for (size_t i = 0; i < mem->len; i++) {
+		n += mem->s[i] == ',';
+	}
+	t->mask = 15;
+	while (t->mask < n * 2) {
+		t->mask = t->mask * 2 + 1;
+	}
+	t->slots = calloc(t->mask + 1, sizeof(*t->slots));
+	if (!t->slots) {
+		return -1;
+	}
+
+	const char *p = mem->s, *end = mem->s + mem->len;
+	while (p < end) {
+		const char *c = memchr(p, ',', end - p);
+		if (!c) {
+			c = end;
+		}
+		if (c > p) {
+			struct acct_str *slot = name_set_slot(t, p, c - p);
+			slot->s = p;
+			slot->len = c - p;
+		}
+		p = c + 1;
+	}
+	return 0;
+}
+
+int acct_getmembers(const struct acct_db *db, const char *group,
+		    struct acct_grent *gr, struct acct_member **list, int *n)
+{
+	struct acct_str arg = str_of(group);
+	struct acct_grent e, by_gid = { 0 };
+	struct acct_iter it;
+	struct name_set names;
+	struct acct_pwent pw;
+	unsigned long gid = 0;
+	int numeric = parse_id(&arg, &gid) == 0;
+	int cap = 16;
+
+	*list = NULL;
+	*n = 0;
+	memset(gr, 0, sizeof(*gr));
+
+	// A group name wins over a gid; the first entry with either is used
+	acct_iter_init(&it, &db->group);
+	while (acct_next_gr(&it, &e)) {
+		if (acct_str_eq(&e.name, group)) {
+			*gr = e;
+			break;
+		}
+		if (numeric && !by_gid.name.s && e.gid == gid) {
+			by_gid = e;
+		}
+	}
+	if (!gr->name.s) {
+		if (!numeric) {
+			errno = ENOENT;
+			return -1;
+		}
+		// Users may have a primary gid that no group entry names
+		*gr = by_gid;
+		gr->gid = gid;
+	}
+
+	if (name_set_init(&names, &gr->mem) < 0) {
+		return -1;
+	}
+	*list = malloc(cap * sizeof(**list));
+	if (!*list) {
+		free(names.slots);
+		return -1;
+	}
+
+	acct_iter_init(&it, &db->passwd);
+	while (acct_next_pw(&it, &pw)) {
+		int listed = name_set_slot(&names, pw.name.s,
+					   pw.name.len)->s != NULL;
+		if (pw.gid != gr->gid && !listed) {
+			continue;
+		}
+		if (*n == cap) {
+			struct acct_member *tmp = realloc(*list, cap * 2 *
+							  sizeof(**list));
+			if (!tmp) {
+				free(*list);
+				*list = NULL;
+				*n = 0;
+				free(names.slots);
+				return -1;
+			}
+			*list = tmp;
+			cap *= 2;
+		}
+		(*list)[*n].name = pw.name;
+		(*list)[*n].uid = pw.uid;
+		(*list)[*n].primary = pw.gid == gr->gid;
+		(*list)[*n].listed = listed;
+		(*n)++;
+	}
+
+	free(names.slots);
+	return 0;
+}
@@ -0,0 +1,181 @@
+#ifndef ACCT_COMMON_H
+#define ACCT_COMMON_H
+
+#include <grp.h>
+#include <pwd.h>
+#include <shadow.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Built-in reader for the flat account files.
+ *
+ * The files are mapped read-only once and scanned in place; nothing is
+ * copied until a caller asks for a libc-style struct.  Lookups never go
+ * through NSS unless the program is built with -DACCT_NSS (make NSS=1), in
+ * which case entries missing from the files are looked up through NSS.
+ */
+
+#define ACCT_PASSWD_FILE "/etc/passwd"
+#define ACCT_GROUP_FILE "/etc/group"
+#define ACCT_SHADOW_FILE "/etc/shadow"
+
+// Prebuilt index written by `usrx index build`
+#ifndef ACCT_INDEX_FILE
+#define ACCT_INDEX_FILE "/var/cache/suex/accounts.idx"
+#endif
+
+// Files to map in acct_open()
+#define ACCT_PASSWD 0x1
+#define ACCT_GROUP 0x2
+#define ACCT_SHADOW 0x4
+// Use the index instead of passwd/group when it is current
+#define ACCT_INDEX 0x8
+
+// A read-only view of one database file (data is NULL if unavailable)
+struct acct_file {
+	const char *data;
+	size_t size;
+	dev_t dev;		// identity of the mapped file
+	ino_t ino;
+	struct timespec mtime;
+};
+
+struct acct_index;
+
+struct acct_db {
+	struct acct_file passwd;
+	struct acct_file group;
+	struct acct_file shadow;
+	struct acct_index *index;	// set when ACCT_INDEX found a current index
+};
+
+// A field inside a mapped file; not NUL-terminated
+struct acct_str {
+	const char *s;
+	size_t len;
+};
+
+// Zero-copy views of one parsed line
+struct acct_pwent {
+	struct acct_str name;
+	struct acct_str passwd;
+	uid_t uid;
+	gid_t gid;
+	struct acct_str gecos;
+	struct acct_str dir;
+	struct acct_str shell;
+};
+
+struct acct_grent {
+	struct acct_str name;
+	struct acct_str passwd;
+	gid_t gid;
+	struct acct_str mem;	// comma-separated member list
+};
+
+struct acct_spent {
+	struct acct_str name;
+	struct acct_str pwdp;
+	long lstchg;
+	long min;
+	long max;
+	long warn;
+	long inact;
+	long expire;
+	unsigned long flag;
+};
+
+// Cursor over the lines of a mapped file
+struct acct_iter {
+	const char *pos;
+	const char *end;
+};
+
+/*
+ * Map the requested files; returns -1 if any of them could not be mapped.
+ * With ACCT_INDEX, a current index replaces the passwd and group mappings;
+ * only auth_resolve() reads from it.
+ */
+int acct_open(struct acct_db *db, int which);
+void acct_close(struct acct_db *db);
+
+void acct_iter_init(struct acct_iter *it, const struct acct_file *f);
+
+// Advance to the next well-formed entry; returns 0 at end of file
+int acct_next_pw(struct acct_iter *it, struct acct_pwent *e);
+int acct_next_gr(struct acct_iter *it, struct acct_grent *e);
+int acct_next_sp(struct acct_iter *it, struct acct_spent *e);
+
+// Hash used for name lookups in the in-memory table and the index
+uint32_t acct_hash(const char *s, size_t len);
+
+// Compare a field with a NUL-terminated string
+int acct_str_eq(const struct acct_str *f, const char *s);
+
+// Check if name appears in the group's member list
+int acct_has_member(const struct acct_grent *e, const char *name);
+
+// Copy an entry into a single malloc'd block; release with free()
+struct passwd *acct_pw_dup(const struct acct_pwent *e);
+struct group *acct_gr_dup(const struct acct_grent *e);
+struct spwd *acct_sp_dup(const struct acct_spent *e);
+
+// Describe libc structs as views, e.g. to share code with mapped entries
+void acct_pw_view(const struct passwd *pw, struct acct_pwent *e);
+void acct_sp_view(const struct spwd *sp, struct acct_spent *e);
+
+// Point lookups; results are malloc'd and released with free()
+struct passwd *acct_getpwnam(const struct acct_db *db, const char *name);
+struct passwd *acct_getpwuid(const struct acct_db *db, uid_t uid);
+struct group *acct_getgrnam(const struct acct_db *db, const char *name);
+struct group *acct_getgrgid(const struct acct_db *db, gid_t gid);
+struct spwd *acct_getspnam(const struct acct_db *db, const char *name);
+
+/*
+ * Same result as getgrouplist(3): group first, then every group listing
+ * user as a member, without duplicates.  *groups is malloc'd.
+ */
+int acct_getgrouplist(const struct acct_db *db, const char *user, gid_t group,
+		      gid_t **groups, int *ngroups);
+
+// A group with its name, as getgrgid() resolves the gid
+struct acct_gname {
+	gid_t gid;
+	struct acct_str name;
+	void *storage;		// malloc'd block behind name, if any
+};
+
+/*
+ * acct_getgrouplist() with every gid resolved to its name, from one scan
+ * of the group file that builds a gid->name table on the way.  Gids
+ * without a group entry are left out.  Names point into the mapping, so
+ * the list is valid while db is open; release it with acct_gnames_free().
+ */
+int acct_getgroupnames(const struct acct_db *db, const char *user,
+		       gid_t group, struct acct_gname **list, int *n);
+void acct_gnames_free(struct acct_gname *list, int n);
+
+// A user in a group, as acct_getmembers() finds them
+struct acct_member {
+	struct acct_str name;
+	uid_t uid;
+	int primary;		// the group is the user's passwd gid
+	int listed;		// named in the group's member list
+};
+
+/*
+ * Every user whose primary gid is the group's or who is in its member
+ * list, in passwd order, from one scan of group and one of passwd.
+ * group is a group name or, failing that, a gid; a gid without a group
+ * entry still finds its primary members and leaves gr->name.s NULL.
+ * Member-list names without a passwd entry are left out.  Returns -1
+ * with errno ENOENT if there is no such group.  Files only, even with
+ * NSS.  *list points into the mapping and is released with free().
+ */
+int acct_getmembers(const struct acct_db *db, const char *group,
+		    struct acct_grent *gr, struct acct_member **list, int *n);
+
+#endif /* ACCT_COMMON_H */
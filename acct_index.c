@@ -0,0 +1,590 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "acct_index.h"
+
+#define INDEX_MAGIC "SUEXIDX"
+#define INDEX_VERSION 1
+#define INDEX_BOM 0x01020304u
+
+/*
+ * Layout: header, users[], name and uid hashes, groups[], group name
+ * hash, membership gids, then NUL-terminated strings.  Sections start on
+ * 8-byte boundaries; hash slots hold an array index + 1, 0 when empty.
+ */
+
+// Identity of one account file when the index was built
+struct stamp {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t sec;
+	int64_t nsec;
+};
+
+struct header {
+	char magic[8];
+	uint32_t version;
+	uint32_t bom;		// catches an index from another byte order
+	struct stamp files[3];	// passwd, group, shadow
+	uint32_t nusers;
+	uint32_t ngroups;
+	uint32_t ngids;
+	uint32_t strings_size;
+	uint32_t name_slots;
+	uint32_t uid_slots;
+	uint32_t group_slots;
+	uint32_t pad;
+	uint64_t users;		// section offsets from the start of the file
+	uint64_t name_hash;
+	uint64_t uid_hash;
+	uint64_t groups;
+	uint64_t group_hash;
+	uint64_t gids;
+	uint64_t strings;
+};
+
+// Strings are offsets into the string section
+struct rec_user {
+	uint32_t name;
+	uint32_t passwd;
+	uint32_t gecos;
+	uint32_t dir;
+	uint32_t shell;
+	uint32_t uid;
+	uint32_t gid;
+	uint32_t groups;	// offset of the user's memberships in gids[]
+	uint32_t ngroups;
+};
+
+struct rec_group {
+	uint32_t name;
+	uint32_t gid;
+};
+
+struct acct_index {
+	const char *base;
+	size_t size;
+	int in_memory;		// base is malloc'd by acct_index_build()
+	const struct header *h;
+	const struct rec_user *users;
+	const uint32_t *name_hash;
+	const uint32_t *uid_hash;
+	const struct rec_group *groups;
+	const uint32_t *group_hash;
+	const uint32_t *gids;
+	const char *strings;
+};
+
+static const char *const stamped_files[3] = {
+	ACCT_PASSWD_FILE, ACCT_GROUP_FILE, ACCT_SHADOW_FILE
+};
+
+static uint32_t hash_id(uint32_t id)
+{
+	return id * 2654435761u;
+}
+
+static uint32_t slots_for(size_t n)
+{
+	uint32_t size = 16;
+
+	while (size < n * 2)
+		size <<= 1;
+	return size;
+}
+
+static size_t align8(size_t n)
+{
+	return (n + 7) & ~(size_t)7;
+}
+
+// A writable index would let anyone pick the groups suex hands out
+static int safe_owner(const struct stat *st)
+{
+	return st->st_uid == 0 && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static int safe_dir(const char *path)
+{
+	char dir[PATH_MAX];
+	struct stat st;
+	const char *slash = strrchr(path, '/');
+
+	if (!slash) {
+		strcpy(dir, ".");
+	} else if (slash == path) {
+		strcpy(dir, "/");
+	} else {
+		if ((size_t)(slash - path) >= sizeof(dir))
+			return 0;
+		memcpy(dir, path, slash - path);
+		dir[slash - path] = '\0';
+	}
+	return stat(dir, &st) == 0 && S_ISDIR(st.st_mode) && safe_owner(&st);
+}
+
+static void stamp_file(struct stamp *s, const struct acct_file *f)
+{
+	memset(s, 0, sizeof(*s));
+	if (!f->data)
+		return;
+	s->dev = f->dev;
+	s->ino = f->ino;
+	s->size = f->size;
+	s->sec = f->mtime.tv_sec;
+	s->nsec = f->mtime.tv_nsec;
+}
+
+// Check that passwd, group and shadow are the files the index was built from
+static int is_current(const struct header *h)
+{
+	for (int i = 0; i < 3; i++) {
+		const struct stamp *s = &h->files[i];
+		struct stat st;
+
+		if (stat(stamped_files[i], &st) < 0) {
+			// Missing then, missing now
+			if (s->dev || s->ino || s->size || s->sec || s->nsec)
+				return 0;
+			continue;
+		}
+		if (s->dev != (uint64_t)st.st_dev ||
+		    s->ino != (uint64_t)st.st_ino ||
+		    s->size != (uint64_t)st.st_size ||
+		    s->sec != (int64_t)st.st_mtim.tv_sec ||
+		    s->nsec != (int64_t)st.st_mtim.tv_nsec)
+			return 0;
+	}
+	return 1;
+}
+
+static const void *section(const struct acct_index *ix, uint64_t off,
+			   uint64_t count, size_t elem)
+{
+	if (off % 8 || off > ix->size || count * elem > ix->size - off)
+		return NULL;
+	return ix->base + off;
+}
+
+static int pow2(uint32_t n)
+{
+	return n && (n & (n - 1)) == 0;
+}
+
+static int check_layout(struct acct_index *ix)
+{
+	const struct header *h = ix->h;
+
+	if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != INDEX_VERSION || h->bom != INDEX_BOM)
+		return 0;
+	if (!pow2(h->name_slots) || !pow2(h->uid_slots) ||
+	    !pow2(h->group_slots))
+		return 0;
+	ix->users = section(ix, h->users, h->nusers, sizeof(*ix->users));
+	ix->name_hash = section(ix, h->name_hash, h->name_slots,
+				sizeof(uint32_t));
+	ix->uid_hash = section(ix, h->uid_hash, h->uid_slots,
+			       sizeof(uint32_t));
+	ix->groups = section(ix, h->groups, h->ngroups, sizeof(*ix->groups));
+	ix->group_hash = section(ix, h->group_hash, h->group_slots,
+				 sizeof(uint32_t));
+	ix->gids = section(ix, h->gids, h->ngids, sizeof(uint32_t));
+	ix->strings = section(ix, h->strings, h->strings_size, 1);
+	if (!ix->users || !ix->name_hash || !ix->uid_hash || !ix->groups ||
+	    !ix->group_hash || !ix->gids || !ix->strings)
+		return 0;
+	// Every string offset then ends inside the section
+	return h->strings_size > 0 && ix->strings[h->strings_size - 1] == '\0';
+}
+
+struct acct_index *acct_index_open(const char *path)
+{
+	struct acct_index *ix;
+	struct stat st;
+	void *p;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !safe_owner(&st) ||
+	    !safe_dir(path) || (size_t)st.st_size < sizeof(struct header)) {
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+	ix = calloc(1, sizeof(*ix));
+	if (!ix) {
+		munmap(p, st.st_size);
+		return NULL;
+	}
+	ix->base = p;
+	ix->size = st.st_size;
+	ix->h = p;
+	if (!check_layout(ix) || !is_current(ix->h)) {
+		acct_index_close(ix);
+		return NULL;
+	}
+	return ix;
+}
+
+void acct_index_close(struct acct_index *ix)
+{
+	if (!ix) {
+		return;
+	}
+	if (ix->in_memory)
+		free((void *)ix->base);
+	else
+		munmap((void *)ix->base, ix->size);
+	free(ix);
+}
+
+static const char *str_at(const struct acct_index *ix, uint32_t off)
+{
+	return off < ix->h->strings_size ? ix->strings + off : NULL;
+}
+
+static const struct rec_user *find_user(const struct acct_index *ix,
+					const char *name)
+{
+	uint32_t mask = ix->h->name_slots - 1;
+	uint32_t h = acct_hash(name, strlen(name)) & mask;
+
+	for (uint32_t i = 0; i < ix->h->name_slots; i++, h = (h + 1) & mask) {
+		uint32_t slot = ix->name_hash[h];
+		if (slot == 0 || slot > ix->h->nusers) {
+			return NULL;
+		}
+		const char *n = str_at(ix, ix->users[slot - 1].name);
+		if (n && strcmp(n, name) == 0) {
+			return &ix->users[slot - 1];
+		}
+	}
+	return NULL;
+}
+
+static int str_view(const struct acct_index *ix, uint32_t off,
+		    struct acct_str *v)
+{
+	v->s = str_at(ix, off);
+	v->len = v->s ? strlen(v->s) : 0;
+	return v->s != NULL;
+}
+
+static struct passwd *user_dup(const struct acct_index *ix,
+			       const struct rec_user *u)
+{
+	struct acct_pwent e;
+
+	if (!u || !str_view(ix, u->name, &e.name) ||
+	    !str_view(ix, u->passwd, &e.passwd) ||
+	    !str_view(ix, u->gecos, &e.gecos) ||
+	    !str_view(ix, u->dir, &e.dir) || !str_view(ix, u->shell, &e.shell))
+		return NULL;
+	e.uid = u->uid;
+	e.gid = u->gid;
+	return acct_pw_dup(&e);
+}
+
+struct passwd *acct_index_getpwnam(const struct acct_index *ix,
+				   const char *name)
+{
+	return user_dup(ix, find_user(ix, name));
+}
+
+struct passwd *acct_index_getpwuid(const struct acct_index *ix, uid_t uid)
+{
+	uint32_t mask = ix->h->uid_slots - 1;
+	uint32_t h = hash_id(uid) & mask;
+
+	for (uint32_t i = 0; i < ix->h->uid_slots; i++, h = (h + 1) & mask) {
+		uint32_t slot = ix->uid_hash[h];
+		if (slot == 0 || slot > ix->h->nusers) {
+			return NULL;
+		}
+		if (ix->users[slot - 1].uid == uid) {
+			return user_dup(ix, &ix->users[slot - 1]);
+		}
+	}
+	return NULL;
+}
+
+int acct_index_getgid(const struct acct_index *ix, const char *name,
+		      gid_t *gid)
+{
+	uint32_t mask = ix->h->group_slots - 1;
+	uint32_t h = acct_hash(name, strlen(name)) & mask;
+
+	for (uint32_t i = 0; i < ix->h->group_slots; i++, h = (h + 1) & mask) {
+		uint32_t slot = ix->group_hash[h];
+		if (slot == 0 || slot > ix->h->ngroups) {
+			return 0;
+		}
+		const char *n = str_at(ix, ix->groups[slot - 1].name);
+		if (n && strcmp(n, name) == 0) {
+			*gid = ix->groups[slot - 1].gid;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int acct_index_is_member(const struct acct_index *ix, const char *name,
+			 gid_t gid)
+{
+	const struct rec_user *u = find_user(ix, name);
+
+	if (!u || (uint64_t)u->groups + u->ngroups > ix->h->ngids) {
+		return 0;
+	}
+	for (uint32_t i = 0; i < u->ngroups; i++) {
+		if (ix->gids[u->groups + i] == gid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int acct_index_memberships(const struct acct_index *ix, const char *name,
+			   gid_t **groups, int *ngroups)
+{
+	const struct rec_user *u = find_user(ix, name);
+
+	*groups = NULL;
+	*ngroups = 0;
+	if (!u || u->ngroups == 0 ||
+	    (uint64_t)u->groups + u->ngroups > ix->h->ngids) {
+		return 0;
+	}
+	*groups = malloc(u->ngroups * sizeof(gid_t));
+	if (!*groups) {
+		return -1;
+	}
+	for (uint32_t i = 0; i < u->ngroups; i++)
+		(*groups)[i] = ix->gids[u->groups + i];
+	*ngroups = u->ngroups;
+	return 0;
+}
+
+// Append a field to the string section and return its offset
+static uint32_t put_str(char *strings, size_t *used, const struct acct_str *s)
+{
+	uint32_t off = *used;
+
+	memcpy(strings + *used, s->s, s->len);
+	strings[*used + s->len] = '\0';
+	*used += s->len + 1;
+	return off;
+}
+
+static void insert(uint32_t *slots, uint32_t nslots, uint32_t h,
+		   uint32_t value)
+{
+	uint32_t mask = nslots - 1;
+
+	for (h &= mask; slots[h]; h = (h + 1) & mask) ;
+	slots[h] = value;
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+// Lay out the index of t in a malloc'd buffer of *total bytes
+static char *build_image(const struct acct_table *t, const struct acct_db *db,
+			 size_t *total)
+{
+	struct header h;
+	size_t strings_size = 0, ngids = 0;
+
+	for (size_t i = 0; i < t->nusers; i++) {
+		const struct acct_pwent *e = &t->users[i].pw;
+		strings_size += e->name.len + e->passwd.len + e->gecos.len +
+		    e->dir.len + e->shell.len + 5;
+		ngids += t->users[i].ngroups;
+	}
+	for (size_t i = 0; i < t->ngroups; i++)
+		strings_size += t->groups[i].name.len + 1;
+	if (strings_size == 0)
+		strings_size = 1;
+	if (strings_size > UINT32_MAX || t->nusers > UINT32_MAX / 4 ||
+	    t->ngroups > UINT32_MAX / 4 || ngids > UINT32_MAX) {
+		errno = EFBIG;
+		return NULL;
+	}
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+	h.version = INDEX_VERSION;
+	h.bom = INDEX_BOM;
+	stamp_file(&h.files[0], &db->passwd);
+	stamp_file(&h.files[1], &db->group);
+	stamp_file(&h.files[2], &db->shadow);
+	h.nusers = t->nusers;
+	h.ngroups = t->ngroups;
+	h.ngids = ngids;
+	h.strings_size = strings_size;
+	h.name_slots = slots_for(t->nusers);
+	h.uid_slots = slots_for(t->nusers);
+	h.group_slots = slots_for(t->ngroups);
+
+	size_t off = align8(sizeof(h));
+	h.users = off;
+	off = align8(off + t->nusers * sizeof(struct rec_user));
+	h.name_hash = off;
+	off = align8(off + h.name_slots * sizeof(uint32_t));
+	h.uid_hash = off;
+	off = align8(off + h.uid_slots * sizeof(uint32_t));
+	h.groups = off;
+	off = align8(off + t->ngroups * sizeof(struct rec_group));
+	h.group_hash = off;
+	off = align8(off + h.group_slots * sizeof(uint32_t));
+	h.gids = off;
+	off = align8(off + ngids * sizeof(uint32_t));
+	h.strings = off;
+	*total = off + strings_size;
+
+	char *buf = calloc(1, *total);
+	if (!buf) {
+		return NULL;
+	}
+	memcpy(buf, &h, sizeof(h));
+	struct rec_user *users = (struct rec_user *)(buf + h.users);
+	uint32_t *name_hash = (uint32_t *)(buf + h.name_hash);
+	uint32_t *uid_hash = (uint32_t *)(buf + h.uid_hash);
+	struct rec_group *groups = (struct rec_group *)(buf + h.groups);
+	uint32_t *group_hash = (uint32_t *)(buf + h.group_hash);
+	uint32_t *gids = (uint32_t *)(buf + h.gids);
+	char *strings = buf + h.strings;
+	size_t used = 0;
+
+	memcpy(gids, t->member_gids, ngids * sizeof(uint32_t));
+	for (size_t i = 0; i < t->nusers; i++) {
+		const struct acct_user *u = &t->users[i];
+		const struct acct_user *first = &t->users[u->first];
+		struct rec_user *r = &users[i];
+
+		r->name = put_str(strings, &used, &u->pw.name);
+		r->passwd = put_str(strings, &used, &u->pw.passwd);
+		r->gecos = put_str(strings, &used, &u->pw.gecos);
+		r->dir = put_str(strings, &used, &u->pw.dir);
+		r->shell = put_str(strings, &used, &u->pw.shell);
+		r->uid = u->pw.uid;
+		r->gid = u->pw.gid;
+		r->groups = first->groups;
+		r->ngroups = first->ngroups;
+
+		// Only the first entry for a name or uid is reachable
+		if (u->first == i)
+			insert(name_hash, h.name_slots,
+			       acct_hash(u->pw.name.s, u->pw.name.len), i + 1);
+		uint32_t mask = h.uid_slots - 1, s;
+		for (s = hash_id(u->pw.uid) & mask; uid_hash[s] &&
+		     users[uid_hash[s] - 1].uid != u->pw.uid;
+		     s = (s + 1) & mask) ;
+		if (!uid_hash[s])
+			uid_hash[s] = i + 1;
+	}
+	for (size_t i = 0; i < t->ngroups; i++) {
+		const struct acct_grent *g = &t->groups[i];
+		uint32_t mask = h.group_slots - 1, s;
+
+		groups[i].name = put_str(strings, &used, &g->name);
+		groups[i].gid = g->gid;
+		for (s = acct_hash(g->name.s, g->name.len) & mask;
+		     group_hash[s] &&
+		     strcmp(strings + groups[group_hash[s] - 1].name,
+			    strings + groups[i].name) != 0;
+		     s = (s + 1) & mask) ;
+		if (!group_hash[s])
+			group_hash[s] = i + 1;
+	}
+	return buf;
+}
+
+struct acct_index *acct_index_build(const struct acct_table *t,
+				    const struct acct_db *db)
+{
+	struct acct_index *ix = calloc(1, sizeof(*ix));
+
+	if (!ix) {
+		return NULL;
+	}
+	ix->base = build_image(t, db, &ix->size);
+	if (!ix->base) {
+		free(ix);
+		return NULL;
+	}
+	ix->in_memory = 1;
+	ix->h = (const struct header *)ix->base;
+	if (!check_layout(ix)) {
+		acct_index_close(ix);
+		errno = EINVAL;
+		return NULL;
+	}
+	return ix;
+}
+
+int acct_index_write(const struct acct_table *t, const struct acct_db *db,
+		     const char *path)
+{
+	size_t total;
+	char *buf = build_image(t, db, &total);
+
+	if (!buf) {
+		return -1;
+	}
+
+	// Write next to the target so the rename is atomic
+	char tmp[PATH_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp)) {
+		free(buf);
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	int fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(buf);
+		return -1;
+	}
+	int ret = 0;
+	if (fchmod(fd, 0644) < 0 || write_all(fd, buf, total) < 0 ||
+	    fsync(fd) < 0)
+		ret = -1;
+	if (close(fd) < 0)
+		ret = -1;
+	if (ret == 0 && rename(tmp, path) < 0)
+		ret = -1;
+	if (ret < 0) {
+		int saved = errno;
+		unlink(tmp);
+		errno = saved;
+	}
+	free(buf);
+	return ret;
+}
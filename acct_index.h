@@ -0,0 +1,65 @@
+#ifndef ACCT_INDEX_H
+#define ACCT_INDEX_H
+
+#include <grp.h>
+#include <pwd.h>
+#include <sys/types.h>
+
+#include "acct_common.h"
+#include "acct_table.h"
+
+/*
+ * Prebuilt binary index of the account files, written by `usrx index
+ * build` and read by suex and sush instead of scanning passwd and group.
+ *
+ * The index records the device, inode, size and mtime of passwd, group
+ * and shadow when it was built.  It is only used while all three still
+ * match and the file is a root-owned regular file that neither it nor its
+ * directory is writable by group or others; otherwise callers fall back to
+ * the files.  Data is stored in host byte order, so the index is only
+ * meaningful on the machine that built it.
+ */
+
+/*
+ * Map and validate the index at path; returns NULL if it is missing,
+ * unsafe, malformed or out of date.
+ */
+struct acct_index *acct_index_open(const char *path);
+void acct_index_close(struct acct_index *ix);
+
+// Point lookups with getpwnam()/getpwuid() semantics; release with free()
+struct passwd *acct_index_getpwnam(const struct acct_index *ix,
+				   const char *name);
+struct passwd *acct_index_getpwuid(const struct acct_index *ix, uid_t uid);
+
+// Gid of the first group with this name; returns 0 if there is none
+int acct_index_getgid(const struct acct_index *ix, const char *name,
+		      gid_t *gid);
+
+// Whether a group with this gid lists name as a member
+int acct_index_is_member(const struct acct_index *ix, const char *name,
+			 gid_t gid);
+
+/*
+ * Gids of the groups listing name as a member, in group file order.
+ * *groups is malloc'd, and NULL when there are none.
+ */
+int acct_index_memberships(const struct acct_index *ix, const char *name,
+			   gid_t **groups, int *ngroups);
+
+/*
+ * Build an index of t in memory, for a long-running process that loaded
+ * the files itself.  Unlike acct_index_open() it is not checked against
+ * the files; release with acct_index_close().
+ */
+struct acct_index *acct_index_build(const struct acct_table *t,
+				    const struct acct_db *db);
+
+/*
+ * Write an index of t, stamped with the files db mapped, to path.  The
+ * file is written next to path and renamed into place.
+ */
+int acct_index_write(const struct acct_table *t, const struct acct_db *db,
+		     const char *path);
+
+#endif /* ACCT_INDEX_H */
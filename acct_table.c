@@ -0,0 +1,349 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acct_table.h"
+
+// Below this size the group file is resolved on the calling thread
+#define PARALLEL_MIN_BYTES (256 * 1024)
+#define MAX_THREADS 64
+
+// A membership found in the group file: users[] index and group gid
+struct member {
+	uint32_t user;
+	gid_t gid;
+};
+
+// One slice of the group file and what was found in it
+struct chunk {
+	const struct acct_table *t;
+	struct acct_iter it;
+	struct acct_grent *groups;
+	size_t ngroups, gcap;
+	struct member *members;
+	size_t nmembers, mcap;
+	int err;
+};
+
+static uint32_t hash_gid(gid_t gid)
+{
+	return (uint32_t)gid * 2654435761u;
+}
+
+static size_t table_size(size_t n)
+{
+	size_t size = 16;
+
+	while (size < n * 2)
+		size <<= 1;
+	return size;
+}
+
+static int grow(void **arr, size_t *cap, size_t n, size_t elem)
+{
+	if (n < *cap) {
+		return 0;
+	}
+	size_t ncap = *cap ? *cap * 2 : 64;
+	void *tmp = realloc(*arr, ncap * elem);
+	if (!tmp) {
+		return -1;
+	}
+	*arr = tmp;
+	*cap = ncap;
+	return 0;
+}
+
+static int load_users(struct acct_table *t, const struct acct_db *db)
+{
+	struct acct_iter it;
+	struct acct_pwent e;
+	size_t cap = 0;
+
+	acct_iter_init(&it, &db->passwd);
+	while (acct_next_pw(&it, &e)) {
+		if (grow((void **)&t->users, &cap, t->nusers,
+			 sizeof(*t->users)) < 0)
+			return -1;
+		struct acct_user *u = &t->users[t->nusers];
+		memset(u, 0, sizeof(*u));
+		u->pw = e;
+		t->nusers++;
+	}
+
+	// Index names; duplicates keep pointing at their first entry
+	t->user_mask = table_size(t->nusers) - 1;
+	t->user_index = calloc(t->user_mask + 1, sizeof(uint32_t));
+	if (!t->user_index) {
+		return -1;
+	}
+	for (size_t i = 0; i < t->nusers; i++) {
+		struct acct_user *u = &t->users[i];
+		size_t h = acct_hash(u->pw.name.s, u->pw.name.len) & t->user_mask;
+
+		u->first = i;
+		for (;; h = (h + 1) & t->user_mask) {
+			uint32_t slot = t->user_index[h];
+			if (slot == 0) {
+				t->user_index[h] = i + 1;
+				break;
+			}
+			const struct acct_str *n = &t->users[slot - 1].pw.name;
+			if (n->len == u->pw.name.len &&
+			    memcmp(n->s, u->pw.name.s, n->len) == 0) {
+				u->first = slot - 1;
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+const struct acct_user *acct_table_user(const struct acct_table *t,
+					const char *name, size_t len)
+{
+	if (!t->user_index) {
+		return NULL;
+	}
+	for (size_t h = acct_hash(name, len) & t->user_mask;;
+	     h = (h + 1) & t->user_mask) {
+		uint32_t slot = t->user_index[h];
+		if (slot == 0) {
+			return NULL;
+		}
+		const struct acct_str *n = &t->users[slot - 1].pw.name;
+		if (n->len == len && memcmp(n->s, name, len) == 0) {
+			return &t->users[slot - 1];
+		}
+	}
+}
+
+// Parse one slice of the group file and record its memberships
+static void *scan_chunk(void *arg)
+{
+	struct chunk *c = arg;
+	struct acct_grent e;
+
+	while (acct_next_gr(&c->it, &e)) {
+		if (grow((void **)&c->groups, &c->gcap, c->ngroups,
+			 sizeof(*c->groups)) < 0)
+			goto fail;
+		c->groups[c->ngroups++] = e;
+
+		const char *p = e.mem.s;
+		const char *end = e.mem.s + e.mem.len;
+		while (p < end) {
+			const char *comma = memchr(p, ',', end - p);
+			const char *m = comma ? comma : end;
+			const struct acct_user *u = acct_table_user(c->t, p,
+								    m - p);
+			if (u) {
+				if (grow((void **)&c->members, &c->mcap,
+					 c->nmembers, sizeof(*c->members)) < 0)
+					goto fail;
+				c->members[c->nmembers].user =
+				    u - c->t->users;
+				c->members[c->nmembers].gid = e.gid;
+				c->nmembers++;
+			}
+			p = m + 1;
+		}
+	}
+	return NULL;
+ fail:
+	c->err = 1;
+	return NULL;
+}
+
+static int load_groups(struct acct_table *t, const struct acct_db *db,
+		       int nthreads)
+{
+	const struct acct_file *f = &db->group;
+	struct chunk chunks[MAX_THREADS];
+	pthread_t tids[MAX_THREADS];
+	int started[MAX_THREADS] = { 0 };
+	size_t nmembers = 0;
+	int ret = -1;
+
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+	if (nthreads < 1 || !f->data || f->size < PARALLEL_MIN_BYTES)
+		nthreads = 1;
+
+	// Cut the file into slices that end on line boundaries
+	const char *start = f->data;
+	const char *end = f->data ? f->data + f->size : NULL;
+	for (int i = 0; i < nthreads; i++) {
+		const char *stop = end;
+		if (i < nthreads - 1) {
+			stop = f->data + f->size / nthreads * (i + 1);
+			if (stop < start)
+				stop = start;
+			const char *nl = memchr(stop, '\n', end - stop);
+			stop = nl ? nl + 1 : end;
+		}
+		memset(&chunks[i], 0, sizeof(chunks[i]));
+		chunks[i].t = t;
+		chunks[i].it.pos = start;
+		chunks[i].it.end = stop;
+		start = stop;
+	}
+
+	for (int i = 1; i < nthreads; i++) {
+		started[i] = pthread_create(&tids[i], NULL, scan_chunk,
+					    &chunks[i]) == 0;
+		if (!started[i])
+			scan_chunk(&chunks[i]);
+	}
+	scan_chunk(&chunks[0]);
+	for (int i = 1; i < nthreads; i++) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+	}
+
+	for (int i = 0; i < nthreads; i++) {
+		if (chunks[i].err)
+			goto out;
+		t->ngroups += chunks[i].ngroups;
+		nmembers += chunks[i].nmembers;
+	}
+
+	// Stitch the slices back together in file order
+	t->groups = malloc((t->ngroups ? t->ngroups : 1) * sizeof(*t->groups));
+	t->member_gids = malloc((nmembers ? nmembers : 1) * sizeof(gid_t));
+	if (!t->groups || !t->member_gids)
+		goto out;
+	size_t g = 0;
+	for (int i = 0; i < nthreads; i++) {
+		memcpy(t->groups + g, chunks[i].groups,
+		       chunks[i].ngroups * sizeof(*t->groups));
+		g += chunks[i].ngroups;
+	}
+
+	// Counting sort by user keeps each user's gids in file order
+	for (int i = 0; i < nthreads; i++) {
+		for (size_t j = 0; j < chunks[i].nmembers; j++)
+			t->users[chunks[i].members[j].user].ngroups++;
+	}
+	uint32_t off = 0;
+	for (size_t i = 0; i < t->nusers; i++) {
+		t->users[i].groups = off;
+		off += t->users[i].ngroups;
+		t->users[i].ngroups = 0;
+	}
+	for (int i = 0; i < nthreads; i++) {
+		for (size_t j = 0; j < chunks[i].nmembers; j++) {
+			struct acct_user *u =
+			    &t->users[chunks[i].members[j].user];
+			t->member_gids[u->groups + u->ngroups++] =
+			    chunks[i].members[j].gid;
+		}
+	}
+
+	// Index gids; duplicates keep pointing at their first group
+	t->gid_mask = table_size(t->ngroups) - 1;
+	t->gid_index = calloc(t->gid_mask + 1, sizeof(uint32_t));
+	if (!t->gid_index)
+		goto out;
+	for (size_t i = 0; i < t->ngroups; i++) {
+		size_t h = hash_gid(t->groups[i].gid) & t->gid_mask;
+		for (;; h = (h + 1) & t->gid_mask) {
+			uint32_t slot = t->gid_index[h];
+			if (slot == 0) {
+				t->gid_index[h] = i + 1;
+				break;
+			}
+			if (t->groups[slot - 1].gid == t->groups[i].gid)
+				break;
+		}
+	}
+	ret = 0;
+ out:
+	for (int i = 0; i < nthreads; i++) {
+		free(chunks[i].groups);
+		free(chunks[i].members);
+	}
+	return ret;
+}
+
+static int load_shadow(struct acct_table *t, const struct acct_db *db)
+{
+	struct acct_iter it;
+	struct acct_spent e;
+	size_t cap = 0;
+
+	acct_iter_init(&it, &db->shadow);
+	while (acct_next_sp(&it, &e)) {
+		if (grow((void **)&t->shadow, &cap, t->nshadow,
+			 sizeof(*t->shadow)) < 0)
+			return -1;
+		t->shadow[t->nshadow] = e;
+
+		// getspnam() returns the first entry for a name
+		struct acct_user *u = (struct acct_user *)
+		    acct_table_user(t, e.name.s, e.name.len);
+		if (u && u->shadow == 0)
+			u->shadow = t->nshadow + 1;
+		t->nshadow++;
+	}
+	return 0;
+}
+
+int acct_table_load(struct acct_table *t, const struct acct_db *db,
+		    int nthreads)
+{
+	memset(t, 0, sizeof(*t));
+	if (load_users(t, db) < 0 || load_groups(t, db, nthreads) < 0 ||
+	    load_shadow(t, db) < 0) {
+		acct_table_free(t);
+		return -1;
+	}
+	return 0;
+}
+
+void acct_table_free(struct acct_table *t)
+{
+	free(t->users);
+	free(t->groups);
+	free(t->shadow);
+	free(t->member_gids);
+	free(t->user_index);
+	free(t->gid_index);
+	memset(t, 0, sizeof(*t));
+}
+
+const struct acct_grent *acct_table_group(const struct acct_table *t,
+					  gid_t gid)
+{
+	if (!t->gid_index) {
+		return NULL;
+	}
+	for (size_t h = hash_gid(gid) & t->gid_mask;;
+	     h = (h + 1) & t->gid_mask) {
+		uint32_t slot = t->gid_index[h];
+		if (slot == 0) {
+			return NULL;
+		}
+		if (t->groups[slot - 1].gid == gid) {
+			return &t->groups[slot - 1];
+		}
+	}
+}
+
+const gid_t *acct_table_memberships(const struct acct_table *t,
+				    const struct acct_user *u, int *n)
+{
+	// Memberships are recorded on the first entry with the name
+	const struct acct_user *first = &t->users[u->first];
+
+	*n = first->ngroups;
+	return t->member_gids + first->groups;
+}
+
+const struct acct_spent *acct_table_shadow(const struct acct_table *t,
+					   const struct acct_user *u)
+{
+	const struct acct_user *first = &t->users[u->first];
+
+	return first->shadow ? &t->shadow[first->shadow - 1] : NULL;
+}
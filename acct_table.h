@@ -0,0 +1,60 @@
+#ifndef ACCT_TABLE_H
+#define ACCT_TABLE_H
+
+#include <stdint.h>
+
+#include "acct_common.h"
+
+/*
+ * The whole account database in memory for bulk commands: every passwd,
+ * group and shadow entry as zero-copy views into the mapped files, plus
+ * each user's group memberships.  Built with one pass over each file.
+ */
+
+struct acct_user {
+	struct acct_pwent pw;
+	uint32_t first;		// index of the first entry with this name
+	uint32_t shadow;	// index into shadow[] + 1, 0 if none
+	uint32_t groups;	// offset of the user's gids in member_gids[]
+	uint32_t ngroups;	// groups listing the user, in group file order
+};
+
+struct acct_table {
+	struct acct_user *users;	// passwd file order
+	size_t nusers;
+	struct acct_grent *groups;	// group file order
+	size_t ngroups;
+	struct acct_spent *shadow;	// shadow file order
+	size_t nshadow;
+	gid_t *member_gids;
+	uint32_t *user_index;	// name hash -> users[] index + 1
+	size_t user_mask;
+	uint32_t *gid_index;	// gid hash -> groups[] index + 1
+	size_t gid_mask;
+};
+
+/*
+ * Load every entry of the mapped files.  Group membership resolution is
+ * split across up to nthreads threads for large group files.
+ */
+int acct_table_load(struct acct_table *t, const struct acct_db *db,
+		    int nthreads);
+void acct_table_free(struct acct_table *t);
+
+// First user with this name (getpwnam order), or NULL
+const struct acct_user *acct_table_user(const struct acct_table *t,
+					const char *name, size_t len);
+
+// First group with this gid (getgrgid order), or NULL
+const struct acct_grent *acct_table_group(const struct acct_table *t,
+					  gid_t gid);
+
+// Gids of the groups listing u's name as a member, in group file order
+const gid_t *acct_table_memberships(const struct acct_table *t,
+				    const struct acct_user *u, int *n);
+
+// Shadow entry for u's name, or NULL
+const struct acct_spent *acct_table_shadow(const struct acct_table *t,
+					   const struct acct_user *u);
+
+#endif /* ACCT_TABLE_H */
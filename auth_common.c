@@ -1,43 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "acct_index.h"
 #include "auth_common.h"
 
-// Check if the current user belongs to the suex group
-int user_in_suex_group(void)
+static int add_gid(gid_t **list, int *n, int *cap, gid_t gid)
 {
-	// Get the suex group ID
-	struct group *suex_group = getgrnam(SUEX_GROUP);
-	if (!suex_group) {
-		// Group doesn't exist, consider this a failure
-		return 0;
+	if (*n == *cap) {
+		int ncap = *cap ? *cap * 2 : 16;
+		gid_t *tmp = realloc(*list, ncap * sizeof(gid_t));
+		if (!tmp) {
+			return -1;
+		}
+		*list = tmp;
+		*cap = ncap;
 	}
+	(*list)[(*n)++] = gid;
+	return 0;
+}
 
-	gid_t suex_gid = suex_group->gr_gid;
+static int has_gid(const gid_t *list, int n, gid_t gid)
+{
+	for (int i = 0; i < n; i++) {
+		if (list[i] == gid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int same_user(const struct passwd *a, const struct passwd *b)
+{
+	return a && b && strcmp(a->pw_name, b->pw_name) == 0;
+}
 
-	// Get current user info
-	uid_t uid = getuid();
+static int target_match(const struct auth_query *q,
+			const struct acct_pwent *e)
+{
+	if (q->by_uid) {
+		return e->uid == q->uid;
+	}
+	return q->user && acct_str_eq(&e->name, q->user);
+}
 
-	// If we're already root, we don't need to check group membership
-	if (uid == 0) {
+#ifdef ACCT_NSS
+/*
+ * Check if the caller belongs to the suex group through NSS: the primary
+ * gid, then the group's own member list, and only when both miss the
+ * caller's full group list, which is kept for auth_grouplist().
+ */
+static int nss_in_group(const struct acct_db *db, struct auth_query *q,
+			gid_t gid)
+{
+	const struct passwd *pw = q->caller;
+	int found = 0;
+
+	if (pw->pw_gid == gid) {
 		return 1;
 	}
-	// Get user group memberships
-	gid_t groups[MAX_GROUPS];
-	int ngroups = MAX_GROUPS;
+	struct group *gr = acct_getgrnam(db, SUEX_GROUP);
+	if (gr) {
+		for (char **m = gr->gr_mem; m && *m && !found; m++)
+			found = strcmp(*m, pw->pw_name) == 0;
+		free(gr);
+		if (found) {
+			return 1;
+		}
+	}
+	if (acct_getgrouplist(db, pw->pw_name, pw->pw_gid, &q->caller_groups,
+			      &q->caller_ngroups) < 0) {
+		return -1;
+	}
+	return has_gid(q->caller_groups, q->caller_ngroups, gid);
+}
+#endif
+
+// Same answers as the scans below, from the prebuilt index
+static int index_resolve(const struct acct_index *ix, struct auth_query *q)
+{
+	gid_t suex_gid;
 
-	struct passwd *pw = getpwuid(uid);
-	if (!pw) {
-		return 0;	// Can't get user info
+	q->caller = acct_index_getpwuid(ix, q->caller_uid);
+	if (q->by_uid) {
+		q->target = acct_index_getpwuid(ix, q->uid);
+	} else if (q->user) {
+		q->target = acct_index_getpwnam(ix, q->user);
 	}
+	if (q->group)
+		q->group_found = acct_index_getgid(ix, q->group, &q->group_gid);
+	if (q->target && acct_index_memberships(ix, q->target->pw_name,
+						&q->groups, &q->ngroups) < 0)
+		return -1;
 
-	if (getgrouplist(pw->pw_name, pw->pw_gid, groups, &ngroups) < 0) {
-		fprintf(stderr,
-			"Warning: Too many groups, may not validate all group memberships\n");
+	if (!acct_index_getgid(ix, SUEX_GROUP, &suex_gid)) {
+		return 0;
 	}
-	// Check if user is in the suex group
-	for (int i = 0; i < ngroups; i++) {
-		if (groups[i] == suex_gid) {
-			return 1;
+	if (q->caller_uid == 0) {
+		q->in_suex_group = 1;
+	} else if (q->caller) {
+		q->in_suex_group = q->caller->pw_gid == suex_gid;
+		if (!q->in_suex_group && same_user(q->caller, q->target))
+			q->in_suex_group = has_gid(q->groups, q->ngroups,
+						   suex_gid);
+		else if (!q->in_suex_group)
+			q->in_suex_group = acct_index_is_member(ix,
+								q->caller->pw_name,
+								suex_gid);
+	}
+	return 0;
+}
+
+int auth_resolve(const struct acct_db *db, struct auth_query *q)
+{
+	struct acct_iter it;
+	struct acct_pwent pe;
+	struct acct_grent ge;
+	int want_target = q->by_uid || q->user;
+	int suex_found = 0, caller_in = 0;
+	gid_t suex_gid = 0;
+	gid_t *caller_groups = NULL;
+	int caller_n = 0, caller_cap = 0, groups_cap = 0;
+	int ret = 0;
+
+	q->caller = NULL;
+	q->target = NULL;
+	q->in_suex_group = 0;
+	q->group_found = 0;
+	q->groups = NULL;
+	q->ngroups = 0;
+	q->caller_groups = NULL;
+	q->caller_ngroups = 0;
+
+	if (db->index) {
+		return index_resolve(db->index, q);
+	}
+	// Pass 1: caller and target from passwd, first match wins
+	acct_iter_init(&it, &db->passwd);
+	while ((!q->caller || (want_target && !q->target)) &&
+	       acct_next_pw(&it, &pe)) {
+		if (!q->caller && pe.uid == q->caller_uid) {
+			if (!(q->caller = acct_pw_dup(&pe)))
+				return -1;
+		}
+		if (want_target && !q->target && target_match(q, &pe)) {
+			if (!(q->target = acct_pw_dup(&pe)))
+				return -1;
+		}
+	}
+#ifdef ACCT_NSS
+	if (!q->caller)
+		q->caller = acct_getpwuid(db, q->caller_uid);
+	if (want_target && !q->target)
+		q->target = q->by_uid ? acct_getpwuid(db, q->uid)
+		    : acct_getpwnam(db, q->user);
+
+	// Memberships may live in any NSS source; getgrouplist() covers them
+	const char *caller_name = NULL;
+	const char *target_name = NULL;
+#else
+	// A caller who is also the target shares the target's memberships
+	const char *caller_name = q->caller && q->caller_uid != 0 &&
+	    !same_user(q->caller, q->target) ? q->caller->pw_name : NULL;
+	const char *target_name = q->target ? q->target->pw_name : NULL;
+#endif
+
+	// Pass 2: suex group, target group and memberships from group
+	acct_iter_init(&it, &db->group);
+	while (acct_next_gr(&it, &ge)) {
+		if (!suex_found && acct_str_eq(&ge.name, SUEX_GROUP)) {
+			suex_found = 1;
+			suex_gid = ge.gid;
+			// Lines already seen count if they carry the same gid
+			caller_in = caller_name &&
+			    (q->caller->pw_gid == suex_gid ||
+			     has_gid(caller_groups, caller_n, suex_gid));
+		}
+		if (q->group && !q->group_found &&
+		    acct_str_eq(&ge.name, q->group)) {
+			q->group_found = 1;
+			q->group_gid = ge.gid;
+		}
+		// Once the suex gid is known only lines carrying it matter
+		if (caller_name && !caller_in &&
+		    (!suex_found || ge.gid == suex_gid) &&
+		    acct_has_member(&ge, caller_name)) {
+			if (suex_found) {
+				caller_in = 1;
+			} else if (add_gid(&caller_groups, &caller_n,
+					   &caller_cap, ge.gid) < 0) {
+				ret = -1;
+				break;
+			}
+		}
+		if (target_name && acct_has_member(&ge, target_name) &&
+		    add_gid(&q->groups, &q->ngroups, &groups_cap,
+			    ge.gid) < 0) {
+			ret = -1;
+			break;
+		}
+		// Without a target, a positive answer ends the scan
+		if (!target_name && suex_found && (caller_in || !caller_name) &&
+		    (!q->group || q->group_found))
+			break;
+	}
+#ifdef ACCT_NSS
+	if (!suex_found) {
+		struct group *gr = acct_getgrnam(db, SUEX_GROUP);
+		if (gr) {
+			suex_found = 1;
+			suex_gid = gr->gr_gid;
+			free(gr);
+		}
+	}
+	if (q->group && !q->group_found) {
+		struct group *gr = acct_getgrnam(db, q->group);
+		if (gr) {
+			q->group_found = 1;
+			q->group_gid = gr->gr_gid;
+			free(gr);
+		}
+	}
+#endif
+
+	// Same rule as before: the group must exist, root always passes
+	if (suex_found) {
+		if (q->caller_uid == 0) {
+			q->in_suex_group = 1;
+		} else if (q->caller) {
+#ifdef ACCT_NSS
+			q->in_suex_group = nss_in_group(db, q, suex_gid);
+			if (q->in_suex_group < 0) {
+				q->in_suex_group = 0;
+				ret = -1;
+			}
+#else
+			if (caller_name)
+				q->in_suex_group = caller_in;
+			else
+				q->in_suex_group =
+				    q->caller->pw_gid == suex_gid ||
+				    has_gid(q->groups, q->ngroups, suex_gid);
+#endif
+		}
+	}
+
+	free(caller_groups);
+	return ret;
+}
+
+void auth_query_free(struct auth_query *q)
+{
+	free(q->caller);
+	free(q->target);
+	free(q->groups);
+	free(q->caller_groups);
+	q->caller = NULL;
+	q->target = NULL;
+	q->groups = NULL;
+	q->ngroups = 0;
+	q->caller_groups = NULL;
+	q->caller_ngroups = 0;
+}
+
+int auth_grouplist(const struct acct_db *db, const struct auth_query *q,
+		   gid_t base, gid_t **list, int *n)
+{
+#ifdef ACCT_NSS
+	// The membership check may already have fetched this very list
+	if (q->caller_groups && same_user(q->caller, q->target) &&
+	    base == q->caller->pw_gid) {
+		*list = malloc(q->caller_ngroups * sizeof(gid_t));
+		if (!*list) {
+			return -1;
 		}
+		memcpy(*list, q->caller_groups,
+		       q->caller_ngroups * sizeof(gid_t));
+		*n = q->caller_ngroups;
+		return 0;
 	}
+	return acct_getgrouplist(db, q->target->pw_name, base, list, n);
+#else
+	int cap = 0;
 
+	(void)db;
+	*list = NULL;
+	*n = 0;
+	if (add_gid(list, n, &cap, base) < 0) {
+		return -1;
+	}
+	for (int i = 0; i < q->ngroups; i++) {
+		int dup = 0;
+		for (int j = 0; j < *n; j++) {
+			if ((*list)[j] == q->groups[i]) {
+				dup = 1;
+				break;
+			}
+		}
+		if (!dup && add_gid(list, n, &cap, q->groups[i]) < 0) {
+			free(*list);
+			*list = NULL;
+			return -1;
+		}
+	}
 	return 0;
+#endif
 }
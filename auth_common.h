@@ -7,12 +7,46 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-// Maximum number of groups to check
-#define MAX_GROUPS 100
+#include "acct_common.h"
+
 // Name of the group that can use this utility
 #define SUEX_GROUP "suex"
 
-// Check if the current user belongs to the suex group
-int user_in_suex_group(void);
+/*
+ * Everything needed to authorize the caller and switch to the target,
+ * resolved from the prebuilt index when acct_open() found a current one,
+ * otherwise with one pass over passwd and one over group.
+ */
+struct auth_query {
+	// Inputs
+	uid_t caller_uid;	// real uid of the caller
+	const char *user;	// target user name
+	int by_uid;		// resolve the target by uid instead of name
+	uid_t uid;		// target uid when by_uid is set
+	const char *group;	// target group name, or NULL
+
+	// Results, NULL/0 when not found
+	struct passwd *caller;
+	struct passwd *target;
+	int in_suex_group;
+	int group_found;
+	gid_t group_gid;
+	gid_t *groups;		// groups listing the target as a member
+	int ngroups;
+	gid_t *caller_groups;	// caller's full group list, NSS builds only,
+	int caller_ngroups;	// when the suex group check needed it
+};
+
+// Resolve a query; returns -1 only on allocation failure
+int auth_resolve(const struct acct_db *db, struct auth_query *q);
+void auth_query_free(struct auth_query *q);
+
+/*
+ * Build the target's supplementary group list with base as the first
+ * entry, the same list getgrouplist(target, base) returns.  *list is
+ * malloc'd.
+ */
+int auth_grouplist(const struct acct_db *db, const struct auth_query *q,
+		   gid_t base, gid_t **list, int *n);
 
 #endif /* AUTH_COMMON_H */
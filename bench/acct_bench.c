@@ -0,0 +1,194 @@
+/**
+ * acct_bench.c - Account resolution: NSS calls vs the built-in reader
+ *
+ * Replays the lookups suex performs before dropping privileges against a
+ * generated database: once through NSS the way suex used to, once through
+ * acct_open() + auth_resolve() scanning the files, and once more with a
+ * prebuilt index.
+ *
+ * Usage: acct-bench [USERS [GROUPS [GROUPS_PER_USER [ITERATIONS]]]]
+ */
+
+#include "bench.h"
+
+#include <grp.h>
+#include <pwd.h>
+
+#include "acct_index.h"
+#include "auth_common.h"
+
+#define OLD_MAX_GROUPS 100
+
+struct params {
+	const char *dir;
+	int nusers;
+	int ngroups;
+	int per_user;
+	int iterations;
+};
+
+// What suex did per invocation before the built-in reader
+static int resolve_nss(uid_t caller_uid, const char *target)
+{
+	gid_t groups[OLD_MAX_GROUPS];
+	int ngroups = OLD_MAX_GROUPS;
+	int found = 0;
+
+	// user_in_suex_group()
+	struct group *gr = getgrnam(SUEX_GROUP);
+	if (!gr)
+		return -1;
+	gid_t suex_gid = gr->gr_gid;
+	struct passwd *pw = getpwuid(caller_uid);
+	if (!pw)
+		return -1;
+	getgrouplist(pw->pw_name, pw->pw_gid, groups, &ngroups);
+	for (int i = 0; i < ngroups; i++)
+		found |= groups[i] == suex_gid;
+
+	// main(): caller, then target
+	if (!getpwuid(caller_uid))
+		return -1;
+	pw = getpwnam(target);
+	if (!pw)
+		return -1;
+
+	// setup_groups()
+	char *name = strdup(pw->pw_name);
+	gid_t gid = pw->pw_gid;
+	int n = 0;
+	getgrouplist(name, gid, NULL, &n);
+	gid_t *list = malloc(n * sizeof(gid_t));
+	getgrouplist(name, gid, list, &n);
+	free(list);
+	free(name);
+	return found ? n : -1;
+}
+
+// index is NULL to scan the files
+static int resolve_acct(uid_t caller_uid, const char *target,
+			const char *index)
+{
+	struct acct_db db;
+	struct auth_query q = { 0 };
+	gid_t *list;
+	int n;
+
+	// What acct_open(ACCT_INDEX) does, with the index at another path
+	if (index) {
+		memset(&db, 0, sizeof(db));
+		db.index = acct_index_open(index);
+		if (!db.index)
+			return -1;
+	} else {
+		acct_open(&db, ACCT_PASSWD | ACCT_GROUP);
+	}
+	q.caller_uid = caller_uid;
+	q.user = target;
+	if (auth_resolve(&db, &q) < 0 || !q.in_suex_group || !q.target ||
+	    auth_grouplist(&db, &q, q.target->pw_gid, &list, &n) < 0) {
+		auth_query_free(&q);
+		acct_close(&db);
+		return -1;
+	}
+	free(list);
+	auth_query_free(&q);
+	acct_close(&db);
+	return n;
+}
+
+// `usrx index build` against the generated files
+static int build_index(const char *path)
+{
+	struct acct_db db;
+	struct acct_table t;
+
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP | ACCT_SHADOW);
+	if (acct_table_load(&t, &db, 1) < 0)
+		return -1;
+	int ret = acct_index_write(&t, &db, path);
+	acct_table_free(&t);
+	acct_close(&db);
+	return ret;
+}
+
+static int run(void *arg)
+{
+	const struct params *p = arg;
+	uid_t caller_uid = BENCH_BASE_ID + p->nusers / 2;
+	char target[32], index[4096];
+	uint64_t *samples = malloc(p->iterations * sizeof(uint64_t));
+
+	snprintf(target, sizeof(target), "u%d", p->nusers - 1);
+	snprintf(index, sizeof(index), "%s/accounts.idx", p->dir);
+	if (build_index(index) < 0) {
+		perror("build index");
+		return 1;
+	}
+
+	int n_nss = resolve_nss(caller_uid, target);
+	int n_acct = resolve_acct(caller_uid, target, NULL);
+	int n_index = resolve_acct(caller_uid, target, index);
+	if (n_nss < 0 || n_nss != n_acct || n_acct != n_index) {
+		fprintf(stderr, "results differ: nss=%d acct=%d index=%d\n",
+			n_nss, n_acct, n_index);
+		return 1;
+	}
+
+	printf("%d users, %d groups, %d groups/user, target in %d groups\n",
+	       p->nusers, p->ngroups, p->per_user, n_acct);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		resolve_nss(caller_uid, target);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report("nss (getpw*/getgrouplist)", samples, p->iterations);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		resolve_acct(caller_uid, target, NULL);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report("acct (mmap, single pass)", samples, p->iterations);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		resolve_acct(caller_uid, target, index);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report("acct (prebuilt index)", samples, p->iterations);
+
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct params p = { NULL, 50000, 20000, 8, 50 };
+	char members[32];
+
+	if (argc > 1)
+		p.nusers = atoi(argv[1]);
+	if (argc > 2)
+		p.ngroups = atoi(argv[2]);
+	if (argc > 3)
+		p.per_user = atoi(argv[3]);
+	if (argc > 4)
+		p.iterations = atoi(argv[4]);
+	if (p.nusers < 2 || p.ngroups < 1 || p.iterations < 1) {
+		fprintf(stderr,
+			"Usage: %s [USERS [GROUPS [GROUPS_PER_USER [ITERATIONS]]]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	snprintf(members, sizeof(members), "u%d", p.nusers / 2);
+	char *dir = bench_mkdb(p.nusers, p.ngroups, p.per_user, members);
+	if (!dir)
+		return 1;
+	p.dir = dir;
+	int ret = bench_in_db(dir, run, &p);
+	bench_cleanup(dir);
+	return ret;
+}
@@ -0,0 +1,226 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Shared helpers for the benchmarks: timing, percentile reports and a
+ * synthetic account database mounted over /etc in a private namespace,
+ * so nothing on the host is touched.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// First uid/gid handed out to generated accounts
+#define BENCH_BASE_ID 10000
+
+static inline uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline int bench_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+struct bench_stats {
+	double mean_us;
+	double p50_us;
+	double p99_us;
+};
+
+// Sort samples in place and summarize them in microseconds
+static inline void bench_stats(uint64_t *samples, int n,
+			       struct bench_stats *st)
+{
+	uint64_t sum = 0;
+
+	qsort(samples, n, sizeof(*samples), bench_cmp_u64);
+	for (int i = 0; i < n; i++)
+		sum += samples[i];
+	st->mean_us = sum / (double)n / 1000.0;
+	st->p50_us = samples[n / 2] / 1000.0;
+	st->p99_us = samples[(int)(n * 0.99)] / 1000.0;
+}
+
+// Sort samples in place and print mean/p50/p99 in microseconds
+static inline void bench_report(const char *name, uint64_t *samples, int n)
+{
+	struct bench_stats st;
+
+	bench_stats(samples, n, &st);
+	printf("%-28s n=%-6d mean=%10.1fus p50=%10.1fus p99=%10.1fus\n",
+	       name, n, st.mean_us, st.p50_us, st.p99_us);
+}
+
+/*
+ * Write passwd, group and shadow for nusers users and ngroups groups into
+ * dir.  User uN has uid/gid BASE+N and is a member of per_user groups;
+ * every group gets about nusers*per_user/ngroups members.  A "suex" group
+ * is appended last, listing the users named in suex_members.
+ */
+static inline int bench_gen_db(const char *dir, int nusers, int ngroups,
+			       int per_user, const char *suex_members)
+{
+	char path[4096];
+	FILE *pw, *gr, *sp;
+	int classes = per_user > 0 ? ngroups / per_user : ngroups;
+
+	if (classes < 1)
+		classes = 1;
+
+	snprintf(path, sizeof(path), "%s/passwd", dir);
+	pw = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/group", dir);
+	gr = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s/shadow", dir);
+	sp = fopen(path, "w");
+	if (!pw || !gr || !sp)
+		return -1;
+
+	fprintf(pw, "root:x:0:0:root:/root:/bin/sh\n");
+	fprintf(gr, "root:x:0:\n");
+	fprintf(sp, "root:*:19000:0:99999:7:::\n");
+	for (int i = 0; i < nusers; i++) {
+		fprintf(pw, "u%d:x:%d:%d:User %d:/home/u%d:/bin/sh\n", i,
+			BENCH_BASE_ID + i, BENCH_BASE_ID + i % ngroups, i, i);
+		fprintf(sp, "u%d:$6$rounds=5000$salt%d$hash:19000:0:99999:7:::\n",
+			i, i);
+	}
+	// Group j lists every user whose class matches j's
+	for (int j = 0; j < ngroups; j++) {
+		const char *sep = "";
+		fprintf(gr, "g%d:x:%d:", j, BENCH_BASE_ID + j);
+		if (per_user > 0) {
+			for (int i = j % classes; i < nusers; i += classes) {
+				fprintf(gr, "%su%d", sep, i);
+				sep = ",";
+			}
+		}
+		fputc('\n', gr);
+	}
+	fprintf(gr, "suex:x:%d:%s\n", BENCH_BASE_ID + ngroups,
+		suex_members ? suex_members : "");
+
+	if (fclose(pw) || fclose(gr) || fclose(sp))
+		return -1;
+	return 0;
+}
+
+static inline int bench_write_file(const char *path, const char *data)
+{
+	int fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t n = write(fd, data, strlen(data));
+	close(fd);
+	return n < 0 ? -1 : 0;
+}
+
+/*
+ * Move into a private mount namespace (and a user namespace when not
+ * root) and bind the generated files over the real ones in /etc.
+ */
+static inline int bench_enter_db(const char *dir)
+{
+	static const char *files[] = { "passwd", "group", "shadow", NULL };
+	uid_t uid = geteuid();
+	gid_t gid = getegid();
+	char buf[4096];
+
+	if (uid == 0) {
+		if (unshare(CLONE_NEWNS) < 0)
+			return -1;
+	} else {
+		if (unshare(CLONE_NEWUSER | CLONE_NEWNS) < 0)
+			return -1;
+		snprintf(buf, sizeof(buf), "0 %u 1\n", uid);
+		if (bench_write_file("/proc/self/uid_map", buf) < 0)
+			return -1;
+		bench_write_file("/proc/self/setgroups", "deny");
+		snprintf(buf, sizeof(buf), "0 %u 1\n", gid);
+		if (bench_write_file("/proc/self/gid_map", buf) < 0)
+			return -1;
+	}
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0)
+		return -1;
+	for (int i = 0; files[i]; i++) {
+		char src[4096], dst[64];
+		snprintf(src, sizeof(src), "%s/%s", dir, files[i]);
+		snprintf(dst, sizeof(dst), "/etc/%s", files[i]);
+		if (mount(src, dst, NULL, MS_BIND, NULL) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+// Create a scratch directory holding a generated database
+static inline char *bench_mkdb(int nusers, int ngroups, int per_user,
+			       const char *suex_members)
+{
+	char *dir = strdup("/tmp/suex-bench.XXXXXX");
+
+	if (!dir || !mkdtemp(dir)) {
+		perror("mkdtemp");
+		return NULL;
+	}
+	if (bench_gen_db(dir, nusers, ngroups, per_user, suex_members) < 0) {
+		perror("generate database");
+		return NULL;
+	}
+	return dir;
+}
+
+// Run fn in a child that sees the database in dir as /etc
+static inline int bench_in_db(const char *dir, int (*fn)(void *), void *arg)
+{
+	int status;
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		if (bench_enter_db(dir) < 0) {
+			perror("enter private namespace");
+			_exit(1);
+		}
+		int ret = fn(arg);
+		fflush(stdout);
+		_exit(ret);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Remove the scratch directory and its files
+static inline void bench_cleanup(char *dir)
+{
+	static const char *files[] = {
+		"passwd", "group", "shadow", "accounts.idx", NULL
+	};
+	char path[4096];
+
+	for (int i = 0; files[i]; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+	free(dir);
+}
+
+#endif /* BENCH_H */
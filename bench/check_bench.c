@@ -0,0 +1,108 @@
+/**
+ * check_bench.c - Bulk password verification with usrx check
+ *
+ * Generates 1000 users with SHA-512 shadow hashes and verifies a password
+ * for each: once as one `usrx check USER PASSWORD` process per user (for
+ * the first SINGLE_USERS users) and once as a single `usrx check --batch`
+ * run over all of them.  Prints checks per second for both; --batch uses
+ * every CPU the process may run on.
+ *
+ * Usage: check-bench [TOOLDIR]
+ */
+
+#include "bench.h"
+
+#include <libgen.h>
+#include <limits.h>
+
+#define NUSERS 1000
+#define SINGLE_USERS 200
+
+struct params {
+	const char *usrx;
+};
+
+static int spawn(char *const argv[], int in_fd)
+{
+	int status;
+	pid_t pid = fork();
+
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		int null = open("/dev/null", O_WRONLY);
+		if (in_fd >= 0)
+			dup2(in_fd, STDIN_FILENO);
+		dup2(null, STDOUT_FILENO);
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void report(const char *name, int checks, uint64_t ns)
+{
+	printf("  %-24s %5d checks %10.1fms %10.1f checks/s\n", name, checks,
+	       ns / 1e6, checks / (ns / 1e9));
+}
+
+static int run(void *arg)
+{
+	const struct params *p = arg;
+	char user[32], input[] = "/tmp/suex-bench-check.XXXXXX";
+
+	// One process per check, as scripts do today
+	uint64_t t = bench_now_ns();
+	for (int i = 0; i < SINGLE_USERS; i++) {
+		snprintf(user, sizeof(user), "u%d", i);
+		char *argv[] = { (char *)p->usrx, "check", user, "bench", NULL };
+		if (spawn(argv, -1) < 0)
+			return 1;
+	}
+	report("usrx check USER PW", SINGLE_USERS, bench_now_ns() - t);
+
+	int fd = mkstemp(input);
+	if (fd < 0)
+		return 1;
+	unlink(input);
+	FILE *f = fdopen(fd, "w+");
+	for (int i = 0; i < NUSERS; i++)
+		fprintf(f, "u%d\tbench\n", i);
+	fflush(f);
+	lseek(fd, 0, SEEK_SET);
+
+	char *argv[] = { (char *)p->usrx, "check", "--batch", NULL };
+	t = bench_now_ns();
+	if (spawn(argv, fd) < 0)
+		return 1;
+	report("usrx check --batch", NUSERS, bench_now_ns() - t);
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char usrx[PATH_MAX];
+	struct params p = {.usrx = usrx };
+
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [TOOLDIR]\n", argv[0]);
+		return 1;
+	}
+	snprintf(usrx, sizeof(usrx), "%s/usrx",
+		 argc > 1 ? argv[1] : dirname(strdup(argv[0])));
+	if (access(usrx, X_OK) < 0) {
+		fprintf(stderr, "%s: not built\n", usrx);
+		return 1;
+	}
+
+	char *dir = bench_mkdb(NUSERS, 10, 1, NULL);
+	if (!dir)
+		return 1;
+	printf("%d users, SHA-512 (5000 rounds)\n", NUSERS);
+	int ret = bench_in_db(dir, run, &p);
+	bench_cleanup(dir);
+	return ret;
+}
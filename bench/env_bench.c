@@ -0,0 +1,248 @@
+/**
+ * env_bench.c - Building the target environment with large inherited ones
+ *
+ * Times how suex, suex -l and sush build the environment they exec with,
+ * the way they did it before env_common (setenv() and clearenv() on
+ * environ, strdup() per variable) against the shared single-block
+ * builder, for inherited environments of 100, 1000 and 5000 variables.
+ * Each sample runs in a fresh child, as every invocation is a new process
+ * and glibc's setenv() caches the strings it has made.  Reports p50/p99
+ * time and the number of malloc(), calloc() and realloc() calls.
+ *
+ * Usage: env-bench [ITERATIONS]
+ */
+
+#define _GNU_SOURCE
+#include "bench.h"
+
+#include <pwd.h>
+
+#include "env_common.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static int counting;
+static long allocs;
+
+void *malloc(size_t size)
+{
+	allocs += counting;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	allocs += counting;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocs += counting;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+static const char *session[] = {
+	"TERM", "COLORTERM", "TERM_PROGRAM", "TERM_PROGRAM_VERSION",
+	"LANG", "LC_ALL", "LC_CTYPE", "LC_MESSAGES", "LC_TIME",
+	"LC_NUMERIC", "LC_MONETARY", "LC_COLLATE",
+	"DISPLAY", "WAYLAND_DISPLAY", "XAUTHORITY",
+	"TMUX", "TMUX_PANE", "STY",
+	"SSH_TTY", "SSH_CLIENT", "SSH_CONNECTION", "SSH_AUTH_SOCK",
+	NULL
+};
+
+static struct passwd pw = {
+	.pw_name = "u0",
+	.pw_uid = 10000,
+	.pw_gid = 10000,
+	.pw_dir = "/home/u0",
+	.pw_shell = "/bin/sh",
+};
+
+// suex before: USER and HOME replaced with setenv()
+static char **suex_setenv(void)
+{
+	setenv("USER", pw.pw_name, 1);
+	setenv("HOME", pw.pw_dir, 1);
+	return environ;
+}
+
+static char **suex_builder(void)
+{
+	struct env_builder env;
+
+	env_init(&env, environ);
+	env_set(&env, "USER", pw.pw_name);
+	env_set(&env, "HOME", pw.pw_dir);
+	return env_build(&env);
+}
+
+// suex -l before: session variables saved, clearenv(), setenv() each
+static char **login_setenv(void)
+{
+	char *saved[32];
+	char mail[4096], path[4096];
+
+	for (int i = 0; session[i]; i++) {
+		char *val = getenv(session[i]);
+		saved[i] = val ? strdup(val) : NULL;
+	}
+	clearenv();
+	setenv("HOME", pw.pw_dir, 1);
+	setenv("USER", pw.pw_name, 1);
+	setenv("LOGNAME", pw.pw_name, 1);
+	setenv("SHELL", pw.pw_shell, 1);
+	snprintf(mail, sizeof(mail), "/var/mail/%s", pw.pw_name);
+	setenv("MAIL", mail, 1);
+	snprintf(path, sizeof(path), "%s/.local/bin:/usr/local/bin:/usr/bin:/bin",
+		 pw.pw_dir);
+	setenv("PATH", path, 1);
+	for (int i = 0; session[i]; i++) {
+		if (saved[i]) {
+			setenv(session[i], saved[i], 1);
+			free(saved[i]);
+		}
+	}
+	return environ;
+}
+
+// suex -l and sush now
+static char **login_builder(void)
+{
+	struct env_builder env;
+
+	env_init(&env, NULL);
+	env_login(&env, &pw, pw.pw_shell, 0, environ);
+	return env_build(&env);
+}
+
+// sush before: snprintf() into a stack buffer and strdup() per variable
+static char **sush_strdup(void)
+{
+	char buf[4096];
+	int n = 0, nsession = 0;
+
+	for (int i = 0; session[i]; i++)
+		nsession += getenv(session[i]) != NULL;
+	char **env = malloc((6 + nsession + 1) * sizeof(char *));
+	snprintf(buf, sizeof(buf), "HOME=%s", pw.pw_dir);
+	env[n++] = strdup(buf);
+	snprintf(buf, sizeof(buf), "SHELL=%s", pw.pw_shell);
+	env[n++] = strdup(buf);
+	snprintf(buf, sizeof(buf), "USER=%s", pw.pw_name);
+	env[n++] = strdup(buf);
+	snprintf(buf, sizeof(buf), "LOGNAME=%s", pw.pw_name);
+	env[n++] = strdup(buf);
+	snprintf(buf, sizeof(buf),
+		 "PATH=%s/.local/bin:/usr/local/bin:/usr/bin:/bin", pw.pw_dir);
+	env[n++] = strdup(buf);
+	snprintf(buf, sizeof(buf), "MAIL=/var/mail/%s", pw.pw_name);
+	env[n++] = strdup(buf);
+	for (int i = 0; session[i]; i++) {
+		char *val = getenv(session[i]);
+		if (val) {
+			snprintf(buf, sizeof(buf), "%s=%s", session[i], val);
+			env[n++] = strdup(buf);
+		}
+	}
+	env[n] = NULL;
+	return env;
+}
+
+// Caller environment: nvars CI-style variables plus a terminal session
+static char **make_env(int nvars)
+{
+	char **env = calloc(nvars + 8, sizeof(char *));
+	int n = 0;
+
+	env[n++] = "PATH=/usr/local/bin:/usr/bin:/bin";
+	env[n++] = "HOME=/root";
+	env[n++] = "USER=root";
+	env[n++] = "TERM=xterm-256color";
+	env[n++] = "LANG=C.UTF-8";
+	env[n++] = "SSH_TTY=/dev/pts/0";
+	for (int i = 0; i < nvars; i++) {
+		if (asprintf(&env[n++], "CI_VAR_%d=value of build variable %d",
+			     i, i) < 0)
+			return NULL;
+	}
+	env[n] = NULL;
+	return env;
+}
+
+static void measure(const char *name, char **(*build)(void), char **env,
+		    int iterations)
+{
+	uint64_t *samples = malloc(iterations * sizeof(uint64_t));
+	struct bench_stats st;
+	long total_allocs = 0;
+
+	for (int i = 0; i < iterations; i++) {
+		uint64_t result[2] = { 0, 0 };
+		int fds[2];
+
+		if (pipe(fds) < 0)
+			return;
+		pid_t pid = fork();
+		if (pid == 0) {
+			environ = env;
+			counting = 1;
+			uint64_t t = bench_now_ns();
+			char **envp = build();
+			result[0] = bench_now_ns() - t;
+			counting = 0;
+			result[1] = allocs;
+			if (!envp || write(fds[1], result, sizeof(result)) < 0)
+				_exit(1);
+			_exit(0);
+		}
+		close(fds[1]);
+		if (read(fds[0], result, sizeof(result)) != sizeof(result))
+			result[0] = result[1] = 0;
+		close(fds[0]);
+		waitpid(pid, NULL, 0);
+		samples[i] = result[0];
+		total_allocs += result[1];
+	}
+	bench_stats(samples, iterations, &st);
+	printf("  %-24s p50=%8.2fus p99=%8.2fus  allocations=%ld\n", name,
+	       st.p50_us, st.p99_us, total_allocs / iterations);
+	free(samples);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int sizes[] = { 100, 1000, 5000 };
+	int iterations = 200;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2 || iterations < 1) {
+		fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		char **env = make_env(sizes[i]);
+		if (!env)
+			return 1;
+		printf("%d inherited variables\n", sizes[i]);
+		fflush(stdout);
+		measure("suex (setenv)", suex_setenv, env, iterations);
+		measure("suex (builder)", suex_builder, env, iterations);
+		measure("suex -l (setenv)", login_setenv, env, iterations);
+		measure("sush (strdup)", sush_strdup, env, iterations);
+		measure("suex -l, sush (builder)", login_builder, env,
+			iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * groups_bench.c - Group name resolution for users in many groups
+ *
+ * Compares three ways of producing what `usrx groups` prints: NSS
+ * getgrouplist() plus getgrgid() per gid (the original code), the
+ * built-in reader doing the same per-gid scans, and acct_getgroupnames()
+ * resolving everything in one scan.
+ *
+ * Usage: groups-bench [USERS [GROUPS [GROUPS_PER_USER [ITERATIONS]]]]
+ */
+
+#include "bench.h"
+
+#include <grp.h>
+#include <pwd.h>
+
+#include "acct_common.h"
+
+struct params {
+	int nusers;
+	int ngroups;
+	int per_user;
+	int iterations;
+};
+
+static int names_nss(const char *user, gid_t gid)
+{
+	int n = 0, found = 0;
+
+	getgrouplist(user, gid, NULL, &n);
+	gid_t *list = malloc(n * sizeof(gid_t));
+	getgrouplist(user, gid, list, &n);
+	for (int i = 0; i < n; i++)
+		found += getgrgid(list[i]) != NULL;
+	free(list);
+	return found;
+}
+
+static int names_per_gid(const struct acct_db *db, const char *user,
+			 gid_t gid)
+{
+	gid_t *list;
+	int n, found = 0;
+
+	if (acct_getgrouplist(db, user, gid, &list, &n) < 0)
+		return -1;
+	for (int i = 0; i < n; i++) {
+		struct group *gr = acct_getgrgid(db, list[i]);
+		found += gr != NULL;
+		free(gr);
+	}
+	free(list);
+	return found;
+}
+
+static int names_single_scan(const struct acct_db *db, const char *user,
+			     gid_t gid)
+{
+	struct acct_gname *list;
+	int n;
+
+	if (acct_getgroupnames(db, user, gid, &list, &n) < 0)
+		return -1;
+	acct_gnames_free(list, n);
+	return n;
+}
+
+static int run(void *arg)
+{
+	const struct params *p = arg;
+	uint64_t *samples = malloc(p->iterations * sizeof(uint64_t));
+	struct acct_db db;
+	char user[32];
+	gid_t gid = BENCH_BASE_ID + (p->nusers - 1) % p->ngroups;
+
+	snprintf(user, sizeof(user), "u%d", p->nusers - 1);
+	acct_open(&db, ACCT_GROUP);
+
+	int n_nss = names_nss(user, gid);
+	int n_gid = names_per_gid(&db, user, gid);
+	int n_scan = names_single_scan(&db, user, gid);
+	if (n_nss != n_gid || n_gid != n_scan) {
+		fprintf(stderr, "results differ: nss=%d per-gid=%d scan=%d\n",
+			n_nss, n_gid, n_scan);
+		return 1;
+	}
+	printf("%d users, %d groups, user in %d groups\n", p->nusers,
+	       p->ngroups, n_scan);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		names_nss(user, gid);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report("nss (getgrgid per gid)", samples, p->iterations);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		names_per_gid(&db, user, gid);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report("acct (scan per gid)", samples, p->iterations);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		names_single_scan(&db, user, gid);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report("acct (single scan)", samples, p->iterations);
+
+	acct_close(&db);
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct params p = { 2000, 10000, 320, 10 };
+
+	if (argc > 1)
+		p.nusers = atoi(argv[1]);
+	if (argc > 2)
+		p.ngroups = atoi(argv[2]);
+	if (argc > 3)
+		p.per_user = atoi(argv[3]);
+	if (argc > 4)
+		p.iterations = atoi(argv[4]);
+	if (p.nusers < 1 || p.ngroups < 1 || p.iterations < 1) {
+		fprintf(stderr,
+			"Usage: %s [USERS [GROUPS [GROUPS_PER_USER [ITERATIONS]]]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	char *dir = bench_mkdb(p.nusers, p.ngroups, p.per_user, NULL);
+	if (!dir)
+		return 1;
+	int ret = bench_in_db(dir, run, &p);
+	bench_cleanup(dir);
+	return ret;
+}
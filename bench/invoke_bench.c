@@ -0,0 +1,337 @@
+/**
+ * invoke_bench.c - End-to-end invocation cost of suex, sush, usrx and uarch
+ *
+ * Generates account databases of 1k, 10k, 50k and 500k users, each with a
+ * light user in one group (u0) and a heavy user in 1000 groups (u1), and
+ * runs every command form against them in a private namespace.  For each
+ * form it reports p50/p99 wall time of fork+exec+wait, the syscalls the
+ * tool makes (counted under ptrace, up to the exec of its payload) and the
+ * tool's peak RSS, and writes everything as JSON so runs can be diffed
+ * between commits.
+ *
+ * Usage: invoke-bench [-n ITERATIONS] [-u USERS[,USERS...]] [-o FILE] [TOOLDIR]
+ *
+ * TOOLDIR defaults to the directory holding invoke-bench and FILE to
+ * TOOLDIR/invoke-bench.json.  suex and sush can only switch users with
+ * real root, so they are skipped when run unprivileged.
+ */
+
+#include "bench.h"
+
+#include <libgen.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+
+#define HEAVY_GROUPS 1000
+#define MAX_SIZES 8
+
+// A command line; "USER" is replaced by the target user
+struct form {
+	const char *name;
+	const char *tool;
+	const char *args[6];
+	int needs_root;
+	int per_user;		// run for each target user, else once
+};
+
+static const struct form forms[] = {
+	{"suex user cmd", "suex", {"USER", "/bin/true"}, 1, 1},
+	{"suex -l user cmd", "suex", {"-l", "USER", "/bin/true"}, 1, 1},
+	{"sush user", "sush", {"-s", "/bin/true", "USER"}, 1, 1},
+	{"usrx info -j", "usrx", {"info", "-j", "USER"}, 0, 1},
+	{"usrx groups", "usrx", {"groups", "USER"}, 0, 1},
+	{"usrx check", "usrx", {"check", "USER", "bench"}, 0, 1},
+	{"usrx members", "usrx", {"members", "g0"}, 0, 0},
+	{"usrx dump", "usrx", {"dump"}, 0, 0},
+	{"usrx dump -o json", "usrx", {"dump", "-o", "json"}, 0, 0},
+	{"usrx dump -o tsv", "usrx", {"dump", "-o", "tsv"}, 0, 0},
+	{"uarch", "uarch", {NULL}, 0, 0},
+	{"uarch -l -f", "uarch", {"-l", "-f"}, 0, 0},
+	{"uarch --topology", "uarch", {"--topology"}, 0, 0},
+	{"uarch --limits", "uarch", {"--limits"}, 0, 0},
+};
+
+static const struct {
+	const char *name;
+	int ngroups;
+} targets[] = {
+	{"u0", 1},
+	{"u1", HEAVY_GROUPS},
+};
+
+struct params {
+	const char *tooldir;
+	int nusers;
+	int ngroups;
+	int iterations;
+	int real_root;
+	FILE *json;
+	int need_comma;
+};
+
+// Make u1 a member of HEAVY_GROUPS groups in total
+static int add_heavy_user(const char *dir, int ngroups)
+{
+	char path[4096];
+
+	snprintf(path, sizeof(path), "%s/group", dir);
+	FILE *gr = fopen(path, "a");
+	if (!gr)
+		return -1;
+	for (int i = 1; i < HEAVY_GROUPS; i++)
+		fprintf(gr, "h%d:x:%d:u1\n", i, BENCH_BASE_ID + ngroups + i);
+	return fclose(gr);
+}
+
+static void null_stdio(void)
+{
+	int fd = open("/dev/null", O_RDWR);
+
+	if (fd < 0)
+		return;
+	dup2(fd, STDIN_FILENO);
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
+	if (fd > STDERR_FILENO)
+		close(fd);
+}
+
+// Run argv to completion; returns its exit status, 128+N for signal N
+static int spawn(char *const argv[])
+{
+	int status;
+	pid_t pid = fork();
+
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		null_stdio();
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status)
+	    : 128 + WTERMSIG(status);
+}
+
+static long peak_rss_kb(pid_t pid)
+{
+	char path[64], line[256];
+	long kb = -1;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	FILE *f = fopen(path, "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "VmHWM: %ld", &kb) == 1)
+			break;
+	}
+	fclose(f);
+	return kb;
+}
+
+/*
+ * Count the syscalls argv makes from its own exec up to and including the
+ * exec of its payload (or its exit), and the peak RSS it reached by then.
+ */
+static int trace(char *const argv[], long *syscalls, long *rss_kb)
+{
+	int status, in_call = 0, execs = 0;
+	pid_t pid = fork();
+
+	*syscalls = 0;
+	*rss_kb = -1;
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		null_stdio();
+		ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+		raise(SIGSTOP);
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+		return -1;
+	ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)
+	       (PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC |
+		PTRACE_O_EXITKILL));
+	ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+	while (waitpid(pid, &status, 0) == pid) {
+		if (WIFEXITED(status) || WIFSIGNALED(status))
+			return 0;
+		int sig = WSTOPSIG(status);
+		if (sig == (SIGTRAP | 0x80)) {
+			// Stops alternate between syscall entry and exit
+			if (!in_call && execs == 1) {
+				(*syscalls)++;
+				*rss_kb = peak_rss_kb(pid);
+			}
+			in_call = !in_call;
+			sig = 0;
+		} else if (status >> 8 == (SIGTRAP | (PTRACE_EVENT_EXEC << 8))) {
+			// The second exec is the payload: stop counting
+			if (++execs == 2) {
+				ptrace(PTRACE_DETACH, pid, NULL, NULL);
+				waitpid(pid, &status, 0);
+				return 0;
+			}
+			sig = 0;
+		}
+		ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)sig);
+	}
+	return -1;
+}
+
+static void run_form(struct params *p, const struct form *f,
+		     const char *user, int user_groups, uint64_t *samples)
+{
+	char tool[PATH_MAX];
+	char *argv[8];
+	const char *skip = NULL;
+	int n = 0;
+
+	snprintf(tool, sizeof(tool), "%s/%s", p->tooldir, f->tool);
+	argv[n++] = tool;
+	for (int i = 0; f->args[i]; i++)
+		argv[n++] = (char *)(strcmp(f->args[i], "USER") == 0 ? user
+				     : f->args[i]);
+	argv[n] = NULL;
+
+	if (access(tool, X_OK) < 0)
+		skip = "not built";
+	else if (f->needs_root && !p->real_root)
+		skip = "needs root";
+
+	fprintf(p->json, "%s\n    {\"users\": %d, \"groups\": %d, "
+		"\"form\": \"%s\"", p->need_comma ? "," : "", p->nusers,
+		p->ngroups, f->name);
+	if (f->per_user)
+		fprintf(p->json, ", \"target\": \"%s\", \"target_groups\": %d",
+			user, user_groups);
+	p->need_comma = 1;
+	if (skip) {
+		printf("  %-18s %-4s %s\n", f->name, f->per_user ? user : "",
+		       skip);
+		fprintf(p->json, ", \"skipped\": \"%s\"}", skip);
+		return;
+	}
+
+	// The first run warms the page cache and gives the exit status
+	int status = spawn(argv);
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		spawn(argv);
+		samples[i] = bench_now_ns() - t;
+	}
+	struct bench_stats st;
+	long syscalls, rss_kb;
+	bench_stats(samples, p->iterations, &st);
+	trace(argv, &syscalls, &rss_kb);
+
+	printf("  %-18s %-4s p50=%10.1fus p99=%10.1fus %5ld syscalls "
+	       "%6ld KB  exit %d\n", f->name, f->per_user ? user : "",
+	       st.p50_us, st.p99_us, syscalls, rss_kb, status);
+	fprintf(p->json, ", \"iterations\": %d, \"exit\": %d, "
+		"\"mean_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+		"\"syscalls\": %ld, \"max_rss_kb\": %ld}", p->iterations,
+		status, st.mean_us, st.p50_us, st.p99_us, syscalls, rss_kb);
+}
+
+static int run(void *arg)
+{
+	struct params *p = arg;
+	uint64_t *samples = malloc(p->iterations * sizeof(uint64_t));
+
+	if (!samples)
+		return 1;
+	printf("%d users, %d groups\n", p->nusers, p->ngroups);
+	for (size_t f = 0; f < sizeof(forms) / sizeof(forms[0]); f++) {
+		int nt = forms[f].per_user ? 2 : 1;
+		for (int t = 0; t < nt; t++)
+			run_form(p, &forms[f], targets[t].name,
+				 targets[t].ngroups, samples);
+	}
+	fflush(p->json);
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int sizes[MAX_SIZES] = { 1000, 10000, 50000, 500000 };
+	int nsizes = 4;
+	char default_json[PATH_MAX];
+	const char *json_path = NULL;
+	struct params p = { 0 };
+	int opt;
+
+	p.iterations = 20;
+	while ((opt = getopt(argc, argv, "n:u:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			p.iterations = atoi(optarg);
+			break;
+		case 'u':
+			nsizes = 0;
+			for (char *s = strtok(optarg, ","); s && nsizes < MAX_SIZES;
+			     s = strtok(NULL, ","))
+				sizes[nsizes++] = atoi(s);
+			break;
+		case 'o':
+			json_path = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (p.iterations < 1 || nsizes == 0 || argc - optind > 1)
+		goto usage;
+	for (int i = 0; i < nsizes; i++) {
+		if (sizes[i] < 2)
+			goto usage;
+	}
+	p.tooldir = optind < argc ? argv[optind] : dirname(strdup(argv[0]));
+	if (!json_path) {
+		snprintf(default_json, sizeof(default_json),
+			 "%s/invoke-bench.json", p.tooldir);
+		json_path = default_json;
+	}
+	p.json = fopen(json_path, "w");
+	if (!p.json) {
+		perror(json_path);
+		return 1;
+	}
+	p.real_root = geteuid() == 0;
+	fprintf(p.json, "{\n  \"iterations\": %d,\n  \"root\": %s,\n"
+		"  \"results\": [", p.iterations,
+		p.real_root ? "true" : "false");
+
+	int ret = 0;
+	for (int i = 0; i < nsizes && ret == 0; i++) {
+		p.nusers = sizes[i];
+		p.ngroups = sizes[i] / 10 > 1 ? sizes[i] / 10 : 2;
+		char *dir = bench_mkdb(p.nusers, p.ngroups, 1, NULL);
+		if (!dir || add_heavy_user(dir, p.ngroups) < 0) {
+			perror("generate database");
+			return 1;
+		}
+		fflush(p.json);
+		ret = bench_in_db(dir, run, &p);
+		bench_cleanup(dir);
+		p.need_comma = 1;
+	}
+	fprintf(p.json, "\n  ]\n}\n");
+	fclose(p.json);
+	printf("Results written to %s\n", json_path);
+	return ret;
+
+ usage:
+	fprintf(stderr,
+		"Usage: %s [-n ITERATIONS] [-u USERS[,USERS...]] [-o FILE] [TOOLDIR]\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,202 @@
+/**
+ * launch_bench.c - Launch rate of `suex --via-daemon` against direct suex
+ *
+ * Starts the built suexd on a private /run inside the benchmark namespace
+ * and runs `suex u0 /bin/true` back to back: directly, through the daemon
+ * with `suex --via-daemon`, and as a job runner would, by speaking the
+ * socket protocol itself.  Databases of 1k and 50k users are used.
+ * Reports launches per second with p50/p99 latency of each launch.
+ *
+ * Usage: launch-bench [-n LAUNCHES] [TOOLDIR]
+ *
+ * TOOLDIR defaults to the directory holding launch-bench.  suexd only
+ * runs as real root, so the benchmark does nothing otherwise.
+ */
+
+#include "bench.h"
+
+#include <libgen.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "daemon_common.h"
+
+struct params {
+	const char *tooldir;
+	int launches;
+};
+
+static int spawn(char *const argv[])
+{
+	int status;
+	pid_t pid = fork();
+
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		int fd = open("/dev/null", O_RDWR);
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// One launch over the socket, as `suex --via-daemon` does it
+static int submit(char *const argv[])
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX };
+	struct suexd_request req = {.magic = SUEXD_MAGIC };
+	struct suexd_reply reply;
+	int fds[SUEXD_NFDS];
+	char buf[65536];
+	size_t len = 0;
+
+	// argv[0] is the USER[:GROUP]; environ is sent as is
+	for (char *const *a = argv; *a; a++, req.argc++)
+		len += stpcpy(buf + len, *a) - (buf + len) + 1;
+	for (char **e = environ; *e && len + strlen(*e) < sizeof(buf);
+	     e++, req.envc++)
+		len += stpcpy(buf + len, *e) - (buf + len) + 1;
+	req.argc--;
+	req.len = len;
+	req.umask = 022;
+
+	fds[0] = fds[1] = fds[2] = open("/dev/null", O_RDWR);
+	fds[3] = open(".", O_PATH | O_DIRECTORY);
+	strcpy(addr.sun_path, SUEXD_SOCKET);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+
+	char control[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = {.iov_base = &req,.iov_len = sizeof(req) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+	struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+	int ret = -1;
+	if (sendmsg(fd, &msg, 0) == sizeof(req) &&
+	    write(fd, buf, len) == (ssize_t)len &&
+	    read(fd, &reply, sizeof(reply)) == sizeof(reply) && !reply.error)
+		ret = WIFEXITED(reply.status) ? WEXITSTATUS(reply.status) : -1;
+	close(fd);
+	close(fds[0]);
+	close(fds[3]);
+	return ret;
+}
+
+static void measure(struct params *p, const char *name,
+		    int (*launch)(char *const argv[]), char *const argv[],
+		    uint64_t *samples)
+{
+	struct bench_stats st;
+	int status = launch(argv);
+
+	uint64_t start = bench_now_ns();
+	for (int i = 0; i < p->launches; i++) {
+		uint64_t t = bench_now_ns();
+		launch(argv);
+		samples[i] = bench_now_ns() - t;
+	}
+	double secs = (bench_now_ns() - start) / 1e9;
+	bench_stats(samples, p->launches, &st);
+	printf("  %-20s %8.0f launches/s  p50=%8.1fus p99=%8.1fus  exit %d\n",
+	       name, p->launches / secs, st.p50_us, st.p99_us, status);
+}
+
+static int run(void *arg)
+{
+	struct params *p = arg;
+	char suex[PATH_MAX], suexd[PATH_MAX];
+	struct stat st;
+	uint64_t *samples = malloc(p->launches * sizeof(uint64_t));
+
+	if (!samples)
+		return 1;
+	snprintf(suex, sizeof(suex), "%s/suex", p->tooldir);
+	snprintf(suexd, sizeof(suexd), "%s/suexd", p->tooldir);
+	if (mount("none", "/run", "tmpfs", 0, NULL) < 0) {
+		perror("mount /run");
+		return 1;
+	}
+
+	pid_t daemon = fork();
+	if (daemon == 0) {
+		execl(suexd, suexd, (char *)NULL);
+		_exit(127);
+	}
+	for (int i = 0; i < 500 && stat(SUEXD_SOCKET, &st) < 0; i++)
+		usleep(10000);
+
+	char *direct[] = { suex, "u0", "/bin/true", NULL };
+	char *via[] = { suex, "--via-daemon", "u0", "/bin/true", NULL };
+	char *job[] = { "u0", "/bin/true", NULL };
+	measure(p, "suex u0 true", spawn, direct, samples);
+	measure(p, "suex --via-daemon", spawn, via, samples);
+	measure(p, "socket client", submit, job, samples);
+
+	kill(daemon, SIGTERM);
+	waitpid(daemon, NULL, 0);
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int sizes[] = { 1000, 50000 };
+	struct params p = {.launches = 2000 };
+	char suexd[PATH_MAX];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			p.launches = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (p.launches < 1 || argc - optind > 1)
+		goto usage;
+	p.tooldir = optind < argc ? argv[optind] : dirname(strdup(argv[0]));
+	snprintf(suexd, sizeof(suexd), "%s/suexd", p.tooldir);
+	if (getuid() != 0) {
+		printf("launch-bench: suexd needs real root, skipped\n");
+		return 0;
+	}
+	if (access(suexd, X_OK) < 0) {
+		printf("launch-bench: %s not built, skipped\n", suexd);
+		return 0;
+	}
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		char *dir = bench_mkdb(sizes[i], sizes[i] / 10, 1, NULL);
+		if (!dir)
+			return 1;
+		printf("%d users\n", sizes[i]);
+		int ret = bench_in_db(dir, run, &p);
+		bench_cleanup(dir);
+		if (ret != 0)
+			return ret;
+	}
+	return 0;
+
+ usage:
+	fprintf(stderr, "Usage: %s [-n LAUNCHES] [TOOLDIR]\n", argv[0]);
+	return 1;
+}
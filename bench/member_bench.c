@@ -0,0 +1,158 @@
+/**
+ * member_bench.c - suex group check for callers in many groups
+ *
+ * The caller u0 is a member of 10, 1k and 64k (NGROUPS_MAX) groups, with
+ * the suex group listed last.  Compares the original check, getgrouplist()
+ * into a fixed array of 100 gids, against a grown getgrouplist() and the
+ * built-in auth_resolve() on the files and on an in-memory index, and
+ * prints whether each one lets the caller in.
+ *
+ * Usage: member-bench [ITERATIONS]
+ */
+
+#include "bench.h"
+
+#include <grp.h>
+#include <pwd.h>
+
+#include "acct_index.h"
+#include "acct_table.h"
+#include "auth_common.h"
+
+#define OLD_MAX_GROUPS 100
+
+struct params {
+	int ngroups;
+	int iterations;
+};
+
+static int check_fixed(gid_t suex_gid)
+{
+	gid_t groups[OLD_MAX_GROUPS];
+	int n = OLD_MAX_GROUPS;
+
+	getgrouplist("u0", BENCH_BASE_ID, groups, &n);
+	if (n > OLD_MAX_GROUPS)
+		n = OLD_MAX_GROUPS;
+	for (int i = 0; i < n; i++) {
+		if (groups[i] == suex_gid)
+			return 1;
+	}
+	return 0;
+}
+
+static int check_grown(gid_t suex_gid)
+{
+	int n = 0, found = 0;
+
+	getgrouplist("u0", BENCH_BASE_ID, NULL, &n);
+	gid_t *list = malloc(n * sizeof(gid_t));
+	getgrouplist("u0", BENCH_BASE_ID, list, &n);
+	for (int i = 0; i < n && !found; i++)
+		found = list[i] == suex_gid;
+	free(list);
+	return found;
+}
+
+static int check_acct(const struct acct_db *db)
+{
+	struct auth_query q = {.caller_uid = BENCH_BASE_ID };
+
+	auth_resolve(db, &q);
+	int found = q.in_suex_group;
+	auth_query_free(&q);
+	return found;
+}
+
+static void report(const struct params *p, const char *name,
+		   int (*check)(const struct acct_db *, gid_t),
+		   const struct acct_db *db, gid_t suex_gid, uint64_t *samples)
+{
+	struct bench_stats st;
+	int allowed = check(db, suex_gid);
+
+	for (int i = 0; i < p->iterations; i++) {
+		uint64_t t = bench_now_ns();
+		check(db, suex_gid);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_stats(samples, p->iterations, &st);
+	printf("  %-24s p50=%10.1fus p99=%10.1fus  %s\n", name, st.p50_us,
+	       st.p99_us, allowed ? "allowed" : "DENIED");
+}
+
+static int via_fixed(const struct acct_db *db, gid_t gid)
+{
+	(void)db;
+	return check_fixed(gid);
+}
+
+static int via_grown(const struct acct_db *db, gid_t gid)
+{
+	(void)db;
+	return check_grown(gid);
+}
+
+static int via_acct(const struct acct_db *db, gid_t gid)
+{
+	(void)gid;
+	return check_acct(db);
+}
+
+static int run(void *arg)
+{
+	const struct params *p = arg;
+	uint64_t *samples = malloc(p->iterations * sizeof(uint64_t));
+	struct acct_db files, indexed;
+	struct acct_table t;
+	// bench_gen_db() appends the suex group after the generated ones
+	gid_t suex_gid = BENCH_BASE_ID + p->ngroups - 1;
+
+	if (!samples)
+		return 1;
+	acct_open(&files, ACCT_PASSWD | ACCT_GROUP);
+	acct_open(&indexed, ACCT_PASSWD | ACCT_GROUP);
+	if (acct_table_load(&t, &indexed, 1) < 0)
+		return 1;
+	indexed.index = acct_index_build(&t, &indexed);
+	acct_table_free(&t);
+	if (!indexed.index)
+		return 1;
+
+	printf("caller in %d groups\n", p->ngroups);
+	report(p, "getgrouplist[100]", via_fixed, NULL, suex_gid, samples);
+	report(p, "getgrouplist (grown)", via_grown, NULL, suex_gid, samples);
+	report(p, "auth_resolve (files)", via_acct, &files, suex_gid, samples);
+	report(p, "auth_resolve (index)", via_acct, &indexed, suex_gid, samples);
+
+	acct_close(&files);
+	acct_close(&indexed);
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int sizes[] = { 10, 1000, 65536 };
+	struct params p = {.iterations = 20 };
+
+	if (argc > 1)
+		p.iterations = atoi(argv[1]);
+	if (argc > 2 || p.iterations < 1) {
+		fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		p.ngroups = sizes[i];
+		// Ten users, all in every group, so u0 is in ngroups - 1 + suex
+		char *dir = bench_mkdb(10, sizes[i] - 1, sizes[i] - 1, "u0");
+		if (!dir)
+			return 1;
+		int ret = bench_in_db(dir, run, &p);
+		bench_cleanup(dir);
+		if (ret != 0)
+			return ret;
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * members_bench.c - Listing the members of a 50,000-member group
+ *
+ * Generates 100,000 users in two groups, so group g0 lists 50,000 of them
+ * and is the primary group of the same 50,000.  Compares what scripts do
+ * today, one acct_getgrouplist() per user checking for the gid (timed over
+ * the first LOOP_USERS users and scaled to all of them), with
+ * acct_getmembers() doing one pass over group and one over passwd.  Both
+ * must find the same members.
+ *
+ * Usage: members-bench [USERS [ITERATIONS]]
+ */
+
+#include "bench.h"
+
+#include "acct_common.h"
+
+#define LOOP_USERS 200
+
+struct params {
+	int nusers;
+	int iterations;
+};
+
+// Is user uI in group gid, the way `usrx groups` finds out
+static int in_group(const struct acct_db *db, int i, gid_t gid)
+{
+	char user[32];
+	gid_t *list;
+	int n, found = 0;
+
+	snprintf(user, sizeof(user), "u%d", i);
+	if (acct_getgrouplist(db, user, BENCH_BASE_ID + i % 2, &list, &n) < 0)
+		return -1;
+	for (int j = 0; j < n && !found; j++)
+		found = list[j] == gid;
+	free(list);
+	return found;
+}
+
+static int run(void *arg)
+{
+	const struct params *p = arg;
+	uint64_t *samples = malloc(p->iterations * sizeof(uint64_t));
+	struct acct_db db;
+	struct acct_grent gr;
+	struct acct_member *m;
+	int n, loop = 0, users = p->nusers < LOOP_USERS ? p->nusers : LOOP_USERS;
+
+	if (!samples)
+		return 1;
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP);
+
+	uint64_t t = bench_now_ns();
+	for (int i = 0; i < users; i++)
+		loop += in_group(&db, i, BENCH_BASE_ID) > 0;
+	t = bench_now_ns() - t;
+
+	if (acct_getmembers(&db, "g0", &gr, &m, &n) < 0)
+		return 1;
+	// Members come in passwd order, so the looped users are a prefix
+	uid_t end = BENCH_BASE_ID + users;
+	int first = 0;
+	for (int i = 0; i < n && m[i].uid < end; i++)
+		first++;
+	free(m);
+	if (first != loop) {
+		fprintf(stderr, "results differ: loop=%d members=%d\n", loop,
+			first);
+		return 1;
+	}
+	printf("%d users, g0 has %d members\n", p->nusers, n);
+	printf("%-28s total=%10.1fms (%d users in %.1fms)\n",
+	       "getgrouplist per user", t / 1e6 * p->nusers / users, users,
+	       t / 1e6);
+
+	for (int i = 0; i < p->iterations; i++) {
+		t = bench_now_ns();
+		acct_getmembers(&db, "g0", &gr, &m, &n);
+		samples[i] = bench_now_ns() - t;
+		free(m);
+	}
+	bench_report("acct_getmembers", samples, p->iterations);
+
+	acct_close(&db);
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct params p = { 100000, 20 };
+
+	if (argc > 1)
+		p.nusers = atoi(argv[1]);
+	if (argc > 2)
+		p.iterations = atoi(argv[2]);
+	if (argc > 3 || p.nusers < 2 || p.iterations < 1) {
+		fprintf(stderr, "Usage: %s [USERS [ITERATIONS]]\n", argv[0]);
+		return 1;
+	}
+
+	char *dir = bench_mkdb(p.nusers, 2, 1, NULL);
+	if (!dir)
+		return 1;
+	int ret = bench_in_db(dir, run, &p);
+	bench_cleanup(dir);
+	return ret;
+}
@@ -0,0 +1,158 @@
+/**
+ * reaper_bench.c - CPU cost of `suex --init` reaping short-lived children
+ *
+ * Runs `suex --init u0 reaper-bench --worker RATE SECONDS`.  The worker
+ * creates children with CLONE_PARENT, so they are children of the reaper
+ * rather than its own, at RATE per second; each exits at once and must be
+ * reaped by suex.  Before exiting, the worker reads the reaper's CPU time
+ * from /proc and reports it against the number of children reaped.
+ *
+ * Usage: reaper-bench [-r RATE] [-s SECONDS] [TOOLDIR]
+ *
+ * TOOLDIR defaults to the directory holding reaper-bench.  suex can only
+ * switch users with real root, so the benchmark does nothing otherwise.
+ */
+
+#include "bench.h"
+
+#include <libgen.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+struct params {
+	char *self;
+	char *tooldir;
+	int rate;
+	int seconds;
+};
+
+// utime + stime of pid in clock ticks, from /proc/PID/stat
+static long cpu_ticks(pid_t pid)
+{
+	char path[64], buf[1024];
+	unsigned long utime, stime;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	// Fields after the command name, which may hold spaces
+	char *p = strrchr(buf, ')');
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+			 "%lu %lu", &utime, &stime) != 2)
+		return -1;
+	return utime + stime;
+}
+
+static int worker(int rate, int seconds)
+{
+	pid_t reaper = getppid();
+	long total = (long)rate * seconds, made = 0;
+	long hz = sysconf(_SC_CLK_TCK);
+	long before = cpu_ticks(reaper);
+	uint64_t start = bench_now_ns();
+
+	for (long i = 0; i < total; i++) {
+		// Pace to the target rate; fall behind rather than burst
+		uint64_t due = start + i * 1000000000ULL / rate;
+		uint64_t now = bench_now_ns();
+		if (now < due) {
+			struct timespec ts = {.tv_nsec = due - now };
+			nanosleep(&ts, NULL);
+		}
+		long pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, NULL, NULL,
+				   NULL, NULL);
+		if (pid == 0)
+			_exit(0);
+		made += pid > 0;
+	}
+	double secs = (bench_now_ns() - start) / 1e9;
+	// Let the last children be reaped before measuring
+	usleep(100000);
+	long ticks = cpu_ticks(reaper) - before;
+	double cpu = (double)ticks / hz;
+
+	printf("  %ld children in %.2fs (%.0f/s)\n", made, secs, made / secs);
+	printf("  reaper CPU %.0fms, %.1f%% of one CPU, %.2fus per child\n",
+	       cpu * 1000, cpu / secs * 100, made ? cpu * 1e6 / made : 0);
+	return 0;
+}
+
+static int run(void *arg)
+{
+	struct params *p = arg;
+	char suex[PATH_MAX], rate[16], seconds[16];
+	int status;
+
+	snprintf(suex, sizeof(suex), "%s/suex", p->tooldir);
+	snprintf(rate, sizeof(rate), "%d", p->rate);
+	snprintf(seconds, sizeof(seconds), "%d", p->seconds);
+	char *argv[] = {
+		suex, "--init", "u0", p->self, "--worker", rate, seconds, NULL
+	};
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0) {
+		execv(suex, argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return 1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct params p = {.rate = 10000,.seconds = 3 };
+	char self[PATH_MAX];
+	int opt;
+
+	if (argc == 4 && strcmp(argv[1], "--worker") == 0)
+		return worker(atoi(argv[2]), atoi(argv[3]));
+
+	while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+		switch (opt) {
+		case 'r':
+			p.rate = atoi(optarg);
+			break;
+		case 's':
+			p.seconds = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (p.rate < 1 || p.seconds < 1 || argc - optind > 1)
+		goto usage;
+	if (!realpath(argv[0], self)) {
+		perror(argv[0]);
+		return 1;
+	}
+	p.self = self;
+	p.tooldir = optind < argc ? argv[optind] : dirname(strdup(self));
+	if (getuid() != 0) {
+		printf("reaper-bench: suex needs real root, skipped\n");
+		return 0;
+	}
+
+	char *dir = bench_mkdb(1000, 100, 1, NULL);
+	if (!dir)
+		return 1;
+	printf("suex --init, %d children/s for %ds\n", p.rate, p.seconds);
+	int ret = bench_in_db(dir, run, &p);
+	bench_cleanup(dir);
+	return ret;
+
+ usage:
+	fprintf(stderr, "Usage: %s [-r RATE] [-s SECONDS] [TOOLDIR]\n", argv[0]);
+	return 1;
+}
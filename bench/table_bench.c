@@ -0,0 +1,191 @@
+/**
+ * table_bench.c - Generated lookup tables against the loops they replaced
+ *
+ * Times picking the session variables out of an inherited environment of
+ * 1000 unrelated variables plus the usual terminal ones, is_shell() over
+ * common command names and the uarch name mapping, each as a strcmp()
+ * loop over the table and as a table_find() lookup.  Session variables
+ * go through the first-two-bytes filter either way.  Both sides must
+ * agree on every answer.
+ *
+ * Usage: table-bench [ITERATIONS]
+ */
+
+#include "bench.h"
+
+#include "gen_arch_mappings.h"
+#include "gen_session_vars.h"
+#include "gen_shells.h"
+
+#define NUNRELATED 1000
+
+static char *environment[NUNRELATED + 8];
+
+static const char *commands[] = {
+	"sh", "bash", "ash", "tcsh", "python3", "env", "id", "ls",
+	"nginx", "busybox", "zshell", "ksh93",
+};
+
+static const char *archs[] = {
+	"x86_64", "aarch64", "arm64", "armv7l", "riscv64", "ppc64le",
+	"loongarch64", "sparc64", "mips", "i686", "m68k", "s390x",
+};
+
+static int linear_find(const char *const *names, const char *s, size_t len)
+{
+	for (int i = 0; names[i]; i++) {
+		if (strncmp(s, names[i], len) == 0 && names[i][len] == '\0')
+			return i;
+	}
+	return -1;
+}
+
+static int session_linear(void)
+{
+	int found = 0;
+
+	// The same first-two-bytes filter as before, then a scan of the names
+	for (char **e = environment; *e; e++) {
+		if (!table_maybe(&session_vars_table, *e))
+			continue;
+		for (int i = 0; session_vars[i]; i++) {
+			size_t len = strlen(session_vars[i]);
+			if (strncmp(*e, session_vars[i], len) == 0 &&
+			    (*e)[len] == '=') {
+				found++;
+				break;
+			}
+		}
+	}
+	return found;
+}
+
+static int session_table(void)
+{
+	int found = 0;
+
+	for (char **e = environment; *e; e++) {
+		if (!table_maybe(&session_vars_table, *e))
+			continue;
+		const char *eq = strchr(*e, '=');
+		if (eq && table_find(&session_vars_table, *e, eq - *e) >= 0)
+			found++;
+	}
+	return found;
+}
+
+static int list_linear(const char *const *names, const char **keys, int n)
+{
+	int found = 0;
+
+	for (int i = 0; i < n; i++)
+		found += linear_find(names, keys[i], strlen(keys[i])) >= 0;
+	return found;
+}
+
+static int list_table(const struct table *t, const char **keys, int n)
+{
+	int found = 0;
+
+	for (int i = 0; i < n; i++)
+		found += table_find(t, keys[i], strlen(keys[i])) >= 0;
+	return found;
+}
+
+static int shells_linear(void)
+{
+	return list_linear(shells, commands, sizeof(commands) /
+			   sizeof(commands[0]));
+}
+
+static int shells_lookup(void)
+{
+	return list_table(&shells_table, commands, sizeof(commands) /
+			  sizeof(commands[0]));
+}
+
+static int archs_linear(void)
+{
+	return list_linear(arch_mappings, archs, sizeof(archs) /
+			   sizeof(archs[0]));
+}
+
+static int archs_lookup(void)
+{
+	return list_table(&arch_mappings_table, archs, sizeof(archs) /
+			  sizeof(archs[0]));
+}
+
+// Time fn over iterations samples of reps calls; returns its answer
+static int run(const char *name, int (*fn)(void), int reps, int iterations,
+	       uint64_t *samples)
+{
+	int answer = fn();
+
+	for (int i = 0; i < iterations; i++) {
+		uint64_t t = bench_now_ns();
+		for (int r = 0; r < reps; r++) {
+			if (fn() != answer)
+				abort();
+		}
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_report(name, samples, iterations);
+	return answer;
+}
+
+static int compare(const char *what, int (*linear)(void), int (*lookup)(void),
+		   int reps, int iterations, uint64_t *samples)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "%s (loop)", what);
+	int a = run(name, linear, reps, iterations, samples);
+	snprintf(name, sizeof(name), "%s (table)", what);
+	int b = run(name, lookup, reps, iterations, samples);
+	if (a != b) {
+		fprintf(stderr, "%s: loop found %d, table %d\n", what, a, b);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *session[] = {
+		"TERM=xterm-256color", "LANG=C.UTF-8", "SSH_TTY=/dev/pts/3",
+		"SSH_CONNECTION=10.0.0.1 50000 10.0.0.2 22", "TMUX=/tmp/t,1,0",
+		"DISPLAY=:0",
+	};
+	int iterations = 200, n = 0;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2 || iterations < 1) {
+		fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+		return 1;
+	}
+	uint64_t *samples = malloc(iterations * sizeof(uint64_t));
+	if (!samples)
+		return 1;
+
+	// Session variables spread through the unrelated ones
+	for (int i = 0; i < NUNRELATED; i++) {
+		if (i % (NUNRELATED / 6) == 0 && i / (NUNRELATED / 6) < 6)
+			environment[n++] = (char *)session[i / (NUNRELATED / 6)];
+		if (asprintf(&environment[n++], "APP_SETTING_%d=value%d", i,
+			     i) < 0)
+			return 1;
+	}
+	environment[n] = NULL;
+
+	int ret = compare("session, 1006 vars", session_linear,
+			  session_table, 1, iterations, samples) ||
+	    compare("is_shell, 996", shells_linear, shells_lookup, 1000 /
+		    (sizeof(commands) / sizeof(commands[0])), iterations,
+		    samples) ||
+	    compare("arch, 996", archs_linear, archs_lookup, 1000 /
+		    (sizeof(archs) / sizeof(archs[0])), iterations, samples);
+	free(samples);
+	return ret;
+}
@@ -0,0 +1,126 @@
+/**
+ * tiny_bench.c - Startup cost of `make tiny` suex against the regular build
+ *
+ * For build/suex and build/suex-tiny, reports the file size and, over
+ * repeated runs, p50/p99 wall time of fork+exec+wait and the minor page
+ * faults of the run (from wait4()).  `suex --help` measures startup alone;
+ * `suex u0 /bin/true` adds reading the 1k-user database and switching
+ * users, and includes the faults of /bin/true itself.
+ *
+ * Usage: tiny-bench [-n RUNS] [TOOLDIR]
+ *
+ * TOOLDIR defaults to the directory holding tiny-bench.  The switching
+ * run needs real root and is skipped otherwise.
+ */
+
+#include "bench.h"
+
+#include <libgen.h>
+#include <limits.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+struct params {
+	const char *tooldir;
+	int runs;
+};
+
+// One run; returns its minor faults, or -1
+static long spawn(char *const argv[])
+{
+	struct rusage ru;
+	int status;
+	pid_t pid = fork();
+
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		int fd = open("/dev/null", O_RDWR);
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (wait4(pid, &status, 0, &ru) < 0)
+		return -1;
+	return ru.ru_minflt;
+}
+
+static void measure(const struct params *p, const char *name,
+		    char *const argv[], uint64_t *samples)
+{
+	struct bench_stats st;
+	long faults = 0;
+
+	spawn(argv);
+	for (int i = 0; i < p->runs; i++) {
+		uint64_t t = bench_now_ns();
+		faults += spawn(argv);
+		samples[i] = bench_now_ns() - t;
+	}
+	bench_stats(samples, p->runs, &st);
+	printf("  %-26s p50=%8.1fus p99=%8.1fus  minflt=%.1f\n", name,
+	       st.p50_us, st.p99_us, (double)faults / p->runs);
+}
+
+static int run(void *arg)
+{
+	const struct params *p = arg;
+	static const char *builds[] = { "suex", "suex-tiny" };
+	uint64_t *samples = malloc(p->runs * sizeof(uint64_t));
+
+	if (!samples)
+		return 1;
+	for (size_t i = 0; i < sizeof(builds) / sizeof(builds[0]); i++) {
+		char path[PATH_MAX], name[64];
+		struct stat st;
+
+		snprintf(path, sizeof(path), "%s/%s", p->tooldir, builds[i]);
+		if (stat(path, &st) < 0) {
+			printf("%s: not built, skipped\n", builds[i]);
+			continue;
+		}
+		printf("%s: %ld bytes\n", builds[i], (long)st.st_size);
+
+		char *help[] = { path, "--help", NULL };
+		snprintf(name, sizeof(name), "%s --help", builds[i]);
+		measure(p, name, help, samples);
+		if (getuid() != 0)
+			continue;
+		char *sw[] = { path, "u0", "/bin/true", NULL };
+		snprintf(name, sizeof(name), "%s u0 true", builds[i]);
+		measure(p, name, sw, samples);
+	}
+	free(samples);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct params p = {.runs = 1000 };
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			p.runs = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (p.runs < 1 || argc - optind > 1)
+		goto usage;
+	p.tooldir = optind < argc ? argv[optind] : dirname(strdup(argv[0]));
+
+	char *dir = bench_mkdb(1000, 100, 1, NULL);
+	if (!dir)
+		return 1;
+	int ret = bench_in_db(dir, run, &p);
+	bench_cleanup(dir);
+	return ret;
+
+ usage:
+	fprintf(stderr, "Usage: %s [-n RUNS] [TOOLDIR]\n", argv[0]);
+	return 1;
+}
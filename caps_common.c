@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "caps_common.h"
+
+// From linux/capability.h, which needs kernel headers to build
+#define CAP_VERSION_3 0x20080522
+
+struct cap_header {
+	uint32_t version;
+	int pid;
+};
+
+struct cap_data {
+	uint32_t effective;
+	uint32_t permitted;
+	uint32_t inheritable;
+};
+
+#ifndef PR_CAP_AMBIENT
+#define PR_CAP_AMBIENT 47
+#define PR_CAP_AMBIENT_RAISE 2
+#define PR_CAP_AMBIENT_CLEAR_ALL 4
+#endif
+
+// Indexed by capability number
+static const char *const names[] = {
+	"chown", "dac_override", "dac_read_search", "fowner", "fsetid",
+	"kill", "setgid", "setuid", "setpcap", "linux_immutable",
+	"net_bind_service", "net_broadcast", "net_admin", "net_raw",
+	"ipc_lock", "ipc_owner", "sys_module", "sys_rawio", "sys_chroot",
+	"sys_ptrace", "sys_pacct", "sys_admin", "sys_boot", "sys_nice",
+	"sys_resource", "sys_time", "sys_tty_config", "mknod", "lease",
+	"audit_write", "audit_control", "setfcap", "mac_override",
+	"mac_admin", "syslog", "wake_alarm", "block_suspend", "audit_read",
+	"perfmon", "bpf", "checkpoint_restore",
+};
+
+#define NCAPS (int)(sizeof(names) / sizeof(names[0]))
+
+// Compare s[0..len) with the lower-case name, ignoring case
+static int name_eq(const char *s, size_t len, const char *name)
+{
+	if (strlen(name) != len) {
+		return 0;
+	}
+	for (size_t i = 0; i < len; i++) {
+		char c = s[i];
+		if (c >= 'A' && c <= 'Z') {
+			c += 'a' - 'A';
+		}
+		if (c != name[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int caps_parse(const char *list, uint64_t *caps)
+{
+	*caps = 0;
+	for (const char *p = list;; p++) {
+		size_t len = strcspn(p, ",");
+		int cap = -1;
+
+		if (len > 4 && name_eq(p, 4, "cap_")) {
+			p += 4;
+			len -= 4;
+		}
+		for (int i = 0; i < NCAPS && cap < 0; i++) {
+			if (name_eq(p, len, names[i])) {
+				cap = i;
+			}
+		}
+		if (cap < 0) {
+			return -1;
+		}
+		*caps |= 1ULL << cap;
+		p += len;
+		if (*p == '\0') {
+			return 0;
+		}
+	}
+}
+
+int caps_keep(void)
+{
+	return prctl(PR_SET_KEEPCAPS, 1, 0, 0, 0);
+}
+
+int caps_apply(uint64_t caps, const char **what)
+{
+	struct cap_header h = {.version = CAP_VERSION_3 };
+	struct cap_data d[2];
+
+	// setuid() cleared the effective set; the permitted set was kept
+	for (int i = 0; i < 2; i++) {
+		d[i].effective = d[i].permitted = d[i].inheritable =
+		    caps >> (32 * i);
+	}
+	*what = "capabilities";
+	if (syscall(SYS_capset, &h, d) < 0) {
+		return -1;
+	}
+	// Ambient caps survive exec of a file without file capabilities
+	*what = "ambient capabilities";
+	if (prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_CLEAR_ALL, 0, 0, 0) < 0) {
+		return -1;
+	}
+	for (int i = 0; i < NCAPS; i++) {
+		if ((caps & (1ULL << i)) &&
+		    prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_RAISE, i, 0, 0) < 0) {
+			*what = names[i];
+			return -1;
+		}
+	}
+	return prctl(PR_SET_KEEPCAPS, 0, 0, 0, 0);
+}
@@ -0,0 +1,26 @@
+#ifndef CAPS_COMMON_H
+#define CAPS_COMMON_H
+
+#include <stdint.h>
+
+/*
+ * Capabilities kept across the switch to a non-root target, as a mask of
+ * 1 << CAP_*.  suex keeps its capabilities through setuid() with
+ * PR_SET_KEEPCAPS, then leaves exactly these in the permitted, effective,
+ * inheritable and ambient sets, so the command still holds them after
+ * exec without file capabilities.
+ */
+
+// Parse a list like "net_bind_service,CAP_IPC_LOCK"; -1 if invalid
+int caps_parse(const char *list, uint64_t *caps);
+
+// Before setuid(): keep the permitted set through the uid switch
+int caps_keep(void);
+
+/*
+ * After setuid(): reduce every set to caps and raise them into the ambient
+ * set; on failure returns -1 with errno set and *what naming the step.
+ */
+int caps_apply(uint64_t caps, const char **what);
+
+#endif /* CAPS_COMMON_H */
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include "cgroup_common.h"
+
+// From linux/magic.h
+#define CGROUP2_SUPER_MAGIC 0x63677270
+
+// Default cpu.max period, as the kernel uses
+#define CGROUP_CPU_PERIOD 100000
+
+void cgroup_init(struct cgroup_opts *c)
+{
+	memset(c, 0, sizeof(*c));
+	c->cpu_period = CGROUP_CPU_PERIOD;
+}
+
+// Parse a decimal number at *s, advancing *s past it
+static int parse_u64(const char **s, unsigned long long *v)
+{
+	const char *p = *s;
+
+	*v = 0;
+	if (*p < '0' || *p > '9') {
+		return -1;
+	}
+	for (; *p >= '0' && *p <= '9'; p++) {
+		if (*v > (-1ULL - 9) / 10) {
+			return -1;
+		}
+		*v = *v * 10 + (*p - '0');
+	}
+	*s = p;
+	return 0;
+}
+
+int cgroup_parse_cpu_max(struct cgroup_opts *c, const char *arg)
+{
+	const char *p = arg;
+
+	if (strncmp(p, "max", 3) == 0) {
+		c->cpu_quota = CGROUP_MAX;
+		p += 3;
+	} else if (parse_u64(&p, &c->cpu_quota) < 0 || c->cpu_quota == 0) {
+		return -1;
+	}
+	if (*p == '/') {
+		p++;
+		if (parse_u64(&p, &c->cpu_period) < 0 || c->cpu_period == 0) {
+			return -1;
+		}
+	}
+	if (*p != '\0') {
+		return -1;
+	}
+	c->has_cpu_max = 1;
+	return 0;
+}
+
+int cgroup_parse_memory_max(struct cgroup_opts *c, const char *arg)
+{
+	const char *p = arg;
+	int shift = 0;
+
+	if (strcmp(arg, "max") == 0) {
+		c->memory_max = CGROUP_MAX;
+		c->has_memory_max = 1;
+		return 0;
+	}
+	if (parse_u64(&p, &c->memory_max) < 0) {
+		return -1;
+	}
+	switch (*p) {
+	case 'K':
+	case 'k':
+		shift = 10;
+		break;
+	case 'M':
+	case 'm':
+		shift = 20;
+		break;
+	case 'G':
+	case 'g':
+		shift = 30;
+		break;
+	case '\0':
+		break;
+	default:
+		return -1;
+	}
+	if (shift && (*++p != '\0' || c->memory_max > (-1ULL >> shift) - 1)) {
+		return -1;
+	}
+	c->memory_max <<= shift;
+	c->has_memory_max = 1;
+	return 0;
+}
+
+// Append v in decimal, or "max", at p; returns the new end
+static char *put_value(char *p, unsigned long long v)
+{
+	char digits[24];
+	int n = 0;
+
+	if (v == CGROUP_MAX) {
+		memcpy(p, "max", 3);
+		return p + 3;
+	}
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n) {
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+// Write the whole of buf[0..len) to file in dir with one write()
+static int write_file(int dir, const char *file, const char *buf, size_t len)
+{
+	int fd = openat(dir, file, O_WRONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return -1;
+	}
+	ssize_t n = write(fd, buf, len);
+	int saved = errno;
+	close(fd);
+	if (n != (ssize_t)len) {
+		errno = n < 0 ? saved : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+// 0 if the directory holding path is on cgroup2, -1 with errno otherwise
+static int parent_is_cgroup2(const char *path)
+{
+	char parent[PATH_MAX];
+	const char *slash = strrchr(path, '/');
+	size_t len = slash ? (size_t)(slash - path) : 0;
+	struct statfs fs;
+
+	if (len >= sizeof(parent)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if (!slash) {
+		parent[len++] = '.';
+	} else if (len == 0) {
+		parent[len++] = '/';
+	} else {
+		memcpy(parent, path, len);
+	}
+	parent[len] = '\0';
+	if (statfs(parent, &fs) < 0) {
+		return -1;
+	}
+	if (fs.f_type != CGROUP2_SUPER_MAGIC) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	return 0;
+}
+
+int cgroup_apply(const struct cgroup_opts *c, const char **what)
+{
+	char buf[64], *p;
+	struct statfs fs;
+	int dir, ret = -1;
+
+	if (!c->path) {
+		return 0;
+	}
+	*what = "open";
+	dir = open(c->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir < 0 && errno == ENOENT) {
+		// Create the leaf, but never a plain directory outside cgroupfs
+		*what = "create";
+		if (parent_is_cgroup2(c->path) < 0 ||
+		    (mkdir(c->path, 0755) < 0 && errno != EEXIST)) {
+			return -1;
+		}
+		*what = "open";
+		dir = open(c->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	if (dir < 0) {
+		return -1;
+	}
+	// Only cgroup2 directories have cpu.max, memory.max and cgroup.procs
+	if (fstatfs(dir, &fs) < 0) {
+		goto out;
+	}
+	if (fs.f_type != CGROUP2_SUPER_MAGIC) {
+		errno = ENOTSUP;
+		goto out;
+	}
+	if (c->has_cpu_max) {
+		*what = "set cpu.max in";
+		p = put_value(buf, c->cpu_quota);
+		*p++ = ' ';
+		p = put_value(p, c->cpu_period);
+		if (write_file(dir, "cpu.max", buf, p - buf) < 0) {
+			goto out;
+		}
+	}
+	if (c->has_memory_max) {
+		*what = "set memory.max in";
+		p = put_value(buf, c->memory_max);
+		if (write_file(dir, "memory.max", buf, p - buf) < 0) {
+			goto out;
+		}
+	}
+	// The command is exec'd from this process, so it starts inside
+	*what = "join";
+	p = put_value(buf, getpid());
+	ret = write_file(dir, "cgroup.procs", buf, p - buf);
+ out:
+	close(dir);
+	return ret;
+}
@@ -0,0 +1,37 @@
+#ifndef CGROUP_COMMON_H
+#define CGROUP_COMMON_H
+
+/*
+ * Moving suex into a cgroup v2 directory before it drops root, so the
+ * command starts inside it with no window where it runs unconfined.  A
+ * missing leaf is created under its (delegated) parent, and cpu.max and
+ * memory.max are written before the process joins.
+ */
+
+#define CGROUP_MAX -1ULL	// "max": no limit
+
+struct cgroup_opts {
+	const char *path;	// NULL if not given
+	int has_cpu_max;
+	unsigned long long cpu_quota;	// microseconds per period, or max
+	unsigned long long cpu_period;
+	int has_memory_max;
+	unsigned long long memory_max;	// bytes, or max
+};
+
+void cgroup_init(struct cgroup_opts *c);
+
+// Parse "max", "QUOTA" or "QUOTA/PERIOD" in microseconds; -1 if invalid
+int cgroup_parse_cpu_max(struct cgroup_opts *c, const char *arg);
+
+// Parse "max" or bytes with an optional K, M or G suffix; -1 if invalid
+int cgroup_parse_memory_max(struct cgroup_opts *c, const char *arg);
+
+/*
+ * Create the leaf if needed, write the limits and move the calling
+ * process in.  On failure returns -1 with errno set and *what naming
+ * the step.  Does nothing without a path.
+ */
+int cgroup_apply(const struct cgroup_opts *c, const char **what);
+
+#endif /* CGROUP_COMMON_H */
@@ -0,0 +1,44 @@
+#ifndef DAEMON_COMMON_H
+#define DAEMON_COMMON_H
+
+#include <stdint.h>
+
+/*
+ * Wire protocol between `suex --via-daemon` and suexd over a local stream
+ * socket.  Both ends run on the same host, so integers are host order.
+ *
+ * The client sends a struct suexd_request carrying its stdin, stdout,
+ * stderr and working directory as SCM_RIGHTS, followed by len bytes of
+ * NUL-terminated strings: USER[:GROUP], argc arguments and envc
+ * environment entries.  While the job runs, each int32_t the client sends
+ * is a signal to deliver to it.  The daemon answers with one struct
+ * suexd_reply and closes the connection.
+ */
+
+#ifndef SUEXD_SOCKET
+#define SUEXD_SOCKET "/run/suexd.sock"
+#endif
+
+#define SUEXD_MAGIC 0x53584431	// "SXD1"
+#define SUEXD_NFDS 4
+// Largest string block accepted, a little over the usual ARG_MAX
+#define SUEXD_MAX_REQUEST (4 << 20)
+
+// Request flags
+#define SUEXD_LOGIN 0x1
+
+struct suexd_request {
+	uint32_t magic;
+	uint32_t flags;
+	uint32_t umask;
+	uint32_t argc;
+	uint32_t envc;
+	uint32_t len;
+};
+
+struct suexd_reply {
+	int32_t error;		// errno refusing the request, else 0
+	int32_t status;		// wait status of the job
+};
+
+#endif /* DAEMON_COMMON_H */
@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "env_common.h"
+#include "msg_common.h"
+
+void env_init(struct env_builder *b, char **base)
+{
+	b->base = base;
+	b->n = 0;
+	b->keep = NULL;
+	b->nkeep = 0;
+	b->failed = 0;
+}
+
+void env_set(struct env_builder *b, const char *name, const char *value)
+{
+	for (int i = 0; i < b->n; i++) {
+		if (strcmp(b->name[i], name) == 0) {
+			b->value[i] = value;
+			return;
+		}
+	}
+	// ENV_MAX_SET holds the login variables and every session variable
+	if (b->n < ENV_MAX_SET) {
+		b->name[b->n] = name;
+		b->value[b->n] = value;
+		b->n++;
+	}
+}
+
+/*
+ * Pass on entry, whose name is nlen long, as it is.  The list is allocated
+ * once, on the first entry, with room for every entry from there on.
+ */
+static void env_keep(struct env_builder *b, const char *entry, size_t nlen,
+		     char **rest)
+{
+	if (!b->keep) {
+		size_t n = 0;
+		while (rest[n])
+			n++;
+		b->keep = malloc(n * sizeof(*b->keep));
+		if (!b->keep) {
+			b->failed = 1;
+			return;
+		}
+	}
+	for (int i = 0; i < b->nkeep; i++) {
+		if (strncmp(b->keep[i], entry, nlen + 1) == 0)
+			return;
+	}
+	b->keep[b->nkeep++] = entry;
+}
+
+/*
+ * One pass over from rather than a getenv() per session variable, since
+ * inherited environments can run to thousands of entries.  The names come
+ * from SESSION_TABLE (tables/session_vars.txt by default): entries whose
+ * first two characters start no name or prefix there are skipped after
+ * one bit test, and the rest take one hash lookup.  The first entry for a
+ * name wins, as with getenv().
+ */
+void env_session(struct env_builder *b, char **from)
+{
+	const char *val[SESSION_VARS_COUNT + 1] = { 0 };
+
+	for (char **e = from; e && *e; e++) {
+		if (!table_maybe(&session_vars_table, *e))
+			continue;
+		const char *eq = strchr(*e, '=');
+		if (!eq)
+			continue;
+		size_t nlen = eq - *e;
+		int i = table_find(&session_vars_table, *e, nlen);
+		if (i >= 0) {
+			if (!val[i])
+				val[i] = eq + 1;
+		} else if (table_prefixed(&session_vars_table, *e, nlen)) {
+			env_keep(b, *e, nlen, e);
+		}
+	}
+	for (int i = 0; session_vars[i]; i++) {
+		if (val[i])
+			env_set(b, session_vars[i], val[i]);
+	}
+}
+
+void build_path(char *buf, size_t buflen, const char *home, int is_root)
+{
+	size_t len = strlen(home);
+
+	// Strip trailing slashes, so there is no //.local/bin
+	while (len > 1 && home[len - 1] == '/')
+		len--;
+	int add_local = !(len == 1 && home[0] == '/');
+	const char *sys = is_root ?
+	    "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin" :
+	    "/usr/local/bin:/usr/bin:/bin";
+
+	if (!add_local) {
+		msg_format(buf, buflen, "%s", sys);
+		return;
+	}
+	if (len >= buflen)
+		len = buflen - 1;
+	memcpy(buf, home, len);
+	msg_format(buf + len, buflen - len, "/.local/bin:%s", sys);
+}
+
+void env_login(struct env_builder *b, const struct passwd *pw,
+	       const char *shell, int is_root, char **from)
+{
+	env_set(b, "HOME", pw->pw_dir);
+	env_set(b, "USER", pw->pw_name);
+	env_set(b, "LOGNAME", pw->pw_name);
+	env_set(b, "SHELL", shell);
+	msg_format(b->mail, sizeof(b->mail), "/var/mail/%s", pw->pw_name);
+	env_set(b, "MAIL", b->mail);
+	build_path(b->path, sizeof(b->path), pw->pw_dir, is_root);
+	env_set(b, "PATH", b->path);
+	env_session(b, from);
+}
+
+// Index of the set variable entry assigns, or -1
+static int find_set(const struct env_builder *b, const size_t *nlen,
+		    const char *entry)
+{
+	for (int i = 0; i < b->n; i++) {
+		if (entry[0] == b->name[i][0] &&
+		    strncmp(entry, b->name[i], nlen[i]) == 0 &&
+		    entry[nlen[i]] == '=')
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Inherited entries are passed on as they are, without copying; only the
+ * set variables are written into the block after envp.  As with setenv(),
+ * a set variable replaces the first inherited entry of that name where it
+ * stands, and the others are appended in the order they were set, then
+ * the kept entries.  The search stops once every set variable has been
+ * found.
+ */
+char **env_build(const struct env_builder *b)
+{
+	size_t nlen[ENV_MAX_SET], at[ENV_MAX_SET];
+	size_t nbase = 0, bytes = 0;
+	int found = 0;
+
+	if (b->failed)
+		return NULL;
+
+	for (int i = 0; i < b->n; i++) {
+		nlen[i] = strlen(b->name[i]);
+		bytes += nlen[i] + strlen(b->value[i]) + 2;
+		at[i] = SIZE_MAX;
+	}
+	for (; b->base && b->base[nbase] && found < b->n; nbase++) {
+		int i = find_set(b, nlen, b->base[nbase]);
+		if (i >= 0 && at[i] == SIZE_MAX) {
+			at[i] = nbase;
+			found++;
+		}
+	}
+	// Everything set is already there: patch base in place, as setenv()
+	// would, and allocate the strings alone
+	if (b->base && found == b->n && b->nkeep == 0) {
+		char *p = malloc(bytes ? bytes : 1);
+		if (!p)
+			return NULL;
+		for (int i = 0; i < b->n; i++) {
+			b->base[at[i]] = p;
+			p = stpcpy(stpcpy(stpcpy(p, b->name[i]), "="),
+				   b->value[i]) + 1;
+		}
+		return b->base;
+	}
+
+	while (b->base && b->base[nbase])
+		nbase++;
+	size_t count = nbase + b->n - found + b->nkeep;
+	char **envp = malloc((count + 1) * sizeof(char *) + bytes);
+	if (!envp) {
+		free(b->keep);
+		return NULL;
+	}
+	char *p = (char *)(envp + count + 1);
+	size_t n = nbase;
+	if (nbase > 0)
+		memcpy(envp, b->base, nbase * sizeof(char *));
+	for (int i = 0; i < b->n; i++) {
+		envp[at[i] != SIZE_MAX ? at[i] : n++] = p;
+		p = stpcpy(stpcpy(stpcpy(p, b->name[i]), "="), b->value[i]) + 1;
+	}
+	// A prefix rule may cover a variable that was set, which then wins
+	for (int i = 0; i < b->nkeep; i++) {
+		if (find_set(b, nlen, b->keep[i]) < 0)
+			envp[n++] = (char *)b->keep[i];
+	}
+	envp[n] = NULL;
+	free(b->keep);
+	return envp;
+}
@@ -1,18 +1,62 @@
 #ifndef ENV_COMMON_H
 #define ENV_COMMON_H
 
+#include <pwd.h>
+#include <stddef.h>
+
+#include "gen_session_vars.h"
+
 /*
- * Terminal and session variables to inherit from the calling environment
- * when building a clean login environment.
+ * Target environments for exec, shared by suex and sush.  Variables are
+ * recorded with env_set() and laid out by env_build() in one allocation:
+ * the envp array followed by the NAME=value strings that were set, with
+ * inherited entries pointed to where they are.  Nothing is copied before
+ * then, so values must stay valid until env_build() returns.
  */
-static const char *session_vars[] = {
-	"TERM", "COLORTERM", "TERM_PROGRAM", "TERM_PROGRAM_VERSION",
-	"LANG", "LC_ALL", "LC_CTYPE", "LC_MESSAGES", "LC_TIME",
-	"LC_NUMERIC", "LC_MONETARY", "LC_COLLATE",
-	"DISPLAY", "WAYLAND_DISPLAY", "XAUTHORITY",
-	"TMUX", "TMUX_PANE", "STY",
-	"SSH_TTY", "SSH_CLIENT", "SSH_CONNECTION", "SSH_AUTH_SOCK",
-	NULL
+
+// Variables env_login() sets before the session variables
+#define ENV_LOGIN_VARS 6
+// Most variables one builder sets, sized from SESSION_TABLE at build time
+#define ENV_MAX_SET (ENV_LOGIN_VARS + SESSION_VARS_COUNT)
+// Longest PATH or MAIL value env_login() builds
+#define ENV_MAX_VALUE 4096
+
+struct env_builder {
+	char **base;		// entries to inherit, NULL for none
+	int n;
+	const char *name[ENV_MAX_SET];
+	const char *value[ENV_MAX_SET];
+	const char **keep;	// whole entries, passed on as they are
+	int nkeep;
+	int failed;		// the keep list could not be allocated
+	char path[ENV_MAX_VALUE];	// storage for env_login()'s values
+	char mail[ENV_MAX_VALUE];
 };
 
+// Start from the entries of base, or from nothing when base is NULL
+void env_init(struct env_builder *b, char **base);
+
+// Set name to value, replacing an inherited entry in place
+void env_set(struct env_builder *b, const char *name, const char *value);
+
+// Pass on the terminal and session variables set in from, by name or prefix
+void env_session(struct env_builder *b, char **from);
+
+/*
+ * Set HOME, USER, LOGNAME, SHELL, MAIL and PATH of a clean login
+ * environment for pw, then the session variables from from.
+ */
+void env_login(struct env_builder *b, const struct passwd *pw,
+	       const char *shell, int is_root, char **from);
+
+// A default PATH for home; ~/.local/bin is left out when home is "/"
+void build_path(char *buf, size_t buflen, const char *home, int is_root);
+
+/*
+ * envp for execve(), with one allocation; NULL when out of memory.  When
+ * every variable set was inherited, base itself is updated and returned.
+ * The builder's own memory is released, so it cannot be built twice.
+ */
+char **env_build(const struct env_builder *b);
+
 #endif /* ENV_COMMON_H */
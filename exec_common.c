@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <errno.h>
+#include <grp.h>
+#include <libgen.h>
+#include <pwd.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "caps_common.h"
+#include "env_common.h"
+#include "exec_common.h"
+#include "gen_shells.h"
+#include "msg_common.h"
+#include "trace_common.h"
+
+char *program_name;
+
+/**
+ * Print error message and exit
+ */
+void die(int code, const char *fmt, ...)
+{
+	char msg[MAX_PATH];
+	va_list ap;
+
+	va_start(ap, fmt);
+	msg_vformat(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+
+	if (errno) {
+		msg_print(STDERR_FILENO, "%s: %s: %s\n", basename(program_name),
+			  msg, strerror(errno));
+	} else {
+		msg_print(STDERR_FILENO, "%s: %s\n", basename(program_name),
+			  msg);
+	}
+	exit(code);
+}
+
+/**
+ * Parse a string in format [USER[:GROUP]] into user and group components
+ */
+int parse_user_group(const char *arg, char **user, char **group)
+{
+	// Sanity check
+	if (!arg || !user || !group) {
+		return -1;
+	}
+	// Initialize outputs
+	*user = NULL;
+	*group = NULL;
+
+	// Make a copy of the string since we'll modify it
+	char *str = strdup(arg);
+	if (!str) {
+		return -1;
+	}
+	// Skip @ or + prefix if present
+	char *start = str;
+	if (*start == '@' || *start == '+') {
+		start++;
+	}
+	// Check if we have a valid string after the prefix
+	if (*start == '\0') {
+		free(str);
+		return -1;
+	}
+	// Split on colon for group
+	char *colon = strchr(start, ':');
+	if (colon) {
+		*colon = '\0';	// Split the string
+
+		// Extract group if there's anything after the colon
+		if (*(colon + 1) != '\0') {
+			*group = strdup(colon + 1);
+			if (!*group) {
+				free(str);
+				return -1;
+			}
+		}
+	}
+	// Extract user
+	*user = strdup(start);
+	if (!*user) {
+		free(*group);
+		*group = NULL;
+		free(str);
+		return -1;
+	}
+	// Clean up the temporary string
+	free(str);
+	return 0;
+}
+
+/**
+ * Return 1 if the basename of cmd matches a known interactive shell
+ */
+static int is_shell(const char *cmd)
+{
+	const char *base = strrchr(cmd, '/');
+	base = base ? base + 1 : cmd;
+	return table_find(&shells_table, base, strlen(base)) >= 0;
+}
+
+/**
+ * Set up supplementary groups for the target user
+ */
+static int setup_groups(const struct acct_db *db, const struct auth_query *q,
+			gid_t target_gid)
+{
+	if (!q->target) {
+		// Just set the single group
+		if (setgroups(1, &target_gid) < 0) {
+			return -1;
+		}
+		return 0;
+	}
+
+	int ngroups = 0;
+	gid_t *glist = NULL;
+
+	// Memberships were collected while resolving the target
+	if (auth_grouplist(db, q, target_gid, &glist, &ngroups) < 0) {
+		return -1;
+	}
+	// Set the groups
+	if (setgroups(ngroups, glist) < 0) {
+		free(glist);
+		return -1;
+	}
+
+	free(glist);
+	return 0;
+}
+
+/**
+ * Describe a parsed USER[:GROUP] as an auth query
+ */
+void describe_target(struct target *t, uid_t caller_uid)
+{
+	memset(&t->q, 0, sizeof(t->q));
+	t->q.caller_uid = caller_uid;
+	if (t->user && t->user[0] != '\0') {
+		// Check if user is numeric UID
+		char *endptr;
+		long uid_val = strtol(t->user, &endptr, 10);
+		if (*endptr == '\0') {
+			t->q.by_uid = 1;
+			t->q.uid = uid_val;
+		} else {
+			t->q.user = t->user;
+		}
+	} else {
+		// No user specified, default to root
+		t->q.by_uid = 1;
+		t->q.uid = 0;
+	}
+	if (t->group && t->group[0] != '\0') {
+		char *endptr;
+		strtol(t->group, &endptr, 10);
+		if (*endptr != '\0') {
+			t->q.group = t->group;
+		}
+	}
+}
+
+/**
+ * Work out the uid and gid to switch to from a resolved query;
+ * where prefixes error messages
+ */
+void resolve_ids(struct target *t, const char *where)
+{
+	struct passwd *pw = t->q.target;
+
+	t->gid = getgid();
+	// Handle target user
+	if (t->user && t->user[0] != '\0') {
+		if (t->q.by_uid) {
+			// Numeric user ID provided
+			t->uid = t->q.uid;
+		} else {
+			// Username provided
+			if (pw == NULL) {
+				die(1, "%sFailed to find user '%s'", where,
+				    t->user);
+			}
+			t->uid = pw->pw_uid;
+			t->gid = pw->pw_gid;
+		}
+	} else {
+		// No user specified, default to root
+		t->uid = 0;
+		if (pw) {
+			t->gid = pw->pw_gid;
+		}
+	}
+
+	// Handle target group if specified
+	if (t->group && t->group[0] != '\0') {
+		if (t->q.group == NULL) {
+			// Numeric group ID provided
+			t->gid = strtol(t->group, NULL, 10);
+		} else {
+			// Group name provided
+			if (!t->q.group_found) {
+				die(1, "%sFailed to find group '%s'", where,
+				    t->group);
+			}
+			t->gid = t->q.group_gid;
+		}
+	}
+}
+
+/**
+ * Switch to the target and execute the command; never returns.
+ * cmd_path is the command already resolved in PATH, or NULL.
+ */
+void become(struct acct_db *db, const struct target *t,
+		   int login_mode, char **cmd_argv, const char *cmd_path)
+{
+	struct passwd *pw = t->q.target;
+	uid_t target_uid = t->uid;
+	gid_t target_gid = t->gid;
+	int keep_caps = t->caps && target_uid != 0;
+	const char *what;
+
+	// Set supplementary groups
+	if (pw) {
+		if (setup_groups(db, &t->q, target_gid) < 0) {
+			die(1,
+			    "Failed to set supplemental groups for user '%s'",
+			    pw->pw_name);
+		}
+	} else {
+		if (setup_groups(db, &t->q, target_gid) < 0) {
+			die(1, "Failed to set supplemental groups for GID %d",
+			    target_gid);
+		}
+	}
+	trace_mark("groups");
+
+	// Clean up
+	acct_close(db);
+
+	// Set the new GID and UID
+	if (keep_caps && caps_keep() < 0) {
+		die(1, "Failed to keep capabilities");
+	}
+	if (setgid(target_gid) < 0) {
+		die(1, "Failed to set GID to %d", target_gid);
+	}
+
+	if (setuid(target_uid) < 0) {
+		die(1, "Failed to set UID to %d", target_uid);
+	}
+	if (keep_caps && caps_apply(t->caps, &what) < 0) {
+		die(1, "Failed to keep %s", what);
+	}
+	trace_mark("setid");
+
+	// Login mode starts from a clean login environment, keeping only
+	// session/terminal variables; otherwise USER and HOME are replaced
+	struct env_builder env;
+	if (login_mode) {
+		env_init(&env, NULL);
+		if (pw) {
+			env_login(&env, pw, is_shell(cmd_argv[0]) ?
+				  cmd_argv[0] : pw->pw_shell, target_uid == 0,
+				  environ);
+		} else {
+			build_path(env.path, sizeof(env.path), "/",
+				   target_uid == 0);
+			env_set(&env, "PATH", env.path);
+			env_session(&env, environ);
+		}
+	} else {
+		env_init(&env, environ);
+		if (pw) {
+			env_set(&env, "USER", pw->pw_name);
+			env_set(&env, "HOME", pw->pw_dir);
+		} else {
+			env_set(&env, "USER", target_uid == 0 ? "root" : "nobody");
+			env_set(&env, "HOME", target_uid == 0 ? "/root" : "/");
+		}
+	}
+	// execvp() below searches the new PATH
+	char **envp = env_build(&env);
+	if (!envp) {
+		die(1, "Memory allocation failed");
+	}
+	environ = envp;
+	trace_mark("env");
+	trace_emit(basename(program_name));
+
+	// Execute the command.  Login mode replaced PATH, so the earlier
+	// lookup no longer applies; if the target cannot run the resolved
+	// file, execvp() gives the usual PATH search and error.
+	if (cmd_path && cmd_path[0] != '\0' && !login_mode) {
+		execv(cmd_path, cmd_argv);
+	}
+	execvp(cmd_argv[0], cmd_argv);
+	die(127, "Failed to execute '%s'", cmd_argv[0]);
+}
@@ -0,0 +1,50 @@
+#ifndef EXEC_COMMON_H
+#define EXEC_COMMON_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "auth_common.h"
+
+/*
+ * Switching to a resolved USER[:GROUP] and executing a command, shared by
+ * suex and suexd.
+ */
+
+// Maximum path length for shell
+#define MAX_PATH 4096
+
+// Set from argv[0] by main(); prefixes die() messages
+extern char *program_name;
+
+// One USER[:GROUP] resolved to the ids and groups to switch to
+struct target {
+	char *spec;		// USER[:GROUP] as written, NULL in single mode
+	char *user;
+	char *group;
+	struct auth_query q;
+	uid_t uid;
+	gid_t gid;
+	uint64_t caps;		// capabilities kept for a non-root uid, 0 for none
+};
+
+// Print "prog: message[: strerror(errno)]" to stderr and exit with code
+void die(int code, const char *fmt, ...);
+
+// Split [@|+]USER[:GROUP] into malloc'd user and group (NULL if absent)
+int parse_user_group(const char *arg, char **user, char **group);
+
+// Fill t->q from t->user and t->group, ready for auth_resolve()
+void describe_target(struct target *t, uid_t caller_uid);
+
+// Set t->uid and t->gid from the resolved query; dies prefixed by where
+void resolve_ids(struct target *t, const char *where);
+
+/*
+ * Set groups and ids, build the environment and execute cmd_argv; never
+ * returns.  cmd_path is the command already resolved in PATH, or NULL.
+ */
+void become(struct acct_db *db, const struct target *t, int login_mode,
+	    char **cmd_argv, const char *cmd_path);
+
+#endif /* EXEC_COMMON_H */
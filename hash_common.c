@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_common.h"
+
+static const char itoa64[] =
+    "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+static int has_prefix(const char *s, size_t len, const char *prefix)
+{
+	size_t plen = strlen(prefix);
+
+	return len >= plen && memcmp(s, prefix, plen) == 0;
+}
+
+// Copy the field of s up to the next '$' into h->cost
+static void copy_cost(struct hash_info *h, const char *s, const char *end)
+{
+	const char *stop = memchr(s, '$', end - s);
+	size_t n = (stop ? stop : end) - s;
+
+	if (n >= sizeof(h->cost))
+		n = sizeof(h->cost) - 1;
+	memcpy(h->cost, s, n);
+	h->cost[n] = '\0';
+}
+
+static int is_des_chars(const char *s, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (!memchr(itoa64, s[i], sizeof(itoa64) - 1))
+			return 0;
+	}
+	return 1;
+}
+
+// $5$ and $6$: "rounds=N$" is optional and defaults to 5000
+static void parse_sha(struct hash_info *h, const char *s, const char *end)
+{
+	long rounds = 5000;
+
+	if (has_prefix(s, end - s, "rounds=")) {
+		rounds = strtol(s + 7, NULL, 10);
+		// crypt clamps rounds to this range
+		if (rounds < 1000)
+			rounds = 1000;
+		if (rounds > 999999999)
+			rounds = 999999999;
+	}
+	snprintf(h->cost, sizeof(h->cost), "%ld", rounds);
+	h->rating = rounds < HASH_SHA_ROUNDS_OK ? HASH_LEGACY : HASH_OK;
+}
+
+void hash_parse(const char *s, size_t len, struct hash_info *h)
+{
+	const char *end = s + len;
+
+	h->cost[0] = '\0';
+	h->locked = 0;
+	h->rating = HASH_UNKNOWN;
+	h->algo = "unknown";
+
+	// usermod -L and passwd -l prefix the hash with '!'
+	while (s < end && *s == '!') {
+		h->locked = 1;
+		s++;
+	}
+	len = end - s;
+	if (len == 0 && !h->locked) {
+		h->algo = "none";
+		h->rating = HASH_NONE;
+	} else if (len == 0 || *s == '*') {
+		h->algo = "disabled";
+		h->locked = 1;
+		h->rating = HASH_DISABLED;
+	} else if (has_prefix(s, len, "$1$")) {
+		h->algo = "md5crypt";
+		h->rating = HASH_WEAK;
+	} else if (has_prefix(s, len, "$2a$") || has_prefix(s, len, "$2b$") ||
+		   has_prefix(s, len, "$2x$") || has_prefix(s, len, "$2y$")) {
+		h->algo = "bcrypt";
+		copy_cost(h, s + 4, end);
+		h->rating = atoi(h->cost) < HASH_BCRYPT_COST_OK ? HASH_LEGACY
+		    : HASH_OK;
+	} else if (has_prefix(s, len, "$3$")) {
+		h->algo = "nthash";
+		h->rating = HASH_WEAK;
+	} else if (has_prefix(s, len, "$5$")) {
+		h->algo = "sha256crypt";
+		parse_sha(h, s + 3, end);
+	} else if (has_prefix(s, len, "$6$")) {
+		h->algo = "sha512crypt";
+		parse_sha(h, s + 3, end);
+	} else if (has_prefix(s, len, "$y$")) {
+		h->algo = "yescrypt";
+		copy_cost(h, s + 3, end);
+		h->rating = HASH_OK;
+	} else if (has_prefix(s, len, "$gy$")) {
+		h->algo = "gost-yescrypt";
+		copy_cost(h, s + 4, end);
+		h->rating = HASH_OK;
+	} else if (has_prefix(s, len, "$7$") && len > 3) {
+		// The first parameter character is log2 of N
+		const char *n = memchr(itoa64, s[3], sizeof(itoa64) - 1);
+		h->algo = "scrypt";
+		if (n)
+			snprintf(h->cost, sizeof(h->cost), "N=2^%d",
+				 (int)(n - itoa64));
+		h->rating = HASH_OK;
+	} else if (has_prefix(s, len, "$sha1$")) {
+		h->algo = "sha1crypt";
+		copy_cost(h, s + 6, end);
+		h->rating = HASH_LEGACY;
+	} else if (has_prefix(s, len, "$md5")) {
+		h->algo = "sunmd5";
+		h->rating = HASH_WEAK;
+	} else if (len == 20 && *s == '_' && is_des_chars(s + 1, 19)) {
+		h->algo = "bsdicrypt";
+		h->rating = HASH_WEAK;
+	} else if (len == 13 && is_des_chars(s, 13)) {
+		h->algo = "descrypt";
+		h->rating = HASH_WEAK;
+	}
+}
+
+const char *hash_rating_name(enum hash_rating r)
+{
+	static const char *const names[] = {
+		[HASH_OK] = "ok",
+		[HASH_LEGACY] = "legacy",
+		[HASH_WEAK] = "weak",
+		[HASH_NONE] = "none",
+		[HASH_DISABLED] = "disabled",
+		[HASH_UNKNOWN] = "unknown",
+	};
+
+	return names[r];
+}
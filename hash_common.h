@@ -0,0 +1,38 @@
+#ifndef HASH_COMMON_H
+#define HASH_COMMON_H
+
+#include <stddef.h>
+
+/*
+ * Classification of crypt(3) hashes as stored in shadow, for usrx
+ * hashaudit.  Only the prefix and cost parameters are read; nothing is
+ * verified.
+ */
+
+// sha256crypt/sha512crypt rounds below this are rated legacy
+#define HASH_SHA_ROUNDS_OK 100000
+// bcrypt costs below this are rated legacy
+#define HASH_BCRYPT_COST_OK 10
+
+enum hash_rating {
+	HASH_OK,		// current algorithm and cost
+	HASH_LEGACY,		// sound algorithm, cost too low today
+	HASH_WEAK,		// broken or trivially brute-forced
+	HASH_NONE,		// empty: no password needed at all
+	HASH_DISABLED,		// "*" or "!": no password can match
+	HASH_UNKNOWN,
+};
+
+struct hash_info {
+	const char *algo;	// "sha512crypt", "yescrypt", ...
+	char cost[24];		// rounds, cost factor or parameters; "" if none
+	int locked;		// prefixed with '!' (or '*' for no login)
+	enum hash_rating rating;
+};
+
+// Classify the shadow password field s[0..len)
+void hash_parse(const char *s, size_t len, struct hash_info *h);
+
+const char *hash_rating_name(enum hash_rating r);
+
+#endif /* HASH_COMMON_H */
@@ -0,0 +1,110 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "msg_common.h"
+
+#define MSG_MAX 4096
+
+static size_t put(char *buf, size_t size, size_t len, const char *s,
+		  size_t n)
+{
+	if (len < size) {
+		size_t room = size - len - 1;
+		memcpy(buf + len, s, n < room ? n : room);
+	}
+	return len + n;
+}
+
+static size_t put_num(char *buf, size_t size, size_t len, long v,
+		      int is_signed)
+{
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	unsigned long u = v;
+
+	if (is_signed && v < 0)
+		u = -(unsigned long)v;
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (is_signed && v < 0)
+		*--p = '-';
+	return put(buf, size, len, p, digits + sizeof(digits) - p);
+}
+
+int msg_vformat(char *buf, size_t size, const char *fmt, va_list ap)
+{
+	size_t len = 0;
+
+	for (const char *f = fmt; *f; f++) {
+		const char *s;
+
+		if (*f != '%') {
+			s = strchr(f, '%');
+			size_t n = s ? (size_t)(s - f) : strlen(f);
+			len = put(buf, size, len, f, n);
+			f += n - 1;
+			continue;
+		}
+		switch (*++f) {
+		case 's':
+			s = va_arg(ap, const char *);
+			if (!s)
+				s = "(null)";
+			len = put(buf, size, len, s, strlen(s));
+			break;
+		case 'd':
+			len = put_num(buf, size, len, va_arg(ap, int), 1);
+			break;
+		case 'u':
+			len = put_num(buf, size, len, va_arg(ap, unsigned), 0);
+			break;
+		case '%':
+			len = put(buf, size, len, "%", 1);
+			break;
+		case 'l':
+			if (f[1] == 'd') {
+				f++;
+				len = put_num(buf, size, len, va_arg(ap, long),
+					      1);
+				break;
+			}
+			// fall through
+		default:
+			// Unknown conversions are copied as written
+			len = put(buf, size, len, f - 1, *f ? 2 : 1);
+			if (!*f)
+				f--;
+			break;
+		}
+	}
+	if (size > 0)
+		buf[len < size ? len : size - 1] = '\0';
+	return len;
+}
+
+int msg_format(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	int len = msg_vformat(buf, size, fmt, ap);
+	va_end(ap);
+	return len;
+}
+
+void msg_print(int fd, const char *fmt, ...)
+{
+	char buf[MSG_MAX];
+	va_list ap;
+
+	va_start(ap, fmt);
+	size_t len = msg_vformat(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+	if (write(fd, buf, len) < 0) {
+		// Nowhere left to report it
+	}
+}
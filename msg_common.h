@@ -0,0 +1,18 @@
+#ifndef MSG_COMMON_H
+#define MSG_COMMON_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * Message formatting without stdio, so suex does not link the printf
+ * family.  Understands %s, %d, %u, %ld and %% only.  Like snprintf(),
+ * output is truncated to size and the untruncated length is returned.
+ */
+int msg_vformat(char *buf, size_t size, const char *fmt, va_list ap);
+int msg_format(char *buf, size_t size, const char *fmt, ...);
+
+// Format into a bounded buffer and write it to fd with one write()
+void msg_print(int fd, const char *fmt, ...);
+
+#endif /* MSG_COMMON_H */
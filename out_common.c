@@ -0,0 +1,574 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "out_common.h"
+
+void out_init(struct out *o, int fd)
+{
+	o->fd = fd;
+	o->buf = NULL;
+	o->len = 0;
+	o->cap = 0;
+	o->failed = 0;
+}
+
+int out_parse_format(const char *name)
+{
+	static const char *names[] = {
+		[OUT_TEXT] = "text",
+		[OUT_JSON] = "json",
+		[OUT_NDJSON] = "ndjson",
+		[OUT_TSV] = "tsv",
+	};
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (strcmp(name, names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+// Room for n more bytes; NULL once anything failed
+static char *out_reserve(struct out *o, size_t n)
+{
+	if (o->failed)
+		return NULL;
+	if (o->len + n > o->cap) {
+		size_t cap = o->cap ? o->cap : 4096;
+		while (cap < o->len + n)
+			cap *= 2;
+		char *buf = realloc(o->buf, cap);
+		if (!buf) {
+			o->failed = 1;
+			return NULL;
+		}
+		o->buf = buf;
+		o->cap = cap;
+	}
+	return o->buf + o->len;
+}
+
+void out_put(struct out *o, const char *s, size_t len)
+{
+	char *p = out_reserve(o, len);
+
+	if (p) {
+		memcpy(p, s, len);
+		o->len += len;
+	}
+}
+
+void out_puts(struct out *o, const char *s)
+{
+	out_put(o, s, strlen(s));
+}
+
+void out_long(struct out *o, long v)
+{
+	char buf[24], *p = buf + sizeof(buf);
+	unsigned long u = v < 0 ? -(unsigned long)v : (unsigned long)v;
+
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (v < 0)
+		*--p = '-';
+	out_put(o, p, buf + sizeof(buf) - p);
+}
+
+static int json_special(unsigned char c)
+{
+	return c < 32 || c > 126 || c == '"' || c == '\\';
+}
+
+/*
+ * Account fields rarely need escaping, so look for the first byte that
+ * does 16 (or 8) bytes at a time and copy everything before it at once.
+ */
+size_t out_json_plain(const char *s, size_t len)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(32);
+	const __m128i del = _mm_set1_epi8(127);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		// Signed compare: bytes >= 128 are negative, so below space
+		__m128i m = _mm_or_si128(_mm_cmplt_epi8(v, space),
+					 _mm_cmpeq_epi8(v, del));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+						 _mm_cmpeq_epi8(v, bslash)));
+		int mask = _mm_movemask_epi8(m);
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#elif defined(__aarch64__)
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)s + i);
+		uint8x16_t m = vorrq_u8(vcltq_u8(v, vdupq_n_u8(32)),
+					vcgtq_u8(v, vdupq_n_u8(126)));
+		m = vorrq_u8(m, vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')),
+					 vceqq_u8(v, vdupq_n_u8('\\'))));
+		if (vmaxvq_u8(m))
+			break;
+	}
+#else
+	// Eight bytes per step: flag bytes below 32, at or above 127, '"'
+	// and '\\', then find the first one bytewise
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t high = 0x8080808080808080ULL;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t x;
+		memcpy(&x, s + i, 8);
+		uint64_t q = x ^ ones * '"', b = x ^ ones * '\\';
+		uint64_t d = x ^ ones * 127;
+		uint64_t hit = (x & high) | ((x - ones * 32) & ~x & high) |
+		    ((q - ones) & ~q & high) | ((b - ones) & ~b & high) |
+		    ((d - ones) & ~d & high);
+		if (hit)
+			break;
+	}
+#endif
+	while (i < len && !json_special(s[i]))
+		i++;
+	return i;
+}
+
+void out_json_string(struct out *o, const char *s, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *end = s + len;
+
+	out_put(o, "\"", 1);
+	while (s < end) {
+		size_t n = out_json_plain(s, end - s);
+		out_put(o, s, n);
+		s += n;
+		if (s == end)
+			break;
+
+		unsigned char c = *s++;
+		char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+		switch (c) {
+		case '"':
+		case '\\':
+			esc[1] = c;
+			break;
+		case '\b':
+			esc[1] = 'b';
+			break;
+		case '\f':
+			esc[1] = 'f';
+			break;
+		case '\n':
+			esc[1] = 'n';
+			break;
+		case '\r':
+			esc[1] = 'r';
+			break;
+		case '\t':
+			esc[1] = 't';
+			break;
+		default:
+			out_put(o, esc, 6);
+			continue;
+		}
+		out_put(o, esc, 2);
+	}
+	out_put(o, "\"", 1);
+}
+
+void out_tsv_field(struct out *o, const char *s, size_t len)
+{
+	const char *end = s + len;
+
+	while (s < end) {
+		const char *p = s;
+		while (p < end && *p != '\\' && *p != '\t' && *p != '\n' &&
+		       *p != '\r')
+			p++;
+		out_put(o, s, p - s);
+		if (p == end)
+			break;
+		char esc[2] = { '\\', *p == '\\' ? '\\' : *p == '\t' ? 't' :
+			    *p == '\n' ? 'n' : 'r'
+		};
+		out_put(o, esc, 2);
+		s = p + 1;
+	}
+}
+
+static void out_str(struct out *o, const struct acct_str *s)
+{
+	out_put(o, s->s, s->len);
+}
+
+static void out_group_json(struct out *o, const struct acct_gname *g)
+{
+	out_puts(o, "{\"name\":");
+	out_json_string(o, g->name.s, g->name.len);
+	out_puts(o, ",\"gid\":");
+	out_long(o, g->gid);
+	out_put(o, "}", 1);
+}
+
+static void out_groups_json(struct out *o, const struct acct_gname *g, int n)
+{
+	out_put(o, "[", 1);
+	for (int i = 0; i < n; i++) {
+		if (i > 0)
+			out_put(o, ",", 1);
+		out_group_json(o, &g[i]);
+	}
+	out_put(o, "]", 1);
+}
+
+// "name": with the indent of an info -j field, or bare on one line
+static void out_key(struct out *o, const char *key, const char *in)
+{
+	out_puts(o, in);
+	out_put(o, "\"", 1);
+	out_puts(o, key);
+	out_put(o, "\":", 2);
+}
+
+void out_user_json(struct out *o, const struct out_user *u, int compact)
+{
+	const char *sep = compact ? "," : ",\n";
+	const char *in = compact ? "" : "  ";
+	const char *in2 = compact ? "" : "    ";
+	const struct acct_pwent *pw = u->pw;
+	const struct acct_spent *sp = u->sp;
+
+	out_puts(o, compact ? "{" : "{\n");
+	out_key(o, "user", in);
+	out_json_string(o, pw->name.s, pw->name.len);
+	out_puts(o, sep);
+	if (u->group) {
+		out_key(o, "group", in);
+		out_json_string(o, u->group->s, u->group->len);
+		out_puts(o, sep);
+	}
+	out_key(o, "uid", in);
+	out_long(o, pw->uid);
+	out_puts(o, sep);
+	out_key(o, "gid", in);
+	out_long(o, pw->gid);
+	out_puts(o, sep);
+	out_key(o, "home", in);
+	out_json_string(o, pw->dir.s, pw->dir.len);
+	out_puts(o, sep);
+	out_key(o, "shell", in);
+	out_json_string(o, pw->shell.s, pw->shell.len);
+	out_puts(o, sep);
+	if (pw->gecos.len > 0) {
+		out_key(o, "gecos", in);
+		out_json_string(o, pw->gecos.s, pw->gecos.len);
+		out_puts(o, sep);
+	}
+	out_key(o, "groups", in);
+	out_groups_json(o, u->groups, u->ngroups > 0 ? u->ngroups : 0);
+
+	if (sp) {
+		const struct {
+			const char *key;
+			long v;
+		} days[] = {
+			{"last_change", sp->lstchg},
+			{"min_days", sp->min},
+			{"max_days", sp->max},
+			{"warn_days", sp->warn},
+			{"inactive_days", sp->inact},
+			{"expiration", sp->expire},
+		};
+
+		out_puts(o, sep);
+		out_key(o, "shadow", in);
+		out_puts(o, compact ? "{" : " {\n");
+		if (!u->skip_password) {
+			out_key(o, "encrypted_password", in2);
+			out_json_string(o, sp->pwdp.s, sp->pwdp.len);
+			out_puts(o, sep);
+		}
+		for (size_t i = 0; i < sizeof(days) / sizeof(days[0]); i++) {
+			if (i > 0)
+				out_puts(o, sep);
+			out_key(o, days[i].key, in2);
+			out_long(o, days[i].v);
+		}
+		out_puts(o, compact ? "" : "\n");
+		out_puts(o, in);
+		out_put(o, "}", 1);
+	}
+	out_puts(o, compact ? "}" : "\n}");
+}
+
+static void out_user_tsv(struct out *o, const struct out_user *u)
+{
+	const struct acct_pwent *pw = u->pw;
+	const struct acct_spent *sp = u->sp;
+
+	out_tsv_field(o, pw->name.s, pw->name.len);
+	out_put(o, "\t", 1);
+	out_long(o, pw->uid);
+	out_put(o, "\t", 1);
+	out_long(o, pw->gid);
+	out_put(o, "\t", 1);
+	if (u->group)
+		out_tsv_field(o, u->group->s, u->group->len);
+	out_put(o, "\t", 1);
+	out_tsv_field(o, pw->dir.s, pw->dir.len);
+	out_put(o, "\t", 1);
+	out_tsv_field(o, pw->shell.s, pw->shell.len);
+	out_put(o, "\t", 1);
+	out_tsv_field(o, pw->gecos.s, pw->gecos.len);
+	out_put(o, "\t", 1);
+	for (int i = 0; i < u->ngroups; i++) {
+		if (i > 0)
+			out_put(o, ",", 1);
+		out_tsv_field(o, u->groups[i].name.s, u->groups[i].name.len);
+	}
+	out_put(o, "\t", 1);
+	if (sp && !u->skip_password)
+		out_tsv_field(o, sp->pwdp.s, sp->pwdp.len);
+	const long days[] = {
+		sp ? sp->lstchg : 0, sp ? sp->min : 0, sp ? sp->max : 0,
+		sp ? sp->warn : 0, sp ? sp->inact : 0, sp ? sp->expire : 0,
+	};
+	for (size_t i = 0; i < sizeof(days) / sizeof(days[0]); i++) {
+		out_put(o, "\t", 1);
+		if (sp)
+			out_long(o, days[i]);
+	}
+	out_put(o, "\n", 1);
+}
+
+void out_shadow_days(struct out *o, const struct acct_spent *sp)
+{
+	const struct {
+		const char *label;
+		long v;
+	} days[] = {
+		{"Last password change (days since Jan 1, 1970): ", sp->lstchg},
+		{"Minimum days between password changes: ", sp->min},
+		{"Maximum days between password changes: ", sp->max},
+		{"Warning days before password expires: ", sp->warn},
+		{"Days after password expires until account becomes inactive: ",
+		 sp->inact},
+		{"Account expiration date (days since Jan 1, 1970): ",
+		 sp->expire},
+	};
+
+	for (size_t i = 0; i < sizeof(days) / sizeof(days[0]); i++) {
+		out_puts(o, days[i].label);
+		out_long(o, days[i].v);
+		out_put(o, "\n", 1);
+	}
+}
+
+static void out_user_text(struct out *o, const struct out_user *u)
+{
+	const struct acct_pwent *pw = u->pw;
+
+	out_puts(o, "User Information for '");
+	out_str(o, &pw->name);
+	out_puts(o, "':\n------------------------\nUsername: ");
+	out_str(o, &pw->name);
+	out_puts(o, "\nUser ID: ");
+	out_long(o, pw->uid);
+	out_puts(o, "\nPrimary group ID: ");
+	out_long(o, pw->gid);
+	out_put(o, "\n", 1);
+	if (u->group) {
+		out_puts(o, "Primary group name: ");
+		out_str(o, u->group);
+		out_put(o, "\n", 1);
+	}
+	out_puts(o, "Home directory: ");
+	out_str(o, &pw->dir);
+	out_puts(o, "\nShell: ");
+	out_str(o, &pw->shell);
+	out_put(o, "\n", 1);
+	if (pw->gecos.len > 0) {
+		out_puts(o, "GECOS: ");
+		out_str(o, &pw->gecos);
+		out_put(o, "\n", 1);
+	}
+	if (u->ngroups >= 0)
+		out_groups(o, OUT_TEXT, u->groups, u->ngroups);
+
+	if (!u->show_shadow)
+		return;
+	out_puts(o, "\nShadow Information (root only):\n"
+		 "-----------------------------\n");
+	if (!u->sp) {
+		out_puts(o, "No shadow information available\n");
+		return;
+	}
+	if (!u->skip_password) {
+		out_puts(o, "Encrypted password: ");
+		out_str(o, &u->sp->pwdp);
+		out_put(o, "\n", 1);
+	}
+	out_puts(o, "Password Aging Information:\n");
+	out_shadow_days(o, u->sp);
+}
+
+void out_user(struct out *o, enum out_format f, const struct out_user *u)
+{
+	switch (f) {
+	case OUT_JSON:
+	case OUT_NDJSON:
+		out_user_json(o, u, f == OUT_NDJSON);
+		out_put(o, "\n", 1);
+		break;
+	case OUT_TSV:
+		out_user_tsv(o, u);
+		break;
+	case OUT_TEXT:
+		out_user_text(o, u);
+		break;
+	}
+}
+
+void out_groups(struct out *o, enum out_format f, const struct acct_gname *g,
+		int n)
+{
+	switch (f) {
+	case OUT_JSON:
+		out_groups_json(o, g, n);
+		out_put(o, "\n", 1);
+		break;
+	case OUT_NDJSON:
+		for (int i = 0; i < n; i++) {
+			out_group_json(o, &g[i]);
+			out_put(o, "\n", 1);
+		}
+		break;
+	case OUT_TSV:
+		for (int i = 0; i < n; i++) {
+			out_tsv_field(o, g[i].name.s, g[i].name.len);
+			out_put(o, "\t", 1);
+			out_long(o, g[i].gid);
+			out_put(o, "\n", 1);
+		}
+		break;
+	case OUT_TEXT:
+		out_puts(o, "Groups: ");
+		for (int i = 0; i < n; i++) {
+			if (i > 0)
+				out_put(o, ", ", 2);
+			out_str(o, &g[i].name);
+			out_put(o, "(", 1);
+			out_long(o, g[i].gid);
+			out_put(o, ")", 1);
+		}
+		out_put(o, "\n", 1);
+		break;
+	}
+}
+
+static void out_member_json(struct out *o, const struct acct_member *m)
+{
+	out_puts(o, "{\"name\":");
+	out_json_string(o, m->name.s, m->name.len);
+	out_puts(o, ",\"uid\":");
+	out_long(o, m->uid);
+	out_puts(o, m->primary ? ",\"primary\":true" : ",\"primary\":false");
+	out_puts(o, m->listed ? ",\"listed\":true}" : ",\"listed\":false}");
+}
+
+void out_members(struct out *o, enum out_format f,
+		 const struct acct_member *m, int n)
+{
+	switch (f) {
+	case OUT_JSON:
+		out_put(o, "[", 1);
+		for (int i = 0; i < n; i++) {
+			if (i > 0)
+				out_put(o, ",", 1);
+			out_member_json(o, &m[i]);
+			out_end_record(o);
+		}
+		out_put(o, "]\n", 2);
+		break;
+	case OUT_NDJSON:
+		for (int i = 0; i < n; i++) {
+			out_member_json(o, &m[i]);
+			out_put(o, "\n", 1);
+			out_end_record(o);
+		}
+		break;
+	case OUT_TSV:
+		for (int i = 0; i < n; i++) {
+			out_tsv_field(o, m[i].name.s, m[i].name.len);
+			out_put(o, "\t", 1);
+			out_long(o, m[i].uid);
+			out_puts(o, m[i].primary ? "\tyes" : "\tno");
+			out_puts(o, m[i].listed ? "\tyes\n" : "\tno\n");
+			out_end_record(o);
+		}
+		break;
+	case OUT_TEXT:
+		out_puts(o, "Members: ");
+		for (int i = 0; i < n; i++) {
+			if (i > 0)
+				out_put(o, ", ", 2);
+			out_str(o, &m[i].name);
+			out_put(o, "(", 1);
+			out_long(o, m[i].uid);
+			out_put(o, ")", 1);
+		}
+		out_put(o, "\n", 1);
+		break;
+	}
+}
+
+static int out_write(struct out *o)
+{
+	size_t off = 0;
+
+	while (off < o->len && !o->failed) {
+		ssize_t n = write(o->fd, o->buf + off, o->len - off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			o->failed = 1;
+		else
+			off += n;
+	}
+	o->len = 0;
+	return o->failed ? -1 : 0;
+}
+
+void out_end_record(struct out *o)
+{
+	if (o->len >= OUT_FLUSH)
+		out_write(o);
+}
+
+int out_flush(struct out *o)
+{
+	return out_write(o);
+}
+
+void out_free(struct out *o)
+{
+	free(o->buf);
+	out_init(o, o->fd);
+}
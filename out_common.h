@@ -0,0 +1,100 @@
+#ifndef OUT_COMMON_H
+#define OUT_COMMON_H
+
+#include <stddef.h>
+
+#include "acct_common.h"
+
+/*
+ * Record output for usrx.  Records are built in one growing buffer and
+ * written with a single write() once a record is complete, so a record is
+ * never split across writes; bulk output batches whole records up to
+ * OUT_FLUSH bytes per write.  Write and allocation failures are sticky
+ * and reported by out_flush().
+ */
+
+// Buffered bytes that make out_end_record() write
+#define OUT_FLUSH 65536
+
+enum out_format {
+	OUT_TEXT,
+	OUT_JSON,
+	OUT_NDJSON,
+	OUT_TSV,
+};
+
+struct out {
+	int fd;
+	char *buf;
+	size_t len;
+	size_t cap;
+	int failed;
+};
+
+// One user as info prints it; views may point into the mapped files
+struct out_user {
+	const struct acct_pwent *pw;
+	const struct acct_str *group;	// primary group name, NULL if unknown
+	const struct acct_gname *groups;
+	int ngroups;		// < 0 when the groups could not be resolved
+	const struct acct_spent *sp;	// NULL when unavailable
+	int show_shadow;	// root: text output notes a missing entry
+	int skip_password;
+};
+
+void out_init(struct out *o, int fd);
+
+// json, ndjson, tsv or text; -1 for anything else
+int out_parse_format(const char *name);
+
+void out_put(struct out *o, const char *s, size_t len);
+void out_puts(struct out *o, const char *s);
+void out_long(struct out *o, long v);
+
+// Length of the prefix of s that JSON can carry without escapes
+size_t out_json_plain(const char *s, size_t len);
+
+// s as a quoted JSON string; bytes outside printable ASCII as \u00XX
+void out_json_string(struct out *o, const char *s, size_t len);
+
+// s as a TSV field, with backslash, tab, newline and CR escaped
+void out_tsv_field(struct out *o, const char *s, size_t len);
+
+/*
+ * One user in format f, ending in a newline.  JSON is indented, NDJSON
+ * is the same object on one line; TSV is one line of user, uid, gid,
+ * group, home, shell, gecos, groups (comma-separated) and the shadow
+ * fields, left empty when unavailable.
+ */
+void out_user(struct out *o, enum out_format f, const struct out_user *u);
+
+// The JSON object alone, indented or on one line, without a newline
+void out_user_json(struct out *o, const struct out_user *u, int compact);
+
+/*
+ * A group list in format f: a JSON array, one object or TSV line per
+ * group, or the "Groups: name(gid), ..." line of the text output.
+ */
+void out_groups(struct out *o, enum out_format f, const struct acct_gname *g,
+		int n);
+
+/*
+ * Group members in format f: a JSON array or one object per line of
+ * {"name", "uid", "primary", "listed"}, TSV lines of the same four
+ * columns with yes/no flags, or a "Members: name(uid), ..." line.
+ */
+void out_members(struct out *o, enum out_format f,
+		 const struct acct_member *m, int n);
+
+// The password aging lines of the text output
+void out_shadow_days(struct out *o, const struct acct_spent *sp);
+
+// Write the buffer once it holds OUT_FLUSH bytes of complete records
+void out_end_record(struct out *o);
+
+// Write everything buffered; -1 if any write or allocation failed
+int out_flush(struct out *o);
+
+void out_free(struct out *o);
+
+#endif /* OUT_COMMON_H */
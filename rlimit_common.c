@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rlimit_common.h"
+
+// Longest defaults file read; it holds a few lines per service user
+#define LIMITS_MAX 65536
+
+static const struct {
+	const char *name;
+	int resource;
+} names[] = {
+	{"as", RLIMIT_AS},
+	{"core", RLIMIT_CORE},
+	{"cpu", RLIMIT_CPU},
+	{"data", RLIMIT_DATA},
+	{"fsize", RLIMIT_FSIZE},
+	{"locks", RLIMIT_LOCKS},
+	{"memlock", RLIMIT_MEMLOCK},
+	{"msgqueue", RLIMIT_MSGQUEUE},
+	{"nice", RLIMIT_NICE},
+	{"nofile", RLIMIT_NOFILE},
+	{"nproc", RLIMIT_NPROC},
+	{"rss", RLIMIT_RSS},
+	{"rtprio", RLIMIT_RTPRIO},
+	{"rttime", RLIMIT_RTTIME},
+	{"sigpending", RLIMIT_SIGPENDING},
+	{"stack", RLIMIT_STACK},
+};
+
+#define NNAMES (sizeof(names) / sizeof(names[0]))
+
+void rlimit_init(struct rlimit_opts *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+// Parse s[0..len) as a number with an optional K/M/G suffix or unlimited
+static int parse_value(const char *s, size_t len, rlim_t *v)
+{
+	int shift = 0;
+	size_t i = 0;
+
+	if (len == 9 && strncmp(s, "unlimited", 9) == 0) {
+		*v = RLIM_INFINITY;
+		return 0;
+	}
+	*v = 0;
+	if (len == 0) {
+		return -1;
+	}
+	for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+		if (*v > (RLIM_INFINITY - 1 - (s[i] - '0')) / 10) {
+			return -1;
+		}
+		*v = *v * 10 + (s[i] - '0');
+	}
+	if (i == 0) {
+		return -1;
+	}
+	if (i + 1 == len) {
+		switch (s[i]) {
+		case 'K':
+			shift = 10;
+			break;
+		case 'M':
+			shift = 20;
+			break;
+		case 'G':
+			shift = 30;
+			break;
+		default:
+			return -1;
+		}
+	} else if (i != len) {
+		return -1;
+	}
+	// RLIM_INFINITY is only ever written as "unlimited"
+	if (*v > (RLIM_INFINITY - 1) >> shift) {
+		return -1;
+	}
+	*v <<= shift;
+	return 0;
+}
+
+// Parse NAME=SOFT[:HARD] in s[0..len) into r, unless an option set it
+static int parse_spec(struct rlimit_opts *r, const char *s, size_t len,
+		      int from)
+{
+	const char *eq = memchr(s, '=', len), *colon, *end = s + len;
+	struct rlimit lim = { 0 };
+	int res = -1, soft, hard;
+
+	if (!eq) {
+		return -1;
+	}
+	for (size_t i = 0; i < NNAMES; i++) {
+		if (strlen(names[i].name) == (size_t)(eq - s) &&
+		    strncmp(names[i].name, s, eq - s) == 0) {
+			res = names[i].resource;
+		}
+	}
+	if (res < 0) {
+		return -1;
+	}
+	s = eq + 1;
+	colon = memchr(s, ':', end - s);
+	if (!colon) {
+		// A single value sets both, as with prlimit(1)
+		if (parse_value(s, end - s, &lim.rlim_cur) < 0) {
+			return -1;
+		}
+		lim.rlim_max = lim.rlim_cur;
+		soft = hard = 1;
+	} else {
+		soft = colon > s;
+		hard = colon + 1 < end;
+		if ((!soft && !hard) ||
+		    (soft && parse_value(s, colon - s, &lim.rlim_cur) < 0) ||
+		    (hard && parse_value(colon + 1, end - colon - 1,
+					 &lim.rlim_max) < 0) ||
+		    (soft && hard && lim.rlim_cur > lim.rlim_max)) {
+			return -1;
+		}
+	}
+	if (r->from[res] > from) {
+		return 0;
+	}
+	r->from[res] = from;
+	r->has_soft[res] = soft;
+	r->has_hard[res] = hard;
+	r->lim[res] = lim;
+	return 0;
+}
+
+int rlimit_parse(struct rlimit_opts *r, const char *spec)
+{
+	return parse_spec(r, spec, strlen(spec), 2);
+}
+
+// Check if s[0..len) is "*", user or the decimal uid
+static int line_matches(const char *s, size_t len, const char *user,
+			uid_t uid)
+{
+	unsigned long long n = 0;
+
+	if ((len == 1 && *s == '*') ||
+	    (user && strlen(user) == len && strncmp(user, s, len) == 0)) {
+		return 1;
+	}
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] < '0' || s[i] > '9' || n > (uid_t)-1) {
+			return 0;
+		}
+		n = n * 10 + (s[i] - '0');
+	}
+	return len > 0 && n == uid;
+}
+
+int rlimit_load(struct rlimit_opts *r, const char *path, const char *user,
+		uid_t uid, int *line)
+{
+	static char buf[LIMITS_MAX];
+	struct stat st;
+	ssize_t len = 0, n;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	*line = 0;
+	if (fd < 0) {
+		return errno == ENOENT ? 0 : -1;
+	}
+	// suex runs as root, so only root may decide what it raises
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+	if (st.st_uid != 0 || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		close(fd);
+		errno = EPERM;
+		return -1;
+	}
+	while ((n = read(fd, buf + len, sizeof(buf) - len)) > 0) {
+		len += n;
+	}
+	close(fd);
+	if (n < 0 || len == sizeof(buf)) {
+		if (n == 0) {
+			errno = EFBIG;
+		}
+		return -1;
+	}
+	buf[len] = '\0';
+
+	for (char *p = buf, *end = buf + len; p < end; ) {
+		char *eol = memchr(p, '\n', end - p), *hash;
+		int match = -1;
+
+		if (!eol) {
+			eol = end;
+		}
+		(*line)++;
+		hash = memchr(p, '#', eol - p);
+		if (hash) {
+			eol = hash;
+		}
+		// The first word picks the user, the rest are limits
+		while (p < eol) {
+			size_t w;
+
+			p += strspn(p, " \t\r");
+			if (p >= eol) {
+				break;
+			}
+			w = strcspn(p, " \t\r\n#");
+			if (match < 0) {
+				match = line_matches(p, w, user, uid);
+			} else if (match && parse_spec(r, p, w, 1) < 0) {
+				errno = 0;
+				return -1;
+			}
+			p += w;
+		}
+		p = (hash ? memchr(hash, '\n', end - hash) : eol);
+		p = p ? p + 1 : end;
+	}
+	*line = 0;
+	return 0;
+}
+
+int rlimit_any(const struct rlimit_opts *r)
+{
+	for (int i = 0; i < RLIM_NLIMITS; i++) {
+		if (r->from[i]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int rlimit_apply(const struct rlimit_opts *r, const char **what)
+{
+	for (size_t i = 0; i < NNAMES; i++) {
+		int res = names[i].resource;
+		struct rlimit lim;
+
+		if (!r->from[res]) {
+			continue;
+		}
+		*what = names[i].name;
+		if (getrlimit(res, &lim) < 0) {
+			return -1;
+		}
+		if (r->has_soft[res]) {
+			lim.rlim_cur = r->lim[res].rlim_cur;
+		}
+		if (r->has_hard[res]) {
+			lim.rlim_max = r->lim[res].rlim_max;
+		}
+		if (setrlimit(res, &lim) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
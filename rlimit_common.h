@@ -0,0 +1,52 @@
+#ifndef RLIMIT_COMMON_H
+#define RLIMIT_COMMON_H
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/*
+ * Resource limits suex sets for itself before dropping root, when it can
+ * still raise hard limits, so the command inherits them without a ulimit
+ * wrapper.  They come from --rlimit options and from the defaults file,
+ * where options win over the file and later file lines over earlier ones.
+ */
+
+// Per-user defaults: lines of "USER|UID|* NAME=SOFT[:HARD]...", # comments
+#define SUEX_LIMITS "/etc/suex/limits"
+
+struct rlimit_opts {
+	char from[RLIM_NLIMITS];	// 0 unset, 1 from the file, 2 option
+	char has_soft[RLIM_NLIMITS];
+	char has_hard[RLIM_NLIMITS];
+	struct rlimit lim[RLIM_NLIMITS];
+};
+
+void rlimit_init(struct rlimit_opts *r);
+
+/*
+ * Parse NAME=SOFT[:HARD] as given with --rlimit: NAME as in prlimit(1)
+ * (nofile, memlock, stack, ...), values as numbers with an optional K, M
+ * or G suffix or "unlimited".  A single value sets both limits; an empty
+ * side keeps the current one.  -1 if it is invalid.
+ */
+int rlimit_parse(struct rlimit_opts *r, const char *spec);
+
+/*
+ * Add the lines of path matching user (may be NULL) or uid.  A missing
+ * file is not an error.  Returns -1 with errno set if the file cannot be
+ * read or is writable by anyone but root, or with errno 0 and *line set
+ * to the first invalid line.
+ */
+int rlimit_load(struct rlimit_opts *r, const char *path, const char *user,
+		uid_t uid, int *line);
+
+// Check if any limit was given
+int rlimit_any(const struct rlimit_opts *r);
+
+/*
+ * Set the limits on the calling process; on failure returns -1 with errno
+ * set and *what naming the limit.
+ */
+int rlimit_apply(const struct rlimit_opts *r, const char **what);
+
+#endif /* RLIMIT_COMMON_H */
@@ -0,0 +1,218 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "sched_common.h"
+
+// From linux/ioprio.h, which libcs do not wrap
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+// Argument names and the values they stand for
+struct sched_name {
+	const char *name;
+	const char *alias;
+	int value;
+};
+
+static const struct sched_name io_classes[] = {
+	{"none", NULL, 0},
+	{"realtime", "rt", 1},
+	{"best-effort", "be", 2},
+	{"idle", NULL, 3},
+};
+
+static const struct sched_name policies[] = {
+	{"other", "normal", SCHED_OTHER},
+	{"fifo", NULL, SCHED_FIFO},
+	{"rr", NULL, SCHED_RR},
+	{"batch", NULL, SCHED_BATCH},
+	{"idle", NULL, SCHED_IDLE},
+};
+
+void sched_init(struct sched_opts *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->ioprio = -1;
+	s->policy = -1;
+	s->timerslack = -1;
+}
+
+// Parse all of s as a decimal number in [min, max]
+static int parse_long(const char *s, long min, long max, long *v)
+{
+	char *end;
+
+	if (!*s) {
+		return -1;
+	}
+	errno = 0;
+	*v = strtol(s, &end, 10);
+	if (*end != '\0' || errno || *v < min || *v > max) {
+		errno = 0;
+		return -1;
+	}
+	return 0;
+}
+
+int sched_parse_cpus(struct sched_opts *s, const char *list)
+{
+	const char *p = list;
+
+	CPU_ZERO(&s->cpus);
+	while (*p) {
+		char *end;
+		long lo = strtol(p, &end, 10), hi = lo;
+
+		if (end == p || lo < 0) {
+			return -1;
+		}
+		if (*end == '-') {
+			p = end + 1;
+			hi = strtol(p, &end, 10);
+			if (end == p || hi < lo) {
+				return -1;
+			}
+		}
+		if (hi >= CPU_SETSIZE || (*end != ',' && *end != '\0')) {
+			return -1;
+		}
+		for (long c = lo; c <= hi; c++) {
+			CPU_SET(c, &s->cpus);
+		}
+		p = *end == ',' ? end + 1 : end;
+	}
+	if (CPU_COUNT(&s->cpus) == 0) {
+		return -1;
+	}
+	s->has_cpus = 1;
+	return 0;
+}
+
+int sched_parse_nice(struct sched_opts *s, const char *n)
+{
+	long v;
+
+	if (parse_long(n, -20, 19, &v) < 0) {
+		return -1;
+	}
+	s->nice = v;
+	s->has_nice = 1;
+	return 0;
+}
+
+// Look up name[0..len) in t by name or alias; -1 if unknown
+static int lookup(const char *name, size_t len, const struct sched_name *t,
+		  size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		if ((strlen(t[i].name) == len &&
+		     strncmp(t[i].name, name, len) == 0) ||
+		    (t[i].alias && strlen(t[i].alias) == len &&
+		     strncmp(t[i].alias, name, len) == 0)) {
+			return t[i].value;
+		}
+	}
+	return -1;
+}
+
+int sched_parse_ioprio(struct sched_opts *s, const char *spec)
+{
+	size_t len = strcspn(spec, ":");
+	int class = lookup(spec, len, io_classes,
+			   sizeof(io_classes) / sizeof(io_classes[0]));
+	long level = 4;
+
+	if (class < 0) {
+		return -1;
+	}
+	// Only realtime and best-effort have levels
+	if (spec[len] == ':') {
+		if ((class != 1 && class != 2) ||
+		    parse_long(spec + len + 1, 0, 7, &level) < 0) {
+			return -1;
+		}
+	}
+	s->ioprio = class << IOPRIO_CLASS_SHIFT;
+	if (class == 1 || class == 2) {
+		s->ioprio |= level;
+	}
+	return 0;
+}
+
+int sched_parse_policy(struct sched_opts *s, const char *spec)
+{
+	size_t len = strcspn(spec, ":");
+	int policy = lookup(spec, len, policies,
+			    sizeof(policies) / sizeof(policies[0]));
+	int realtime = policy == SCHED_FIFO || policy == SCHED_RR;
+	long prio = realtime ? 1 : 0;
+
+	if (policy < 0) {
+		return -1;
+	}
+	// Real-time policies take 1..99; the others only 0
+	if (spec[len] == ':' &&
+	    parse_long(spec + len + 1, realtime ? 1 : 0, realtime ? 99 : 0,
+		       &prio) < 0) {
+		return -1;
+	}
+	s->policy = policy;
+	s->priority = prio;
+	return 0;
+}
+
+int sched_parse_timerslack(struct sched_opts *s, const char *ns)
+{
+	long v;
+
+	if (parse_long(ns, 1, LONG_MAX, &v) < 0) {
+		return -1;
+	}
+	s->timerslack = v;
+	return 0;
+}
+
+int sched_any(const struct sched_opts *s)
+{
+	return s->has_cpus || s->has_nice || s->ioprio >= 0 ||
+	    s->policy >= 0 || s->timerslack >= 0;
+}
+
+int sched_apply(const struct sched_opts *s, const char **what)
+{
+	if (s->has_cpus && sched_setaffinity(0, sizeof(s->cpus),
+					     &s->cpus) < 0) {
+		*what = "CPU affinity";
+		return -1;
+	}
+	if (s->policy >= 0) {
+		struct sched_param p = {.sched_priority = s->priority };
+		if (sched_setscheduler(0, s->policy, &p) < 0) {
+			*what = "scheduling policy";
+			return -1;
+		}
+	}
+	if (s->has_nice && setpriority(PRIO_PROCESS, 0, s->nice) < 0) {
+		*what = "nice value";
+		return -1;
+	}
+	if (s->ioprio >= 0 && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+				      s->ioprio) < 0) {
+		*what = "I/O priority";
+		return -1;
+	}
+	if (s->timerslack >= 0 && prctl(PR_SET_TIMERSLACK,
+					(unsigned long)s->timerslack) < 0) {
+		*what = "timer slack";
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef SCHED_COMMON_H
+#define SCHED_COMMON_H
+
+#include <sched.h>
+
+/*
+ * Scheduling settings suex applies to itself after the permission check
+ * and before dropping root, so the command inherits them across setuid()
+ * and exec without taskset, nice, ionice or chrt in between.  Anything
+ * not given is left as inherited.
+ */
+
+struct sched_opts {
+	int has_cpus;
+	cpu_set_t cpus;
+	int has_nice;
+	int nice;
+	int ioprio;		// encoded for ioprio_set(), -1 if not given
+	int policy;		// SCHED_*, -1 if not given
+	int priority;
+	long timerslack;	// nanoseconds, -1 if not given
+};
+
+void sched_init(struct sched_opts *s);
+
+// Parse each option's argument; -1 if it is invalid
+int sched_parse_cpus(struct sched_opts *s, const char *list);	// "0-3,8"
+int sched_parse_nice(struct sched_opts *s, const char *n);	// -20..19
+int sched_parse_ioprio(struct sched_opts *s, const char *spec);	// CLASS[:LEVEL]
+int sched_parse_policy(struct sched_opts *s, const char *spec);	// POLICY[:PRIO]
+int sched_parse_timerslack(struct sched_opts *s, const char *ns);
+
+// Check if any setting was given
+int sched_any(const struct sched_opts *s);
+
+/*
+ * Apply the settings to the calling process; on failure returns -1 with
+ * errno set and *what naming the setting.
+ */
+int sched_apply(const struct sched_opts *s, const char **what);
+
+#endif /* SCHED_COMMON_H */
@@ -213,6 +213,34 @@ run_test "Invalid command" \
     127 "No such file or directory" \
     "Try to execute non-existent command"
 
+# -----------------------------------------------------
+# Batch mode tests
+# -----------------------------------------------------
+
+cat > /tmp/batch_manifest << 'EOF'
+# comment
+root whoami
+suextest:suexgroup id -ng
+suextest sh -c 'exit 3'
+EOF
+
+run_test "Batch execution" \
+    "$SUEX_BIN --batch /tmp/batch_manifest" \
+    1 "line 4 (suextest sh): exit 3" \
+    "Run a manifest of jobs and report each exit status"
+
+run_test "Batch parallel jobs from stdin" \
+    "printf 'suextest whoami\\nroot whoami\\n' | $SUEX_BIN -j 2 --batch -" \
+    0 "suextest" \
+    "Run manifest jobs concurrently"
+
+run_test "Batch invalid user" \
+    "echo 'nonexistentuser whoami' | $SUEX_BIN --batch -" \
+    1 "line 1: Failed to find user" \
+    "Reject a manifest naming a non-existent user before running anything"
+
+rm -f /tmp/batch_manifest
+
 # -----------------------------------------------------
 # Permission tests
 # -----------------------------------------------------
@@ -245,6 +273,51 @@ run_test "Non-root execution (in suex group) as adm user" \
     0 "adm" \
     "Run suex as a user in the suex group as adm user"
 
+run_test "Non-root execution without PATH probe" \
+    "sudo -u suextest $SUEX_BIN --no-path-probe adm whoami" \
+    0 "adm" \
+    "Treat the first argument as a user without looking it up in PATH"
+
+run_test "Daemon fallback" \
+    "$SUEX_BIN --via-daemon suextest whoami" \
+    0 "suextest" \
+    "--via-daemon runs the command directly when suexd is not listening"
+
+run_test "Init mode exit status" \
+    "$SUEX_BIN --init suextest sh -c '(sleep 0.1 &); exit 7'" \
+    7 "" \
+    "--init reaps orphans and exits with the command's status"
+
+run_test "Phase trace before exec" \
+    "SUEX_TRACE=1 $SUEX_BIN root true" \
+    0 "suex: trace args=" \
+    "SUEX_TRACE writes one timing line to the given descriptor"
+
+run_test "Login environment with a large inherited one" \
+    "env \$(seq -f 'CI_VAR_%g=x' 2000) TERM=vt100 $SUEX_BIN -l suextest sh -c 'echo \$USER \$TERM \${CI_VAR_1-unset}'" \
+    0 "suextest vt100 unset" \
+    "-l keeps session variables and drops the rest"
+
+run_test "Scheduling options" \
+    "$SUEX_BIN --nice 5 --cpus 0 suextest sh -c 'echo nice=\$(nice) \$(grep Cpus_allowed_list /proc/self/status)'" \
+    0 "nice=5 Cpus_allowed_list:.0$" \
+    "--nice and --cpus apply to the command after the user switch"
+
+run_test "Cgroup outside cgroupfs" \
+    "$SUEX_BIN --cgroup /tmp/suex-not-a-cgroup suextest true" \
+    1 "Failed to create cgroup" \
+    "--cgroup refuses to create a leaf that is not on a cgroup2 mount"
+
+run_test "Resource limits" \
+    "$SUEX_BIN --rlimit nofile=256:512 suextest sh -c 'echo limits=\$(ulimit -Sn):\$(ulimit -Hn)'" \
+    0 "limits=256:512" \
+    "--rlimit sets the soft and hard limits the command starts with"
+
+run_test "Ambient capabilities" \
+    "$SUEX_BIN --caps net_bind_service suextest grep CapAmb /proc/self/status" \
+    0 "CapAmb:.0*400$" \
+    "--caps keeps the named capability across the switch to a non-root user"
+
 # -----------------------------------------------------
 # Signal handling tests
 # -----------------------------------------------------
@@ -5,159 +5,133 @@
  * to execute commands either as root or as another user.
  */
 
+#define _GNU_SOURCE
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
-#include <stdarg.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <grp.h>
 #include <libgen.h>
 #include <pwd.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "auth_common.h"
-#include "env_common.h"
+#include "caps_common.h"
+#include "cgroup_common.h"
+#include "rlimit_common.h"
+#include "daemon_common.h"
+#include "exec_common.h"
+#include "msg_common.h"
+#include "sched_common.h"
+#include "trace_common.h"
 
-// Maximum path length for shell
-#define MAX_PATH 4096
 // Default user to run as if no user is specified
 #define DEFAULT_USER "root"
 
-static char *program_name;
-
-/*
- * Build a PATH value for the target user.
- * Strips trailing slashes from home and skips ~/.local/bin when home is "/"
- * to avoid producing paths like //.local/bin.
- */
-static void build_path(char *buf, size_t buflen, const char *home, int is_root)
-{
-	char h[MAX_PATH];
-	strncpy(h, home, MAX_PATH - 1);
-	h[MAX_PATH - 1] = '\0';
-	size_t len = strlen(h);
-	while (len > 1 && h[len - 1] == '/')
-		h[--len] = '\0';
-
-	int add_local = !(len == 1 && h[0] == '/');
-
-	if (is_root) {
-		if (add_local)
-			snprintf(buf, buflen,
-				 "%s/.local/bin:/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin",
-				 h);
-		else
-			snprintf(buf, buflen,
-				 "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin");
-	} else {
-		if (add_local)
-			snprintf(buf, buflen,
-				 "%s/.local/bin:/usr/local/bin:/usr/bin:/bin",
-				 h);
-		else
-			snprintf(buf, buflen,
-				 "/usr/local/bin:/usr/bin:/bin");
-	}
-}
+// Connection to suexd while a --via-daemon job runs
+static int daemon_fd = -1;
+
+#ifndef SUEX_TINY
+// One line of a --batch manifest
+struct job {
+	int line;
+	int target;		// index into the resolved targets
+	char **argv;
+	char *buf;		// line the argv words point into
+	pid_t pid;
+	struct timespec start;
+};
+#endif
 
 /**
  * Display usage information and exit
  */
 static void usage(int exit_code)
 {
-	printf("Usage: %s [-l] [USER[:GROUP]] COMMAND [ARGUMENTS...]\n",
-	       basename(program_name));
-	printf("       %s [-l] +USER[:GROUP] COMMAND [ARGUMENTS...]\n",
-	       basename(program_name));
-	printf("       %s [-l] @USER[:GROUP] COMMAND [ARGUMENTS...]\n",
-	       basename(program_name));
-	printf("If USER is omitted and caller has permission, runs as root\n");
-	printf
-	    ("  -l  Login mode: clear environment, set HOME/USER/LOGNAME/SHELL/PATH\n");
+	const char *prog = basename(program_name);
+
+	msg_print(STDOUT_FILENO,
+		  "Usage: %s [-l] [--no-path-probe] [USER[:GROUP]] COMMAND [ARGUMENTS...]\n",
+		  prog);
+	msg_print(STDOUT_FILENO,
+		  "       %s [-l] +USER[:GROUP] COMMAND [ARGUMENTS...]\n", prog);
+	msg_print(STDOUT_FILENO,
+		  "       %s [-l] @USER[:GROUP] COMMAND [ARGUMENTS...]\n", prog);
+#ifndef SUEX_TINY
+	msg_print(STDOUT_FILENO, "       %s [-l] [-j N] --batch FILE|-\n",
+		  prog);
+#endif
+	msg_print(STDOUT_FILENO,
+		  "       %s [-l] --via-daemon [USER[:GROUP]] COMMAND [ARGUMENTS...]\n",
+		  prog);
+	msg_print(STDOUT_FILENO,
+		  "       %s [-l] --init USER[:GROUP] COMMAND [ARGUMENTS...]\n",
+		  prog);
+	msg_print(STDOUT_FILENO,
+		  "If USER is omitted and caller has permission, runs as root\n"
+		  "  -l  Login mode: clear environment, set HOME/USER/LOGNAME/SHELL/PATH\n");
+#ifndef SUEX_TINY
+	msg_print(STDOUT_FILENO,
+		  "  --batch FILE    Run every USER[:GROUP] COMMAND [ARGUMENTS...] line of\n"
+		  "                  FILE (- for stdin), reporting exit status and time\n"
+		  "  -j, --jobs N    Run up to N batch jobs at once (default 1)\n");
+#endif
+	msg_print(STDOUT_FILENO,
+		  "  --init          Stay behind as a minimal init: reap orphans, forward\n"
+		  "                  signals and exit with the command's status\n"
+		  "  --via-daemon    Have suexd run the command, if it is listening\n"
+		  "  --trace=FD      Write per-phase timings to FD before exec (or set\n"
+		  "                  %s=FD)\n"
+		  "  --no-path-probe Always read the first argument as USER[:GROUP],\n"
+		  "                  without looking for a command of that name\n",
+		  TRACE_ENV);
+	msg_print(STDOUT_FILENO,
+		  "Scheduling, cgroup, limits and capabilities, applied while root:\n"
+		  "  --cpus LIST     CPU affinity, e.g. 0-3,8\n"
+		  "  --nice N        Nice value, -20 to 19\n"
+		  "  --ioprio CLASS[:LEVEL]\n"
+		  "                  I/O class realtime, best-effort or idle, level 0-7\n"
+		  "  --sched POLICY[:PRIO]\n"
+		  "                  fifo or rr (PRIO 1-99), batch, idle or other\n"
+		  "  --timerslack NS Timer slack in nanoseconds\n"
+		  "  --cgroup PATH   Join the cgroup v2 directory PATH, creating it\n"
+		  "                  if missing\n"
+		  "  --cpu-max QUOTA[/PERIOD]\n"
+		  "                  With --cgroup, write cpu.max (microseconds or max)\n"
+		  "  --memory-max BYTES\n"
+		  "                  With --cgroup, write memory.max (K, M, G or max)\n"
+		  "  --rlimit NAME=SOFT[:HARD]\n"
+		  "                  Resource limit, e.g. nofile=1048576 (repeatable;\n"
+		  "                  defaults per user from " SUEX_LIMITS ")\n"
+		  "  --caps LIST     Capabilities the command keeps as a non-root\n"
+		  "                  user, e.g. net_bind_service,ipc_lock\n");
 	exit(exit_code);
 }
 
 /**
- * Print error message and exit
+ * Check if a string looks like a command rather than a user specification
+ * Returns 1 if it looks like a command, 0 otherwise.  When the command is
+ * found in PATH as an executable file, its full path is left in resolved
+ * so the PATH walk does not have to be repeated at exec time.
  */
-static void die(int code, const char *fmt, ...)
+static int looks_like_command(const char *arg, char *resolved, size_t len)
 {
-	va_list ap;
-	fprintf(stderr, "%s: ", basename(program_name));
-	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
-	va_end(ap);
-
-	if (errno) {
-		fprintf(stderr, ": %s", strerror(errno));
-	}
+	struct stat st;
 
-	fprintf(stderr, "\n");
-	exit(code);
-}
+	resolved[0] = '\0';
 
-/**
- * Parse a string in format [USER[:GROUP]] into user and group components
- */
-static int parse_user_group(const char *arg, char **user, char **group)
-{
-	// Sanity check
-	if (!arg || !user || !group) {
-		return -1;
-	}
-	// Initialize outputs
-	*user = NULL;
-	*group = NULL;
-
-	// Make a copy of the string since we'll modify it
-	char *str = strdup(arg);
-	if (!str) {
-		return -1;
-	}
-	// Skip @ or + prefix if present
-	char *start = str;
-	if (*start == '@' || *start == '+') {
-		start++;
-	}
-	// Check if we have a valid string after the prefix
-	if (*start == '\0') {
-		free(str);
-		return -1;
-	}
-	// Split on colon for group
-	char *colon = strchr(start, ':');
-	if (colon) {
-		*colon = '\0';	// Split the string
-
-		// Extract group if there's anything after the colon
-		if (*(colon + 1) != '\0') {
-			*group = strdup(colon + 1);
-			if (!*group) {
-				free(str);
-				return -1;
-			}
-		}
-	}
-	// Extract user
-	*user = strdup(start);
-	if (!*user) {
-		free(*group);
-		*group = NULL;
-		free(str);
-		return -1;
-	}
-	// Clean up the temporary string
-	free(str);
-	return 0;
-}
-
-/**
- * Check if a string looks like a command rather than a user specification
- * Returns 1 if it looks like a command, 0 otherwise
- */
-static int looks_like_command(const char *arg)
-{
 	// If it starts with / or . it's likely a path
 	if (arg[0] == '/' || arg[0] == '.') {
 		return 1;
@@ -174,9 +148,15 @@ static int looks_like_command(const char *arg)
 			char *dir = strtok(path_copy, ":");
 			while (dir) {
 				char full_path[MAX_PATH];
-				snprintf(full_path, MAX_PATH, "%s/%s", dir,
-					 arg);
+				msg_format(full_path, MAX_PATH, "%s/%s", dir,
+					   arg);
 				if (access(full_path, F_OK) == 0) {
+					// execvp() skips what it cannot run
+					if (stat(full_path, &st) == 0 &&
+					    S_ISREG(st.st_mode) &&
+					    (st.st_mode & 0111) &&
+					    strlen(full_path) < len)
+						strcpy(resolved, full_path);
 					free(path_copy);
 					return 1;
 				}
@@ -189,66 +169,525 @@ static int looks_like_command(const char *arg)
 	return 0;
 }
 
+// Pass a signal the client received on to the daemon's job
+static void forward_signal(int sig)
+{
+	int32_t msg = sig;
+	int saved = errno;
+
+	if (send(daemon_fd, &msg, sizeof(msg), MSG_NOSIGNAL) < 0) {
+		// The daemon is gone; its reply will never come either
+	}
+	errno = saved;
+}
+
+static int write_full(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
 /**
- * Return 1 if the basename of cmd matches a known interactive shell
+ * Hand the command to suexd, which runs it with the caller's stdio,
+ * directory, umask and environment.  Returns only when no daemon
+ * accepts the connection; otherwise exits with the job's status, or
+ * dies of the same signal.
  */
-static int is_shell(const char *cmd)
+static void via_daemon(const char *spec, int login_mode, char **cmd_argv)
 {
-	static const char *shells[] = {
-		"sh", "bash", "zsh", "fish", "dash",
-		"ksh", "ksh93", "mksh", "csh", "tcsh", "ash", NULL
+	static const int forwarded[] = {
+		SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGUSR1, SIGUSR2, SIGWINCH
 	};
-	const char *base = strrchr(cmd, '/');
-	base = base ? base + 1 : cmd;
-	for (int i = 0; shells[i]; i++) {
-		if (strcmp(base, shells[i]) == 0)
-			return 1;
+	struct sockaddr_un addr = {.sun_family = AF_UNIX };
+	uid_t real_uid = getuid();
+	struct suexd_request req = {.magic = SUEXD_MAGIC };
+	struct suexd_reply reply;
+
+	// SO_PEERCRED reports the effective uid, so connect as the caller
+	if (seteuid(real_uid) < 0) {
+		die(1, "Failed to drop privileges");
+	}
+	strcpy(addr.sun_path, SUEXD_SOCKET);
+	daemon_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (daemon_fd < 0 ||
+	    connect(daemon_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		if (daemon_fd >= 0) {
+			close(daemon_fd);
+		}
+		daemon_fd = -1;
+		if (seteuid(0) < 0) {
+			die(1, "Failed to restore privileges");
+		}
+		errno = 0;
+		return;
+	}
+	// Nothing from here on needs root
+	if (setresuid(real_uid, real_uid, real_uid) < 0) {
+		die(1, "Failed to drop privileges");
+	}
+
+	// USER[:GROUP], the arguments and the environment, NUL-separated
+	size_t len = strlen(spec) + 1;
+	for (char **a = cmd_argv; *a; a++, req.argc++)
+		len += strlen(*a) + 1;
+	for (char **e = environ; *e; e++, req.envc++)
+		len += strlen(*e) + 1;
+	if (len > SUEXD_MAX_REQUEST) {
+		errno = E2BIG;
+		die(1, "Failed to send the command to suexd");
+	}
+	char *buf = malloc(len), *p = buf;
+	if (!buf) {
+		die(1, "Memory allocation failed");
+	}
+	p = stpcpy(p, spec) + 1;
+	for (char **a = cmd_argv; *a; a++)
+		p = stpcpy(p, *a) + 1;
+	for (char **e = environ; *e; e++)
+		p = stpcpy(p, *e) + 1;
+	req.len = len;
+	req.flags = login_mode ? SUEXD_LOGIN : 0;
+	req.umask = umask(0);
+	umask(req.umask);
+
+	// stdin, stdout and stderr (/dev/null if closed) and the directory
+	int fds[SUEXD_NFDS];
+	for (int i = 0; i < SUEXD_NFDS - 1; i++) {
+		fds[i] = fcntl(i, F_GETFD) < 0 ? open("/dev/null", O_RDWR) : i;
+	}
+	fds[SUEXD_NFDS - 1] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	for (int i = 0; i < SUEXD_NFDS; i++) {
+		if (fds[i] < 0) {
+			die(1, "Failed to open the descriptors to pass");
+		}
+	}
+
+	char control[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = {.iov_base = &req,.iov_len = sizeof(req) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+	struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+	// A refused caller finds the reply waiting even if sending failed
+	int send_error = 0;
+	if (sendmsg(daemon_fd, &msg, MSG_NOSIGNAL) != sizeof(req) ||
+	    write_full(daemon_fd, buf, len) < 0) {
+		send_error = errno;
+	}
+	free(buf);
+
+	for (size_t i = 0; i < sizeof(forwarded) / sizeof(forwarded[0]); i++) {
+		struct sigaction sa = {.sa_handler = forward_signal,
+			.sa_flags = SA_RESTART
+		};
+		sigaction(forwarded[i], &sa, NULL);
+	}
+
+	size_t got = 0;
+	while (got < sizeof(reply)) {
+		ssize_t n = read(daemon_fd, (char *)&reply + got,
+				 sizeof(reply) - got);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			errno = send_error;
+			die(1, "suexd closed the connection");
+		}
+		got += n;
+	}
+	if (reply.error) {
+		errno = reply.error;
+		die(1, "suexd refused the command");
+	}
+	if (WIFSIGNALED(reply.status)) {
+		int sig = WTERMSIG(reply.status);
+		signal(sig, SIG_DFL);
+		raise(sig);
+		exit(128 + sig);
+	}
+	exit(WEXITSTATUS(reply.status));
+}
+
+/**
+ * Run the command in a child and stay behind as its init: drop to the
+ * target too, forward every signal to the child, reap whatever is
+ * reparented to us, and exit with the child's status once it is gone.
+ * Signals are read from a signalfd and children reaped with waitid(), so
+ * nothing is allocated per child.
+ */
+static int init_reaper(struct acct_db *db, const struct target *t,
+		       int login_mode, char **cmd_argv, const char *cmd_path)
+{
+	sigset_t all, old;
+	struct signalfd_siginfo si;
+	siginfo_t info;
+
+	// Orphans are ours to reap even when we are not PID 1
+	prctl(PR_SET_CHILD_SUBREAPER, 1);
+	sigfillset(&all);
+	sigprocmask(SIG_BLOCK, &all, &old);
+	fflush(NULL);
+	pid_t child = fork();
+	if (child < 0) {
+		die(1, "Failed to fork");
+	}
+	if (child == 0) {
+		sigprocmask(SIG_SETMASK, &old, NULL);
+		become(db, t, login_mode, cmd_argv, cmd_path);
+	}
+
+	acct_close(db);
+	if (setgroups(1, &t->gid) < 0 || setgid(t->gid) < 0 ||
+	    setuid(t->uid) < 0) {
+		kill(child, SIGKILL);
+		die(1, "Failed to drop privileges");
+	}
+	int fd = signalfd(-1, &all, SFD_CLOEXEC);
+	if (fd < 0) {
+		kill(child, SIGKILL);
+		die(1, "Failed to create signalfd");
+	}
+	for (;;) {
+		if (read(fd, &si, sizeof(si)) != sizeof(si)) {
+			if (errno == EINTR)
+				continue;
+			die(1, "Failed to read signals");
+		}
+		if (si.ssi_signo != SIGCHLD) {
+			// Terminal signals went to the child's process group too
+			if (si.ssi_code != SI_KERNEL)
+				kill(child, si.ssi_signo);
+			continue;
+		}
+		// SIGCHLD coalesces, so drain every child that has exited
+		for (;;) {
+			info.si_pid = 0;
+			if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG) < 0 ||
+			    info.si_pid == 0)
+				break;
+			if (info.si_pid != child)
+				continue;
+			if (info.si_code == CLD_EXITED)
+				return info.si_status;
+			return 128 + info.si_status;
+		}
 	}
-	return 0;
 }
 
+#ifndef SUEX_TINY
 /**
- * Set up supplementary groups for the target user
+ * Split a manifest line into words in place.  Quoting follows sh: '...'
+ * is literal, "..." takes \" and \\, a backslash escapes the next
+ * character elsewhere, and # starts a comment.  Returns -1 on an
+ * unterminated quote.
  */
-static int setup_groups(const char *username, gid_t target_gid)
+static int split_words(char *line, char ***words, int *nwords)
 {
-	if (!username) {
-		// Just set the single group
-		if (setgroups(1, &target_gid) < 0) {
+	char *r = line, *w = line;
+	int n = 0, cap = 0;
+
+	*words = NULL;
+	for (;;) {
+		while (*r == ' ' || *r == '\t' || *r == '\r' || *r == '\n')
+			r++;
+		if (*r == '\0' || *r == '#')
+			break;
+
+		char *word = w;
+		int quote = 0;
+		while (*r && (quote || (*r != ' ' && *r != '\t' &&
+					*r != '\r' && *r != '\n'))) {
+			char c = *r++;
+			if (quote == '\'') {
+				if (c == '\'')
+					quote = 0;
+				else
+					*w++ = c;
+			} else if (quote == '"') {
+				if (c == '"')
+					quote = 0;
+				else if (c == '\\' && (*r == '"' || *r == '\\'))
+					*w++ = *r++;
+				else
+					*w++ = c;
+			} else if (c == '\'' || c == '"') {
+				quote = c;
+			} else if (c == '\\' && *r) {
+				*w++ = *r++;
+			} else {
+				*w++ = c;
+			}
+		}
+		if (quote) {
+			free(*words);
+			*words = NULL;
 			return -1;
 		}
-		return 0;
+		// w never passes r, so step over the separator first
+		if (*r)
+			r++;
+		*w++ = '\0';
+
+		if (n + 2 > cap) {
+			cap = cap ? cap * 2 : 8;
+			char **tmp = realloc(*words, cap * sizeof(char *));
+			if (!tmp) {
+				die(1, "Memory allocation failed");
+			}
+			*words = tmp;
+		}
+		(*words)[n++] = word;
+		(*words)[n] = NULL;
+	}
+	*nwords = n;
+	return 0;
+}
+
+/**
+ * Read a --batch manifest into jobs, sharing one target per USER[:GROUP]
+ */
+static int load_manifest(const char *manifest, struct job **jobs,
+			 struct target **targets, int *ntargets)
+{
+	FILE *f = strcmp(manifest, "-") == 0 ? stdin : fopen(manifest, "re");
+	char *line = NULL;
+	size_t len = 0;
+	int njobs = 0, jcap = 0, tcap = 0, lineno = 0;
+
+	if (!f) {
+		die(1, "Failed to open '%s'", manifest);
+	}
+	while (getline(&line, &len, f) >= 0) {
+		char **words;
+		int n = 0;
+
+		lineno++;
+		errno = 0;
+		if (split_words(line, &words, &n) < 0) {
+			die(1, "line %d: Unterminated quote", lineno);
+		}
+		if (n == 0) {
+			continue;
+		}
+		if (n < 2) {
+			die(1, "line %d: Expected USER[:GROUP] COMMAND", lineno);
+		}
+
+		int t;
+		for (t = 0; t < *ntargets; t++) {
+			if (strcmp((*targets)[t].spec, words[0]) == 0)
+				break;
+		}
+		if (t == *ntargets) {
+			if (t == tcap) {
+				tcap = tcap ? tcap * 2 : 8;
+				struct target *tmp = realloc(*targets,
+							     tcap *
+							     sizeof(**targets));
+				if (!tmp) {
+					die(1, "Memory allocation failed");
+				}
+				*targets = tmp;
+			}
+			struct target *nt = &(*targets)[t];
+			memset(nt, 0, sizeof(*nt));
+			nt->spec = words[0];
+			if (parse_user_group(words[0], &nt->user,
+					     &nt->group) < 0) {
+				die(1, "line %d: Invalid user '%s'", lineno,
+				    words[0]);
+			}
+			(*ntargets)++;
+		}
+
+		if (njobs == jcap) {
+			jcap = jcap ? jcap * 2 : 64;
+			struct job *tmp = realloc(*jobs, jcap * sizeof(**jobs));
+			if (!tmp) {
+				die(1, "Memory allocation failed");
+			}
+			*jobs = tmp;
+		}
+		struct job *j = &(*jobs)[njobs++];
+		memset(j, 0, sizeof(*j));
+		j->line = lineno;
+		j->target = t;
+		j->argv = words + 1;
+		j->buf = line;
+		// The words point into line, so keep it
+		line = NULL;
+		len = 0;
+	}
+	if (ferror(f)) {
+		die(1, "Failed to read '%s'", manifest);
 	}
+	free(line);
+	if (f != stdin) {
+		fclose(f);
+	}
+	return njobs;
+}
 
-	int ngroups = 0;
-	gid_t *glist = NULL;
+static double seconds_since(const struct timespec *start)
+{
+	struct timespec now;
 
-	// First call to get the number of groups
-	getgrouplist(username, target_gid, NULL, &ngroups);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+	    (now.tv_nsec - start->tv_nsec) / 1e9;
+}
 
-	if (ngroups <= 0) {
-		return -1;
+/**
+ * Run every job of a manifest, at most max_jobs at a time.  The caller is
+ * authorized and every target resolved once, before anything runs.
+ */
+static int run_batch(const char *manifest, int max_jobs, int login_mode)
+{
+	uid_t real_uid = getuid();
+	struct acct_db db;
+	struct auth_query caller = { 0 };
+	struct job *jobs = NULL;
+	struct target *targets = NULL;
+	int ntargets = 0, failed = 0;
+
+	caller.caller_uid = real_uid;
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP | ACCT_INDEX);
+	if (auth_resolve(&db, &caller) < 0) {
+		die(1, "Memory allocation failed");
 	}
-	// Allocate memory for the group list
-	glist = malloc(ngroups * sizeof(gid_t));
-	if (glist == NULL) {
-		return -1;
+	errno = 0;
+	if (!caller.caller) {
+		die(1, "Failed to get information for current user");
 	}
-	// Get the actual groups
-	if (getgrouplist(username, target_gid, glist, &ngroups) < 0) {
-		free(glist);
-		return -1;
+	if (real_uid != 0 && !caller.in_suex_group) {
+		die(1, "Permission denied: User '%s' not in '%s' group",
+		    caller.caller->pw_name, SUEX_GROUP);
+	}
+	auth_query_free(&caller);
+
+	// Only read the manifest once the caller is known to be allowed
+	int njobs = load_manifest(manifest, &jobs, &targets, &ntargets);
+	errno = 0;
+	for (int t = 0; t < ntargets; t++) {
+		char where[64] = "";
+
+		// Report the first line using this target
+		for (int i = 0; i < njobs; i++) {
+			if (jobs[i].target == t) {
+				snprintf(where, sizeof(where), "line %d: ",
+					 jobs[i].line);
+				break;
+			}
+		}
+		describe_target(&targets[t], real_uid);
+		if (auth_resolve(&db, &targets[t].q) < 0) {
+			die(1, "Memory allocation failed");
+		}
+		errno = 0;
+		resolve_ids(&targets[t], where);
 	}
-	// Set the groups
-	if (setgroups(ngroups, glist) < 0) {
-		free(glist);
-		return -1;
+
+	// Jobs must not read the manifest that was on stdin
+	int null_stdin = strcmp(manifest, "-") == 0;
+	int next = 0, running = 0;
+	while (next < njobs || running > 0) {
+		while (next < njobs && running < max_jobs) {
+			struct job *j = &jobs[next++];
+
+			fflush(NULL);
+			clock_gettime(CLOCK_MONOTONIC, &j->start);
+			j->pid = fork();
+			if (j->pid == 0) {
+				if (null_stdin) {
+					int fd = open("/dev/null", O_RDONLY);
+					if (fd >= 0) {
+						dup2(fd, STDIN_FILENO);
+						close(fd);
+					}
+				}
+				become(&db, &targets[j->target], login_mode,
+				       j->argv, NULL);
+			}
+			if (j->pid < 0) {
+				fprintf(stderr, "%s: line %d (%s): %s\n",
+					basename(program_name), j->line,
+					targets[j->target].spec,
+					strerror(errno));
+				failed++;
+				continue;
+			}
+			running++;
+		}
+		if (running == 0) {
+			continue;
+		}
+
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			die(1, "Failed to wait for jobs");
+		}
+		for (int i = 0; i < next; i++) {
+			struct job *j = &jobs[i];
+			if (j->pid != pid)
+				continue;
+			double secs = seconds_since(&j->start);
+			if (WIFEXITED(status)) {
+				fprintf(stderr,
+					"%s: line %d (%s %s): exit %d, %.3fs\n",
+					basename(program_name), j->line,
+					targets[j->target].spec, j->argv[0],
+					WEXITSTATUS(status), secs);
+				failed += WEXITSTATUS(status) != 0;
+			} else {
+				fprintf(stderr,
+					"%s: line %d (%s %s): signal %d, %.3fs\n",
+					basename(program_name), j->line,
+					targets[j->target].spec, j->argv[0],
+					WTERMSIG(status), secs);
+				failed++;
+			}
+			j->pid = 0;
+			running--;
+			break;
+		}
 	}
 
-	free(glist);
-	return 0;
+	for (int t = 0; t < ntargets; t++) {
+		auth_query_free(&targets[t].q);
+		free(targets[t].user);
+		free(targets[t].group);
+	}
+	for (int i = 0; i < njobs; i++) {
+		free(jobs[i].argv - 1);
+		free(jobs[i].buf);
+	}
+	free(targets);
+	free(jobs);
+	acct_close(&db);
+	return failed ? 1 : 0;
 }
 
+#endif /* SUEX_TINY */
+
 int main(int argc, char *argv[])
 {
 	char *user = NULL, *group = NULL;
@@ -256,50 +695,181 @@ int main(int argc, char *argv[])
 	int cmd_index = 1;
 	char *end;
 	int login_mode = 0;
+#ifndef SUEX_TINY
+	const char *batch = NULL;
+#endif
+	int max_jobs = 0;
+	int path_probe = 1;
+	int use_daemon = 0;
+	int init_mode = 0;
+	char cmd_path[MAX_PATH];
 
 	uid_t real_uid = getuid();
 	uid_t effective_uid = geteuid();
-	gid_t target_gid = getgid();
-	uid_t target_uid;
 
-	struct passwd *pw = NULL;
 	struct passwd *real_pw = NULL;
+	struct acct_db db;
+	struct target t = { 0 };
+	struct sched_opts sched;
+	struct cgroup_opts cgroup;
+	struct rlimit_opts rlim;
+	int line;
+	const char *what;
+
+	static const struct option long_options[] = {
+		{"login", no_argument, NULL, 'l'},
+#ifndef SUEX_TINY
+		{"batch", required_argument, NULL, 'b'},
+		{"jobs", required_argument, NULL, 'j'},
+#endif
+		{"no-path-probe", no_argument, NULL, 'P'},
+		{"via-daemon", no_argument, NULL, 'D'},
+		{"init", no_argument, NULL, 'I'},
+		{"trace", required_argument, NULL, 'T'},
+		{"cpus", required_argument, NULL, 'C'},
+		{"nice", required_argument, NULL, 'N'},
+		{"ioprio", required_argument, NULL, 'O'},
+		{"sched", required_argument, NULL, 'S'},
+		{"timerslack", required_argument, NULL, 'L'},
+		{"cgroup", required_argument, NULL, 'G'},
+		{"cpu-max", required_argument, NULL, 'Q'},
+		{"memory-max", required_argument, NULL, 'M'},
+		{"rlimit", required_argument, NULL, 'R'},
+		{"caps", required_argument, NULL, 'K'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
 
 	program_name = argv[0];
+	trace_enable(getenv(TRACE_ENV));
+	sched_init(&sched);
+	cgroup_init(&cgroup);
+	rlimit_init(&rlim);
 
 	// Check if we have enough arguments
 	if (argc < 2) {
 		usage(1);
 	}
-	// Check for -l (login mode) flag
-	if (argc >= 2 && strcmp(argv[1], "-l") == 0) {
-		login_mode = 1;
-		argv++;
-		argc--;
-		if (argc < 2) {
+	// Options end at the first USER or COMMAND
+	int opt;
+	while ((opt = getopt_long(argc, argv, "+lj:h", long_options,
+				  NULL)) != -1) {
+		switch (opt) {
+		case 'l':
+			login_mode = 1;
+			break;
+#ifndef SUEX_TINY
+		case 'b':
+			batch = optarg;
+			break;
+#endif
+		case 'j':
+			max_jobs = strtol(optarg, &end, 10);
+			if (*end != '\0' || max_jobs < 1) {
+				die(1, "Invalid job count '%s'", optarg);
+			}
+			break;
+		case 'P':
+			path_probe = 0;
+			break;
+		case 'D':
+			use_daemon = 1;
+			break;
+		case 'I':
+			init_mode = 1;
+			break;
+		case 'T':
+			trace_enable(optarg);
+			break;
+		case 'C':
+			if (sched_parse_cpus(&sched, optarg) < 0) {
+				die(1, "Invalid CPU list '%s'", optarg);
+			}
+			break;
+		case 'N':
+			if (sched_parse_nice(&sched, optarg) < 0) {
+				die(1, "Invalid nice value '%s'", optarg);
+			}
+			break;
+		case 'O':
+			if (sched_parse_ioprio(&sched, optarg) < 0) {
+				die(1, "Invalid I/O priority '%s'", optarg);
+			}
+			break;
+		case 'S':
+			if (sched_parse_policy(&sched, optarg) < 0) {
+				die(1, "Invalid scheduling policy '%s'", optarg);
+			}
+			break;
+		case 'L':
+			if (sched_parse_timerslack(&sched, optarg) < 0) {
+				die(1, "Invalid timer slack '%s'", optarg);
+			}
+			break;
+		case 'G':
+			cgroup.path = optarg;
+			break;
+		case 'Q':
+			if (cgroup_parse_cpu_max(&cgroup, optarg) < 0) {
+				die(1, "Invalid cpu.max '%s'", optarg);
+			}
+			break;
+		case 'M':
+			if (cgroup_parse_memory_max(&cgroup, optarg) < 0) {
+				die(1, "Invalid memory.max '%s'", optarg);
+			}
+			break;
+		case 'R':
+			if (rlimit_parse(&rlim, optarg) < 0) {
+				die(1, "Invalid resource limit '%s'", optarg);
+			}
+			break;
+		case 'K':
+			if (caps_parse(optarg, &t.caps) < 0) {
+				die(1, "Invalid capabilities '%s'", optarg);
+			}
+			break;
+		case 'h':
+			usage(0);
+			break;
+		default:
+			usage(1);
+		}
+	}
+#ifndef SUEX_TINY
+	if (batch) {
+		if (optind != argc || use_daemon || init_mode ||
+		    sched_any(&sched) || cgroup.path || rlimit_any(&rlim) ||
+		    t.caps) {
 			usage(1);
 		}
+		return run_batch(batch, max_jobs ? max_jobs : 1, login_mode);
 	}
-	// Check if we have permission to use suex
-	int is_root = (real_uid == 0);
-	int in_suex_group = user_in_suex_group();
-
-	// Get real user info
-	real_pw = getpwuid(real_uid);
-	if (!real_pw) {
-		die(1, "Failed to get information for current user");
+#endif
+	// suexd runs commands with its own settings; limits need a cgroup
+	if (max_jobs || (use_daemon && (init_mode || sched_any(&sched) ||
+					cgroup.path || rlimit_any(&rlim) ||
+					t.caps)) ||
+	    ((cgroup.has_cpu_max || cgroup.has_memory_max) && !cgroup.path)) {
+		usage(1);
 	}
-	// Non-root user must be in suex group
-	if (!is_root && !in_suex_group) {
-		die(1, "Permission denied: User '%s' not in '%s' group",
-		    real_pw->pw_name, SUEX_GROUP);
+	// Leave argv[1] on the first argument after the options
+	argv += optind - 1;
+	argc -= optind - 1;
+	if (argc < 2) {
+		usage(1);
 	}
+	trace_mark("args");
+	int is_root = (real_uid == 0);
+
 	// Check if first argument is a user specification
 	char *first_arg = argv[1];
 	int first_arg_is_user = 0;
 
 	// For non-root users, check if the first argument looks like a command
-	if (!is_root && looks_like_command(first_arg)) {
+	cmd_path[0] = '\0';
+	if (!is_root && path_probe &&
+	    looks_like_command(first_arg, cmd_path, sizeof(cmd_path))) {
 		// First argument is a command, default to root
 		user = strdup(DEFAULT_USER);
 		if (!user) {
@@ -327,132 +897,69 @@ int main(int argc, char *argv[])
 
 	// Set command arguments
 	cmd_argv = &argv[cmd_index];
+	trace_mark("probe");
+
+	// Falls through to running the command here if suexd is not there
+	if (use_daemon && cmd_argv[0]) {
+		via_daemon(cmd_index == 2 ? first_arg : DEFAULT_USER, login_mode,
+			   cmd_argv);
+	}
 
+	// Describe the target so caller, target and groups resolve together
+	t.user = user;
+	t.group = group;
+	describe_target(&t, real_uid);
+	// Use the prebuilt index when current, else scan the files once
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP | ACCT_INDEX);
+	trace_mark(db.index ? "index" : "open");
+	if (auth_resolve(&db, &t.q) < 0) {
+		die(1, "Memory allocation failed");
+	}
+	trace_mark("resolve");
+	// Failed probes above leave errno set; it means nothing to die()
+	errno = 0;
+	// Get real user info
+	real_pw = t.q.caller;
+	if (!real_pw) {
+		die(1, "Failed to get information for current user");
+	}
+	// Non-root user must be in suex group
+	if (!is_root && !t.q.in_suex_group) {
+		die(1, "Permission denied: User '%s' not in '%s' group",
+		    real_pw->pw_name, SUEX_GROUP);
+	}
 	// Make sure we have a command to execute
 	if (cmd_argv[0] == NULL) {
 		free(user);
 		free(group);
 		usage(1);
 	}
-	// Handle target user
-	if (user && user[0] != '\0') {
-		// Check if user is numeric UID
-		char *endptr;
-		long uid_val = strtol(user, &endptr, 10);
-		if (*endptr == '\0') {
-			// Numeric user ID provided
-			target_uid = uid_val;
-		} else {
-			// Username provided
-			pw = getpwnam(user);
-			if (pw == NULL) {
-				die(1, "Failed to find user '%s'", user);
-			}
-			target_uid = pw->pw_uid;
-			target_gid = pw->pw_gid;
-		}
-	} else {
-		// No user specified, default to root
-		target_uid = 0;
-		pw = getpwuid(0);
-		if (pw) {
-			target_gid = pw->pw_gid;
-		}
+	resolve_ids(&t, "");
+	// Still root here; the command inherits these across setuid and exec.
+	// The cgroup comes first, as its cpuset limits the affinity allowed.
+	if (cgroup_apply(&cgroup, &what) < 0) {
+		die(1, "Failed to %s cgroup '%s'", what, cgroup.path);
 	}
-
-	// Get password entry for target user if not already fetched
-	if (pw == NULL) {
-		pw = getpwuid(target_uid);
+	if (sched_apply(&sched, &what) < 0) {
+		die(1, "Failed to set %s", what);
 	}
-	// Handle target group if specified
-	if (group && group[0] != '\0') {
-		// Check if group is numeric GID
-		char *endptr;
-		long gid_val = strtol(group, &endptr, 10);
-		if (*endptr == '\0') {
-			// Numeric group ID provided
-			target_gid = gid_val;
-		} else {
-			// Group name provided
-			struct group *gr = getgrnam(group);
-			if (gr == NULL) {
-				die(1, "Failed to find group '%s'", group);
-			}
-			target_gid = gr->gr_gid;
+	// Hard limits can only be raised before setuid(); options win
+	if (rlimit_load(&rlim, SUEX_LIMITS,
+			t.q.target ? t.q.target->pw_name : NULL, t.uid,
+			&line) < 0) {
+		if (line) {
+			die(1, "%s:%d: Invalid resource limit", SUEX_LIMITS,
+			    line);
 		}
+		die(1, "Failed to read %s", SUEX_LIMITS);
 	}
-	// Set supplementary groups
-	if (pw) {
-		if (setup_groups(pw->pw_name, target_gid) < 0) {
-			die(1,
-			    "Failed to set supplemental groups for user '%s'",
-			    pw->pw_name);
-		}
-		// Set environment variables
-		setenv("USER", pw->pw_name, 1);
-		setenv("HOME", pw->pw_dir, 1);
-	} else {
-		if (setup_groups(NULL, target_gid) < 0) {
-			die(1, "Failed to set supplemental groups for GID %d",
-			    target_gid);
-		}
-		// Set environment variables
-		setenv("USER", target_uid == 0 ? "root" : "nobody", 1);
-		setenv("HOME", target_uid == 0 ? "/root" : "/", 1);
-	}
-
-	// Clean up
-	free(user);
-	free(group);
-
-	// Set the new GID and UID
-	if (setgid(target_gid) < 0) {
-		die(1, "Failed to set GID to %d", target_gid);
-	}
-
-	if (setuid(target_uid) < 0) {
-		die(1, "Failed to set UID to %d", target_uid);
-	}
-	// Save session/terminal variables before potential clearenv
-	char *saved_session[32];
-	int n_saved = 0;
-	for (int i = 0; session_vars[i]; i++, n_saved++) {
-		char *val = getenv(session_vars[i]);
-		saved_session[i] = val ? strdup(val) : NULL;
-	}
-
-	// Login mode: clear environment and set up a clean login environment
-	if (login_mode) {
-		clearenv();
-		if (pw) {
-			setenv("HOME", pw->pw_dir, 1);
-			setenv("USER", pw->pw_name, 1);
-			setenv("LOGNAME", pw->pw_name, 1);
-			setenv("SHELL", is_shell(cmd_argv[0]) ? cmd_argv[0] : pw->pw_shell, 1);
-			char mail[MAX_PATH];
-			snprintf(mail, MAX_PATH, "/var/mail/%s", pw->pw_name);
-			setenv("MAIL", mail, 1);
-			char path_buf[MAX_PATH];
-			build_path(path_buf, MAX_PATH, pw->pw_dir,
-				   target_uid == 0);
-			setenv("PATH", path_buf, 1);
-		} else {
-			const char *sys_path = (target_uid == 0)
-			    ?
-			    "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin"
-			    : "/usr/local/bin:/usr/bin:/bin";
-			setenv("PATH", sys_path, 1);
-		}
-		for (int i = 0; i < n_saved; i++) {
-			if (saved_session[i]) {
-				setenv(session_vars[i], saved_session[i], 1);
-				free(saved_session[i]);
-			}
-		}
+	if (rlimit_apply(&rlim, &what) < 0) {
+		die(1, "Failed to set %s limit", what);
+	}
+	if (init_mode) {
+		return init_reaper(&db, &t, login_mode, cmd_argv, cmd_path);
 	}
-	// Execute the command
-	execvp(cmd_argv[0], cmd_argv);
-	die(127, "Failed to execute '%s'", cmd_argv[0]);
+	become(&db, &t, login_mode, cmd_argv, cmd_path);
 
 	return 1;		// Should never reach here
 }
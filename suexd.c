@@ -0,0 +1,504 @@
+/**
+ * suexd.c - Launch suex commands from a long-running root process
+ *
+ * suexd keeps an in-memory index of the account files, listens on a
+ * local socket and runs each request from `suex --via-daemon` in a child
+ * that switches user and executes the command exactly as suex would, so
+ * busy job runners skip the setuid exec and account lookup of every
+ * launch.  Callers are identified with SO_PEERCRED and held to the
+ * same rule as suex: root, or a member of the suex group.
+ */
+
+#define _GNU_SOURCE
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "acct_index.h"
+#include "acct_table.h"
+#include "auth_common.h"
+#include "daemon_common.h"
+#include "exec_common.h"
+
+// Connections served at once, running jobs included
+#define MAX_CLIENTS 1024
+
+// One connection: a request being read, then the job it started
+struct client {
+	int fd;			// -1 once the client has gone
+	struct ucred cred;
+	struct suexd_request req;
+	size_t got;		// bytes of req and its strings read so far
+	char *buf;		// the strings
+	int fds[SUEXD_NFDS];	// stdin, stdout, stderr, cwd
+	int nfds;
+	pid_t pid;		// the job, once started
+	unsigned char sig[sizeof(int32_t)];	// partial signal message
+	size_t sig_got;
+};
+
+static struct client clients[MAX_CLIENTS];
+static int nclients;
+static struct acct_db db;
+
+// Identity of the files db was loaded from, to notice edits
+static const char *const watched[] = { ACCT_PASSWD_FILE, ACCT_GROUP_FILE };
+static struct stat stamps[sizeof(watched) / sizeof(watched[0])];
+
+static void usage(int exit_code)
+{
+	printf("Usage: %s [-s SOCKET]\n", basename(program_name));
+	printf("Run commands for `suex --via-daemon` without a setuid exec\n");
+	printf("  -s SOCKET  Listen on SOCKET instead of %s\n", SUEXD_SOCKET);
+	exit(exit_code);
+}
+
+static int same_file(const struct stat *a, const struct stat *b)
+{
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+	    a->st_size == b->st_size &&
+	    a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+	    a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+/**
+ * (Re)load the account data if passwd or group changed since it was last
+ * loaded.  A missing file is recorded as all zeros.
+ */
+static void refresh_db(int force)
+{
+	struct stat now[sizeof(watched) / sizeof(watched[0])];
+	int changed = force;
+
+	for (size_t i = 0; i < sizeof(watched) / sizeof(watched[0]); i++) {
+		if (stat(watched[i], &now[i]) < 0) {
+			memset(&now[i], 0, sizeof(now[i]));
+		}
+		if (!same_file(&now[i], &stamps[i])) {
+			changed = 1;
+		}
+	}
+	if (!changed) {
+		return;
+	}
+	acct_close(&db);
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP);
+	memcpy(stamps, now, sizeof(stamps));
+#ifndef ACCT_NSS
+	// Index what was just mapped so every lookup is a hash probe
+	struct acct_table t;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (acct_table_load(&t, &db, ncpu > 0 ? ncpu : 1) == 0) {
+		db.index = acct_index_build(&t, &db);
+		acct_table_free(&t);
+	}
+#endif
+}
+
+static void reply(struct client *c, int error, int status)
+{
+	struct suexd_reply r = {.error = error,.status = status };
+
+	if (c->fd >= 0 &&
+	    send(c->fd, &r, sizeof(r), MSG_NOSIGNAL) != sizeof(r)) {
+		// The client is gone; nobody is left to tell
+	}
+}
+
+static void drop_client(struct client *c)
+{
+	if (c->fd >= 0) {
+		close(c->fd);
+	}
+	for (int i = 0; i < c->nfds; i++) {
+		close(c->fds[i]);
+	}
+	free(c->buf);
+	*c = clients[--nclients];
+}
+
+/**
+ * Accept a connection and check the caller before reading anything from
+ * it; refused callers get EACCES.
+ */
+static void accept_client(int listen_fd)
+{
+	struct auth_query q = { 0 };
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+	if (fd < 0) {
+		return;
+	}
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+		close(fd);
+		return;
+	}
+
+	refresh_db(0);
+	q.caller_uid = cred.uid;
+	if (auth_resolve(&db, &q) < 0) {
+		close(fd);
+		return;
+	}
+	int allowed = cred.uid == 0 || (q.caller && q.in_suex_group);
+	auth_query_free(&q);
+
+	struct client *c = &clients[nclients++];
+	memset(c, 0, sizeof(*c));
+	c->fd = fd;
+	c->cred = cred;
+	if (!allowed) {
+		reply(c, EACCES, 0);
+		drop_client(c);
+	}
+}
+
+/**
+ * Check that the string block holds exactly the strings the header
+ * announced, each NUL-terminated.
+ */
+static int valid_strings(const struct client *c)
+{
+	uint32_t want = 1 + c->req.argc + c->req.envc, n = 0;
+
+	if (c->req.len == 0 || c->buf[c->req.len - 1] != '\0') {
+		return 0;
+	}
+	for (uint32_t i = 0; i < c->req.len; i++) {
+		n += c->buf[i] == '\0';
+	}
+	return n == want;
+}
+
+/**
+ * Become the job: take over the client's stdio, directory, umask and
+ * environment, then switch user and exec as suex does.
+ */
+static void run_job(struct client *c, const sigset_t *mask)
+{
+	char **argv = calloc(c->req.argc + 1, sizeof(char *));
+	char **envp = calloc(c->req.envc + 1, sizeof(char *));
+	char *p = c->buf;
+	struct target t = { 0 };
+
+	for (int i = 0; i < SUEXD_NFDS - 1; i++) {
+		if (dup2(c->fds[i], i) < 0) {
+			_exit(1);
+		}
+	}
+	for (int i = 1; i < NSIG; i++) {
+		signal(i, SIG_DFL);
+	}
+	sigprocmask(SIG_SETMASK, mask, NULL);
+	if (!argv || !envp) {
+		die(1, "Memory allocation failed");
+	}
+	if (setsid() < 0 || fchdir(c->fds[SUEXD_NFDS - 1]) < 0) {
+		die(1, "Failed to set up the job");
+	}
+	umask(c->req.umask & 0777);
+
+	t.spec = p;
+	p += strlen(p) + 1;
+	for (uint32_t i = 0; i < c->req.argc; i++, p += strlen(p) + 1) {
+		argv[i] = p;
+	}
+	for (uint32_t i = 0; i < c->req.envc; i++, p += strlen(p) + 1) {
+		envp[i] = p;
+	}
+	environ = envp;
+
+	if (parse_user_group(t.spec, &t.user, &t.group) < 0) {
+		die(1, "Invalid user '%s'", t.spec);
+	}
+	describe_target(&t, c->cred.uid);
+	if (auth_resolve(&db, &t.q) < 0) {
+		die(1, "Memory allocation failed");
+	}
+	// resolve_ids() defaults to the caller's gid, as in suex
+	if (setgid(c->cred.gid) < 0) {
+		die(1, "Failed to set GID to %d", c->cred.gid);
+	}
+	errno = 0;
+	resolve_ids(&t, "");
+	become(&db, &t, c->req.flags & SUEXD_LOGIN, argv, NULL);
+}
+
+static void start_job(struct client *c, const sigset_t *mask)
+{
+	if (!valid_strings(c) || c->req.argc == 0) {
+		reply(c, EINVAL, 0);
+		drop_client(c);
+		return;
+	}
+	c->pid = fork();
+	if (c->pid == 0) {
+		run_job(c, mask);
+	}
+	if (c->pid < 0) {
+		reply(c, errno, 0);
+		drop_client(c);
+		return;
+	}
+	// The job has its own copies now
+	for (int i = 0; i < c->nfds; i++) {
+		close(c->fds[i]);
+	}
+	c->nfds = 0;
+	free(c->buf);
+	c->buf = NULL;
+}
+
+// Read the header, collecting the passed descriptors on the way
+static ssize_t read_header(struct client *c)
+{
+	char control[CMSG_SPACE(SUEXD_NFDS * sizeof(int))];
+	struct iovec iov = {
+		.iov_base = (char *)&c->req + c->got,
+		.iov_len = sizeof(c->req) - c->got,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+
+	ssize_t n = recvmsg(c->fd, &msg, MSG_CMSG_CLOEXEC);
+	if (n <= 0) {
+		return n;
+	}
+	for (struct cmsghdr * cm = CMSG_FIRSTHDR(&msg); cm;
+	     cm = CMSG_NXTHDR(&msg, cm)) {
+		if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+		int *fds = (int *)CMSG_DATA(cm);
+		size_t nfds = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < nfds; i++) {
+			if (c->nfds < SUEXD_NFDS) {
+				c->fds[c->nfds++] = fds[i];
+			} else {
+				close(fds[i]);
+			}
+		}
+	}
+	if (msg.msg_flags & MSG_CTRUNC) {
+		errno = EBADMSG;
+		return -1;
+	}
+	return n;
+}
+
+/**
+ * Handle a readable connection: more of the request, or a signal for the
+ * running job.
+ */
+static void read_client(struct client *c, const sigset_t *mask)
+{
+	ssize_t n;
+
+	if (c->pid > 0) {
+		n = read(c->fd, c->sig + c->sig_got, sizeof(c->sig) - c->sig_got);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+			// Like a terminal hangup; the reply is still reaped
+			kill(c->pid, SIGHUP);
+			close(c->fd);
+			c->fd = -1;
+			return;
+		}
+		if (n > 0 && (c->sig_got += n) == sizeof(c->sig)) {
+			int32_t sig;
+			memcpy(&sig, c->sig, sizeof(sig));
+			if (sig > 0 && sig < NSIG) {
+				kill(c->pid, sig);
+			}
+			c->sig_got = 0;
+		}
+		return;
+	}
+
+	if (c->got < sizeof(c->req)) {
+		n = read_header(c);
+	} else {
+		size_t off = c->got - sizeof(c->req);
+		n = read(c->fd, c->buf + off, c->req.len - off);
+	}
+	if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	}
+	if (n <= 0) {
+		drop_client(c);
+		return;
+	}
+	c->got += n;
+	if (c->got == sizeof(c->req)) {
+		if (c->req.magic != SUEXD_MAGIC || c->nfds != SUEXD_NFDS ||
+		    c->req.len == 0 || c->req.len > SUEXD_MAX_REQUEST) {
+			reply(c, EINVAL, 0);
+			drop_client(c);
+			return;
+		}
+		c->buf = malloc(c->req.len);
+		if (!c->buf) {
+			reply(c, ENOMEM, 0);
+			drop_client(c);
+			return;
+		}
+	}
+	if (c->got == sizeof(c->req) + c->req.len) {
+		start_job(c, mask);
+	}
+}
+
+// Send every finished job's status to its client
+static void reap_jobs(void)
+{
+	int status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		for (int i = 0; i < nclients; i++) {
+			if (clients[i].pid == pid) {
+				reply(&clients[i], 0, status);
+				drop_client(&clients[i]);
+				break;
+			}
+		}
+	}
+}
+
+static int listen_on(const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX };
+	struct stat st;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		die(1, "Invalid socket path '%s'", path);
+	}
+	strcpy(addr.sun_path, path);
+
+	// Replace a socket left behind by an earlier run, nothing else
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			errno = EEXIST;
+			die(1, "Refusing to replace '%s'", path);
+		}
+		unlink(path);
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		die(1, "Failed to bind '%s'", path);
+	}
+	// Anyone may connect; SO_PEERCRED decides who is served
+	if (chmod(path, 0666) < 0 || listen(fd, SOMAXCONN) < 0) {
+		die(1, "Failed to listen on '%s'", path);
+	}
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = SUEXD_SOCKET;
+	sigset_t mask, old_mask;
+	struct pollfd pfds[2 + MAX_CLIENTS];
+	int opt;
+
+	program_name = argv[0];
+	while ((opt = getopt(argc, argv, "s:h")) != -1) {
+		switch (opt) {
+		case 's':
+			path = optarg;
+			break;
+		case 'h':
+			usage(0);
+			break;
+		default:
+			usage(1);
+		}
+	}
+	if (optind != argc) {
+		usage(1);
+	}
+	if (geteuid() != 0 || getuid() != 0) {
+		die(1, "Must be run as root");
+	}
+	// Keep passed descriptors from landing on 0-2, where dup2() is a no-op
+	int null_fd;
+	while ((null_fd = open("/dev/null", O_RDWR)) >= 0 && null_fd <= 2)
+		;
+	if (null_fd > 2) {
+		close(null_fd);
+	}
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGHUP);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, &old_mask);
+	int sig_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if (sig_fd < 0) {
+		die(1, "Failed to create signalfd");
+	}
+	refresh_db(1);
+	int listen_fd = listen_on(path);
+
+	for (;;) {
+		int n = 0;
+
+		pfds[n++] = (struct pollfd) {.fd = sig_fd,.events = POLLIN };
+		pfds[n++] = (struct pollfd) {
+			.fd = nclients < MAX_CLIENTS ? listen_fd : -1,
+			.events = POLLIN
+		};
+		for (int i = 0; i < nclients; i++) {
+			pfds[n++] = (struct pollfd) {
+				.fd = clients[i].fd,.events = POLLIN
+			};
+		}
+		if (poll(pfds, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			die(1, "poll");
+		}
+
+		if (pfds[0].revents & POLLIN) {
+			struct signalfd_siginfo si;
+			while (read(sig_fd, &si, sizeof(si)) == sizeof(si)) {
+				if (si.ssi_signo == SIGHUP) {
+					refresh_db(1);
+				} else if (si.ssi_signo != SIGCHLD) {
+					unlink(path);
+					return 0;
+				}
+			}
+			reap_jobs();
+		}
+		// Walk back so drop_client() only moves already visited slots
+		for (int i = n - 1; i >= 2; i--) {
+			if (pfds[i].revents && i - 2 < nclients &&
+			    clients[i - 2].fd == pfds[i].fd) {
+				read_client(&clients[i - 2], &old_mask);
+			}
+		}
+		if (pfds[1].revents & POLLIN) {
+			accept_client(listen_fd);
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef TABLE_COMMON_H
+#define TABLE_COMMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Lookups in the tables gen-tables compiles from the files in tables/.
+ * Each table holds exact names, found through a perfect hash, and NAME*
+ * prefix rules, tried in order when no name matches.  The hash is
+ * hash-and-displace: one pass over the name picks a bucket, and that
+ * bucket's displacement moves its names to free slots, so the slots stay
+ * within twice the name count however large the table.  A bit set of the
+ * first two bytes of every name and prefix turns most misses into one
+ * test.  The generator includes this file too, so both agree on the
+ * hash.
+ */
+
+// Storage of the generated tables, which many files include unused
+#define TABLE_DATA static const __attribute__((unused))
+
+struct table_slot {
+	uint16_t index;		// 1 + index into names, 0 for an empty slot
+	uint16_t len;
+};
+
+struct table {
+	const char *const *names;	// in file order, NULL-terminated
+	const char *const *prefixes;	// NAME* rules without the '*'
+	const struct table_slot *slots;
+	uint32_t mask;		// slot count - 1
+	uint32_t seed;
+	const uint16_t *disp;	// displacement per bucket
+	uint32_t bmask;		// bucket count - 1
+	const uint64_t *pairs;	// 128 * 128 bits
+};
+
+static inline uint32_t table_hash(const char *s, size_t len, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h ^ h >> 16;
+}
+
+// Slot of a name with hash h in a bucket displaced by d, before masking.
+// Names in one bucket share the low bits of h, so the rest decide.
+static inline uint32_t table_displace(uint32_t h, uint32_t d)
+{
+	h = (h >> 16 | h << 16) ^ d * 0x9e3779b9u;
+	h *= 0x85ebca6bu;
+	return h ^ h >> 13;
+}
+
+// Pair of the first two bytes of s; names are ASCII, so -1 for others
+static inline int table_pair(const char *s)
+{
+	const unsigned char *c = (const unsigned char *)s;
+
+	if (c[0] >= 128 || (c[0] && c[1] >= 128))
+		return -1;
+	return c[0] << 7 | (c[0] ? c[1] : 0);
+}
+
+/*
+ * Whether s could start with a name or prefix of t.  A one-letter name
+ * or prefix admits any second byte, so s need not end at the name.
+ */
+static inline int table_maybe(const struct table *t, const char *s)
+{
+	int pair = table_pair(s);
+
+	return pair >= 0 && (t->pairs[pair / 64] >> pair % 64 & 1);
+}
+
+// Index of the name s[0..len) in t->names, or -1
+static inline int table_find(const struct table *t, const char *s, size_t len)
+{
+	uint32_t h = table_hash(s, len, t->seed);
+	const struct table_slot *slot =
+	    &t->slots[table_displace(h, t->disp[h & t->bmask]) & t->mask];
+
+	if (slot->index == 0 || slot->len != len ||
+	    memcmp(s, t->names[slot->index - 1], len) != 0)
+		return -1;
+	return slot->index - 1;
+}
+
+// Whether s[0..len) starts with one of the prefix rules of t
+static inline int table_prefixed(const struct table *t, const char *s,
+				 size_t len)
+{
+	for (const char *const *p = t->prefixes; *p; p++) {
+		size_t plen = strlen(*p);
+		if (plen <= len && memcmp(s, *p, plen) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+#endif /* TABLE_COMMON_H */
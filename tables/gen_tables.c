@@ -0,0 +1,338 @@
+/**
+ * gen_tables.c - Compile a table in tables/ into a C header
+ *
+ * Each line of the input holds a name and, for mapping tables, the values
+ * it maps to; "-" is a NULL value and # starts a comment.  A lone name
+ * ending in '*' is a prefix rule.  The header declares NAME (the names in
+ * file order), NAME_values when there are values, and NAME_table for the
+ * lookups in table_common.h, with a hash-and-displace perfect hash.
+ * The arrays are marked unused, so a header may include it for NAME_COUNT.
+ *
+ * Usage: gen-tables NAME INPUT OUTPUT
+ *
+ * Runs at build time on the build host; site tables are used by pointing
+ * the matching make variable at another file.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "table_common.h"
+
+#define MAX_ENTRIES 4096
+#define MAX_VALUES 4
+// Seeds tried per table size before doubling it
+#define MAX_SEEDS 64
+#define MAX_DISP 65536
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+struct entry {
+	char *name;
+	char *value[MAX_VALUES];
+};
+
+static struct entry names[MAX_ENTRIES];
+static char *prefixes[MAX_ENTRIES];
+static int nnames, nprefixes, nvalues = -1;
+
+static void fail(const char *input, int line, const char *msg)
+{
+	if (line)
+		fprintf(stderr, "gen-tables: %s:%d: %s\n", input, line, msg);
+	else
+		fprintf(stderr, "gen-tables: %s: %s\n", input, msg);
+	exit(1);
+}
+
+static int is_name(const char *s)
+{
+	for (; *s; s++) {
+		if (!isgraph((unsigned char)*s) || (unsigned char)*s >= 128 ||
+		    *s == '"' || *s == '\\')
+			return 0;
+	}
+	return 1;
+}
+
+static void read_table(const char *input)
+{
+	FILE *f = fopen(input, "r");
+	char buf[4096];
+	int line = 0;
+
+	if (!f)
+		fail(input, 0, strerror(errno));
+	while (fgets(buf, sizeof(buf), f)) {
+		char *words[MAX_VALUES + 1];
+		int n = 0;
+
+		line++;
+		*strchrnul(buf, '#') = '\0';
+		for (char *w = strtok(buf, " \t\r\n"); w;
+		     w = strtok(NULL, " \t\r\n")) {
+			if (n == MAX_VALUES + 1)
+				fail(input, line, "too many columns");
+			if (!is_name(w))
+				fail(input, line, "names are printable ASCII");
+			words[n++] = strdup(w);
+		}
+		if (n == 0)
+			continue;
+
+		size_t len = strlen(words[0]);
+		if (words[0][len - 1] == '*') {
+			if (n > 1)
+				fail(input, line, "prefix rules take no values");
+			words[0][len - 1] = '\0';
+			prefixes[nprefixes++] = words[0];
+			continue;
+		}
+		if (nvalues >= 0 && n - 1 != nvalues)
+			fail(input, line, "every line needs the same columns");
+		if (nnames == MAX_ENTRIES || len > UINT16_MAX)
+			fail(input, line, "table too large");
+		nvalues = n - 1;
+		for (int i = 0; i < nnames; i++) {
+			if (strcmp(names[i].name, words[0]) == 0)
+				fail(input, line, "duplicate name");
+		}
+		names[nnames].name = words[0];
+		for (int i = 1; i < n; i++)
+			names[nnames].value[i - 1] = words[i];
+		nnames++;
+	}
+	fclose(f);
+	if (nvalues < 0)
+		nvalues = 0;
+}
+
+static uint32_t hashes[MAX_ENTRIES];
+static uint32_t bucket_size[MAX_ENTRIES];
+static int order[MAX_ENTRIES];
+static uint32_t bmask;
+
+// Largest buckets first, then by bucket so each one's names are together
+static int cmp_bucket(const void *a, const void *b)
+{
+	uint32_t ba = hashes[*(const int *)a] & bmask;
+	uint32_t bb = hashes[*(const int *)b] & bmask;
+
+	if (bucket_size[ba] != bucket_size[bb])
+		return bucket_size[ba] < bucket_size[bb] ? 1 : -1;
+	return ba < bb ? -1 : ba > bb;
+}
+
+// Find a displacement for the n names keys[0..n) of one bucket that
+// puts each in a free slot of its own; -1 if there is none
+static int place_bucket(const int *keys, int n, uint32_t mask,
+			struct table_slot *slots)
+{
+	uint32_t pos[MAX_ENTRIES];
+
+	for (uint32_t d = 0; d < MAX_DISP; d++) {
+		int ok = 1;
+
+		for (int i = 0; i < n && ok; i++) {
+			pos[i] = table_displace(hashes[keys[i]], d) & mask;
+			ok = slots[pos[i]].index == 0;
+			for (int j = 0; j < i && ok; j++)
+				ok = pos[j] != pos[i];
+		}
+		if (!ok)
+			continue;
+		for (int i = 0; i < n; i++) {
+			slots[pos[i]].index = keys[i] + 1;
+			slots[pos[i]].len = strlen(names[keys[i]].name);
+		}
+		return d;
+	}
+	return -1;
+}
+
+/*
+ * Hash-and-displace: the seed spreads the names over about half as many
+ * buckets, and each bucket, largest first, gets the first displacement
+ * that puts its names in free slots.  The slots are the smallest power of
+ * two holding every name, doubled only if no seed works.
+ */
+static void find_seed(const char *input, uint32_t *mask, uint32_t *seed,
+		      uint16_t *disp, struct table_slot *slots,
+		      size_t max_slots)
+{
+	uint32_t size = 8, nbuckets = 1;
+
+	while (size < (uint32_t)nnames)
+		size *= 2;
+	while (nbuckets < (uint32_t)(nnames + 1) / 2)
+		nbuckets *= 2;
+	bmask = nbuckets - 1;
+	for (; size <= max_slots; size *= 2) {
+		for (uint32_t s = 0; s < MAX_SEEDS; s++) {
+			int ok = 1;
+
+			memset(bucket_size, 0, nbuckets * sizeof(*bucket_size));
+			for (int i = 0; i < nnames; i++) {
+				hashes[i] = table_hash(names[i].name,
+						       strlen(names[i].name), s);
+				bucket_size[hashes[i] & bmask]++;
+				order[i] = i;
+			}
+			qsort(order, nnames, sizeof(*order), cmp_bucket);
+			memset(slots, 0, size * sizeof(*slots));
+			memset(disp, 0, nbuckets * sizeof(*disp));
+			for (int i = 0; i < nnames && ok;) {
+				uint32_t b = hashes[order[i]] & bmask;
+				int d = place_bucket(&order[i], bucket_size[b],
+						     size - 1, slots);
+
+				ok = d >= 0;
+				disp[b] = d;
+				i += bucket_size[b];
+			}
+			if (ok) {
+				*mask = size - 1;
+				*seed = s;
+				return;
+			}
+		}
+	}
+	fail(input, 0, "no perfect hash found; split the table");
+}
+
+static void set_pair(uint64_t *pairs, int c0, int c1)
+{
+	int pair = c0 << 7 | c1;
+
+	pairs[pair / 64] |= 1ULL << pair % 64;
+}
+
+static void write_string(FILE *out, const char *s)
+{
+	if (s)
+		fprintf(out, "\"%s\"", s);
+	else
+		fprintf(out, "NULL");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct table_slot slots[2 * MAX_ENTRIES];
+	static uint16_t disp[MAX_ENTRIES];
+	uint64_t pairs[128 * 128 / 64] = { 0 };
+	uint32_t mask, seed;
+
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s NAME INPUT OUTPUT\n", argv[0]);
+		return 1;
+	}
+	const char *name = argv[1], *input = argv[2], *output = argv[3];
+
+	read_table(input);
+	find_seed(input, &mask, &seed, disp, slots, ARRAY_SIZE(slots));
+	for (int i = 0; i < nnames; i++) {
+		const char *n = names[i].name;
+		if (!n[1]) {
+			for (int c = 0; c < 128; c++)
+				set_pair(pairs, n[0], c);
+		} else {
+			set_pair(pairs, n[0], n[1]);
+		}
+	}
+	for (int i = 0; i < nprefixes; i++) {
+		const char *p = prefixes[i];
+		for (int c0 = 0; c0 < 128; c0++) {
+			for (int c1 = 0; c1 < 128; c1++) {
+				if ((!p[0] || p[0] == c0) &&
+				    (!p[0] || !p[1] || p[1] == c1))
+					set_pair(pairs, c0, c1);
+			}
+		}
+	}
+
+	char tmp[4096];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", output);
+	FILE *out = fopen(tmp, "w");
+	if (!out)
+		fail(tmp, 0, strerror(errno));
+
+	char guard[256];
+	size_t g = 0;
+	for (const char *c = name; *c && g < sizeof(guard) - 1; c++)
+		guard[g++] = toupper((unsigned char)*c);
+	guard[g] = '\0';
+
+	fprintf(out, "/* Generated by gen-tables from %s; do not edit */\n",
+		input);
+	fprintf(out, "#ifndef GEN_%s_H\n#define GEN_%s_H\n\n", guard, guard);
+	fprintf(out, "#include \"table_common.h\"\n\n");
+	fprintf(out, "#define %s_COUNT %d\n\n", guard, nnames);
+
+	fprintf(out, "TABLE_DATA char *const %s[] = {\n", name);
+	for (int i = 0; i < nnames; i++)
+		fprintf(out, "\t\"%s\",\n", names[i].name);
+	fprintf(out, "\tNULL\n};\n\n");
+
+	if (nvalues > 0) {
+		fprintf(out, "TABLE_DATA char *const %s_values[][%d] = {\n",
+			name, nvalues);
+		for (int i = 0; i < nnames; i++) {
+			fprintf(out, "\t{");
+			for (int v = 0; v < nvalues; v++) {
+				const char *val = names[i].value[v];
+				fprintf(out, v ? ", " : "");
+				write_string(out, strcmp(val, "-") ? val : NULL);
+			}
+			fprintf(out, "},\n");
+		}
+		fprintf(out, "};\n\n");
+	}
+
+	fprintf(out, "TABLE_DATA char *const %s_prefixes[] = {\n", name);
+	for (int i = 0; i < nprefixes; i++)
+		fprintf(out, "\t\"%s\",\n", prefixes[i]);
+	fprintf(out, "\tNULL\n};\n\n");
+
+	fprintf(out, "TABLE_DATA struct table_slot %s_slots[%u] = {\n",
+		name, mask + 1);
+	for (uint32_t i = 0; i <= mask; i++) {
+		if (slots[i].index)
+			fprintf(out, "\t[%u] = {%u, %u},\n", i, slots[i].index,
+				slots[i].len);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "TABLE_DATA uint16_t %s_disp[%u] = {\n", name,
+		bmask + 1);
+	for (uint32_t i = 0; i <= bmask; i++) {
+		if (disp[i] || i == 0)
+			fprintf(out, "\t[%u] = %u,\n", i, disp[i]);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "TABLE_DATA uint64_t %s_pairs[%d] = {\n", name,
+		128 * 128 / 64);
+	for (int i = 0; i < 128 * 128 / 64; i++) {
+		if (pairs[i])
+			fprintf(out, "\t[%d] = 0x%016llxULL,\n", i,
+				(unsigned long long)pairs[i]);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "TABLE_DATA struct table %s_table = {\n", name);
+	fprintf(out, "\t.names = %s,\n\t.prefixes = %s_prefixes,\n", name,
+		name);
+	fprintf(out, "\t.slots = %s_slots,\n\t.mask = %u,\n\t.seed = %u,\n",
+		name, mask, seed);
+	fprintf(out, "\t.disp = %s_disp,\n\t.bmask = %u,\n", name, bmask);
+	fprintf(out, "\t.pairs = %s_pairs,\n};\n\n", name);
+	fprintf(out, "#endif /* GEN_%s_H */\n", guard);
+
+	if (fclose(out) != 0 || rename(tmp, output) != 0)
+		fail(output, 0, strerror(errno));
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "msg_common.h"
+#include "trace_common.h"
+
+struct trace_state trace = {.fd = -1 };
+
+void trace_enable(const char *fd)
+{
+	char *end;
+
+	if (!fd || !*fd) {
+		return;
+	}
+	long n = strtol(fd, &end, 10);
+	if (*end != '\0' || n < 0 || n > INT_MAX) {
+		return;
+	}
+	if (trace.fd < 0) {
+		clock_gettime(CLOCK_MONOTONIC, &trace.start);
+	}
+	trace.fd = n;
+}
+
+static long trace_us(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000000L +
+	    (to->tv_nsec - from->tv_nsec) / 1000;
+}
+
+/*
+ * Append read/write syscall counts from /proc/self/io.  They are the only
+ * syscall counters Linux keeps per process, and the file is unreadable
+ * once a setuid process has switched to a non-root user.
+ */
+static int trace_io(char *buf, size_t size)
+{
+	char io[512];
+	long syscr = -1, syscw = -1;
+	int fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return 0;
+	}
+	ssize_t n = read(fd, io, sizeof(io) - 1);
+	close(fd);
+	if (n <= 0) {
+		return 0;
+	}
+	io[n] = '\0';
+	char *p = strstr(io, "syscr:");
+	if (p)
+		syscr = strtol(p + 6, NULL, 10);
+	p = strstr(io, "syscw:");
+	if (p)
+		syscw = strtol(p + 6, NULL, 10);
+	if (syscr < 0 || syscw < 0) {
+		return 0;
+	}
+	return msg_format(buf, size, " syscr=%ld syscw=%ld", syscr, syscw);
+}
+
+void trace_emit(const char *prog)
+{
+	char buf[1024];
+	struct timespec now;
+	struct rusage ru;
+	const struct timespec *prev = &trace.start;
+	int len;
+
+	if (trace.fd < 0) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	len = msg_format(buf, sizeof(buf), "%s: trace", prog);
+	for (int i = 0; i < trace.n && len < (int)sizeof(buf); i++) {
+		len += msg_format(buf + len, sizeof(buf) - len, " %s=%ldus",
+				  trace.name[i], trace_us(prev, &trace.at[i]));
+		prev = &trace.at[i];
+	}
+	if (len < (int)sizeof(buf)) {
+		len += msg_format(buf + len, sizeof(buf) - len, " total=%ldus",
+				  trace_us(&trace.start, &now));
+	}
+	if (len < (int)sizeof(buf) && getrusage(RUSAGE_SELF, &ru) == 0) {
+		len += msg_format(buf + len, sizeof(buf) - len,
+				  " minflt=%ld majflt=%ld nvcsw=%ld nivcsw=%ld",
+				  ru.ru_minflt, ru.ru_majflt, ru.ru_nvcsw,
+				  ru.ru_nivcsw);
+	}
+	if (len < (int)sizeof(buf)) {
+		len += trace_io(buf + len, sizeof(buf) - len);
+	}
+	if (len >= (int)sizeof(buf) - 1) {
+		len = sizeof(buf) - 2;
+	}
+	buf[len++] = '\n';
+	if (write(trace.fd, buf, len) < 0) {
+		// Nothing useful to do; the command still runs
+	}
+}
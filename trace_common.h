@@ -0,0 +1,43 @@
+#ifndef TRACE_COMMON_H
+#define TRACE_COMMON_H
+
+#include <time.h>
+
+/*
+ * Opt-in phase timing, enabled with SUEX_TRACE=FD or --trace=FD.  Each
+ * trace_mark() records when a phase ended; trace_emit() writes all of
+ * them as one line with a single write() right before exec.  While
+ * disabled a mark is one branch and nothing is written.
+ */
+
+#define TRACE_ENV "SUEX_TRACE"
+#define TRACE_MAX_MARKS 16
+
+struct trace_state {
+	int fd;			// -1 while disabled
+	int n;
+	struct timespec start;
+	const char *name[TRACE_MAX_MARKS];
+	struct timespec at[TRACE_MAX_MARKS];
+};
+
+extern struct trace_state trace;
+
+// Start tracing to the file descriptor named by fd; bad values are ignored
+void trace_enable(const char *fd);
+
+// Write the trace line for prog; call right before exec
+void trace_emit(const char *prog);
+
+// Record the end of a phase; name must be a string literal
+static inline void trace_mark(const char *name)
+{
+	if (trace.fd < 0 || trace.n == TRACE_MAX_MARKS) {
+		return;
+	}
+	trace.name[trace.n] = name;
+	clock_gettime(CLOCK_MONOTONIC, &trace.at[trace.n]);
+	trace.n++;
+}
+
+#endif /* TRACE_COMMON_H */
@@ -1,58 +1,50 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 #include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#endif
 
-// Structure to map system architecture to unofficial name
-struct arch_map {
-	const char *system_arch;
-	const char *unofficial_arch;
-	const char *original_arch;	// For -a flag, NULL means use system_arch
-};
-
-// Mapping table: system/kernel names → normalized names
-// original_arch: non-NULL when the kernel name differs from the canonical Linux name
-static const struct arch_map arch_mappings[] = {
-	// x86
-	{"x86_64", "amd64", NULL},
-	{"x86-64", "amd64", NULL},
-	{"i686", "i386", NULL},
-	{"i586", "i386", NULL},
-	{"i486", "i386", NULL},
-	{"i386", "i386", NULL},
-	// ARM 64-bit
-	{"aarch64", "arm64", NULL},
-	{"arm64", "arm64", "aarch64"},	// macOS reports arm64 instead of aarch64
-	// ARM 32-bit
-	{"armv7l", "armhf", NULL},
-	{"armv7", "armhf", NULL},
-	{"armv6l", "armel", NULL},
-	{"armv5tel", "armel", NULL},
-	{"armv5l", "armel", NULL},
-	// RISC-V
-	{"riscv64", "riscv64", NULL},
-	// IBM / PowerPC
-	{"s390x", "s390x", NULL},
-	{"ppc64le", "ppc64el", NULL},
-	{"ppc64", "ppc64", NULL},
-	{"powerpc", "powerpc", NULL},
-	// MIPS
-	{"mips64el", "mips64el", NULL},
-	{"mips64", "mips64", NULL},
-	{"mipsel", "mipsel", NULL},
-	{"mips", "mips", NULL},
-	// LoongArch
-	{"loongarch64", "loong64", NULL},
-	{NULL, NULL, NULL}	// Terminator
-};
+/*
+ * Mapping table: system/kernel names to normalized names, from ARCH_TABLE
+ * (tables/arch_mappings.txt by default).  The second value is the name -a
+ * prints when the kernel name differs from the canonical Linux name.
+ */
+#include "gen_arch_mappings.h"
 
 static void usage(const char *progname)
 {
 	fprintf(stderr, "Usage: %s [-a] [ARCH]\n", progname);
+	fprintf(stderr, "       %s [-l] [-m] [-f]\n", progname);
+	fprintf(stderr, "       %s --topology [-j]\n", progname);
+	fprintf(stderr, "       %s --limits [-j]\n", progname);
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr,
-		"  -a    Print original kernel name instead of normalized name\n\n");
+		"  -a    Print original kernel name instead of normalized name\n");
+	fprintf(stderr,
+		"  -l    Print the CPU level: x86-64-v3, armv8.2-a, power9, ...\n");
+	fprintf(stderr,
+		"  -m    Print the compiler -march (-mcpu on POWER) for this CPU\n");
+	fprintf(stderr,
+		"  -f    Print the CPU feature flags, one per line\n");
+	fprintf(stderr,
+		"  --topology  Print cores, NUMA nodes, caches and a worker\n");
+	fprintf(stderr,
+		"              count per node for the CPUs this process may use\n");
+	fprintf(stderr,
+		"  --limits    Print usable CPUs and memory under the cgroup's\n");
+	fprintf(stderr,
+		"              quota, cpuset and memory limits, as shell variables\n");
+	fprintf(stderr, "  -j    JSON output (with --topology or --limits)\n\n");
 	fprintf(stderr,
 		"Without ARCH argument, detects the current system architecture.\n");
 	fprintf(stderr,
@@ -81,42 +73,1112 @@ static int is_macos(void)
 #endif
 }
 
+// ARCH_TABLE lines are a kernel name, the normalized name and the -a name
+_Static_assert(sizeof(arch_mappings_values[0]) /
+	       sizeof(arch_mappings_values[0][0]) == 2,
+	       "ARCH_TABLE needs two value columns");
+
 static void print_arch(const char *arch_str, int show_original)
 {
-	const struct arch_map *mapping;
-	for (mapping = arch_mappings; mapping->system_arch != NULL; mapping++) {
-		if (strcmp(arch_str, mapping->system_arch) == 0) {
-			if (show_original) {
-				printf("%s\n",
-				       mapping->original_arch ? mapping->
-				       original_arch : mapping->system_arch);
-			} else {
-				printf("%s\n", mapping->unofficial_arch);
-			}
-			return;
+	int i = table_find(&arch_mappings_table, arch_str, strlen(arch_str));
+	if (i >= 0) {
+		const char *const *mapping = arch_mappings_values[i];
+		if (show_original) {
+			printf("%s\n", mapping[1] ? mapping[1] : arch_str);
+		} else {
+			printf("%s\n", mapping[0]);
 		}
+		return;
 	}
 	// No match: print as-is
 	printf("%s\n", arch_str);
 }
 
+/*
+ * CPU features, read from cpuid on x86 and from the kernel's hwcaps
+ * elsewhere.  caps[] holds the raw registers or hwcap words; a feature
+ * is one bit in one of them.  Names are the compiler's on x86 and the
+ * kernel's (/proc/cpuinfo) on other architectures.
+ */
+#define CAP_WORDS 8
+
+struct feature {
+	const char *name;
+	int word;
+	unsigned long bit;
+	int xstate;		// x86: also needs OS support for this state
+};
+
+// A level and the features it requires, in increasing order
+struct level {
+	const char *name;
+	const char *march;
+	const char *requires;	// space-separated feature names
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+enum { X86_1C, X86_1D, X86_7B, X86_7C, X86_7D, X86_71A, X86_E1C };
+
+// XCR0 bits the OS must enable before AVX and AVX-512 can be used
+#define XSTATE_AVX 0x6
+#define XSTATE_AVX512 0xe6
+
+static const struct feature features[] = {
+	{"mmx", X86_1D, 1UL << 23, 0},
+	{"sse", X86_1D, 1UL << 25, 0},
+	{"sse2", X86_1D, 1UL << 26, 0},
+	{"sse3", X86_1C, 1UL << 0, 0},
+	{"pclmul", X86_1C, 1UL << 1, 0},
+	{"ssse3", X86_1C, 1UL << 9, 0},
+	{"fma", X86_1C, 1UL << 12, XSTATE_AVX},
+	{"cx16", X86_1C, 1UL << 13, 0},
+	{"sse4_1", X86_1C, 1UL << 19, 0},
+	{"sse4_2", X86_1C, 1UL << 20, 0},
+	{"movbe", X86_1C, 1UL << 22, 0},
+	{"popcnt", X86_1C, 1UL << 23, 0},
+	{"aes", X86_1C, 1UL << 25, 0},
+	{"xsave", X86_1C, 1UL << 26, 0},
+	{"avx", X86_1C, 1UL << 28, XSTATE_AVX},
+	{"f16c", X86_1C, 1UL << 29, XSTATE_AVX},
+	{"rdrnd", X86_1C, 1UL << 30, 0},
+	{"lahf_lm", X86_E1C, 1UL << 0, 0},
+	{"lzcnt", X86_E1C, 1UL << 5, 0},
+	{"bmi", X86_7B, 1UL << 3, 0},
+	{"avx2", X86_7B, 1UL << 5, XSTATE_AVX},
+	{"bmi2", X86_7B, 1UL << 8, 0},
+	{"avx512f", X86_7B, 1UL << 16, XSTATE_AVX512},
+	{"avx512dq", X86_7B, 1UL << 17, XSTATE_AVX512},
+	{"rdseed", X86_7B, 1UL << 18, 0},
+	{"adx", X86_7B, 1UL << 19, 0},
+	{"avx512ifma", X86_7B, 1UL << 21, XSTATE_AVX512},
+	{"avx512cd", X86_7B, 1UL << 28, XSTATE_AVX512},
+	{"sha", X86_7B, 1UL << 29, 0},
+	{"avx512bw", X86_7B, 1UL << 30, XSTATE_AVX512},
+	{"avx512vl", X86_7B, 1UL << 31, XSTATE_AVX512},
+	{"avx512vbmi", X86_7C, 1UL << 1, XSTATE_AVX512},
+	{"avx512vbmi2", X86_7C, 1UL << 6, XSTATE_AVX512},
+	{"gfni", X86_7C, 1UL << 8, 0},
+	{"vaes", X86_7C, 1UL << 9, XSTATE_AVX},
+	{"vpclmulqdq", X86_7C, 1UL << 10, XSTATE_AVX},
+	{"avx512vnni", X86_7C, 1UL << 11, XSTATE_AVX512},
+	{"avx512bitalg", X86_7C, 1UL << 12, XSTATE_AVX512},
+	{"avx512vpopcntdq", X86_7C, 1UL << 14, XSTATE_AVX512},
+	{"avx512fp16", X86_7D, 1UL << 23, XSTATE_AVX512},
+	{"avxvnni", X86_71A, 1UL << 4, XSTATE_AVX},
+	{"avx512bf16", X86_71A, 1UL << 5, XSTATE_AVX512},
+	{NULL, 0, 0, 0},
+};
+
+// The x86-64 psABI micro-architecture levels
+static const struct level levels[] = {
+#ifdef __x86_64__
+	{"x86-64", "x86-64", ""},
+	{"x86-64-v2", "x86-64-v2",
+	 "cx16 lahf_lm popcnt sse3 sse4_1 sse4_2 ssse3"},
+	{"x86-64-v3", "x86-64-v3",
+	 "avx avx2 bmi bmi2 f16c fma lzcnt movbe xsave"},
+	{"x86-64-v4", "x86-64-v4",
+	 "avx512f avx512bw avx512cd avx512dq avx512vl"},
+#else
+	{"i686", "i686", ""},
+#endif
+	{NULL, NULL, NULL},
+};
+
+static unsigned long xgetbv0(void)
+{
+	unsigned int lo, hi;
+
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return lo | ((unsigned long)hi << 32);
+}
+
+static int read_caps(unsigned long *caps, unsigned long *xstate)
+{
+	unsigned int a, b, c, d, max = __get_cpuid_max(0, NULL);
+
+	if (max < 1 || !__get_cpuid(1, &a, &b, &c, &d))
+		return -1;
+	caps[X86_1C] = c;
+	caps[X86_1D] = d;
+	if (max >= 7) {
+		__cpuid_count(7, 0, a, b, c, d);
+		caps[X86_7B] = b;
+		caps[X86_7C] = c;
+		caps[X86_7D] = d;
+		if (a >= 1) {
+			__cpuid_count(7, 1, a, b, c, d);
+			caps[X86_71A] = a;
+		}
+	}
+	if (__get_cpuid(0x80000001, &a, &b, &c, &d))
+		caps[X86_E1C] = c;
+	// Without OSXSAVE the OS saves no AVX state at all
+	if (caps[X86_1C] & (1UL << 27))
+		*xstate = xgetbv0();
+	return 0;
+}
+
+#elif defined(__linux__) && defined(__aarch64__)
+enum { HWCAP1, HWCAP2 };
+
+static const struct feature features[] = {
+	{"fp", HWCAP1, 1UL << 0, 0},
+	{"asimd", HWCAP1, 1UL << 1, 0},
+	{"aes", HWCAP1, 1UL << 3, 0},
+	{"pmull", HWCAP1, 1UL << 4, 0},
+	{"sha1", HWCAP1, 1UL << 5, 0},
+	{"sha2", HWCAP1, 1UL << 6, 0},
+	{"crc32", HWCAP1, 1UL << 7, 0},
+	{"atomics", HWCAP1, 1UL << 8, 0},
+	{"fphp", HWCAP1, 1UL << 9, 0},
+	{"asimdhp", HWCAP1, 1UL << 10, 0},
+	{"asimdrdm", HWCAP1, 1UL << 12, 0},
+	{"jscvt", HWCAP1, 1UL << 13, 0},
+	{"fcma", HWCAP1, 1UL << 14, 0},
+	{"lrcpc", HWCAP1, 1UL << 15, 0},
+	{"dcpop", HWCAP1, 1UL << 16, 0},
+	{"sha3", HWCAP1, 1UL << 17, 0},
+	{"sm3", HWCAP1, 1UL << 18, 0},
+	{"sm4", HWCAP1, 1UL << 19, 0},
+	{"asimddp", HWCAP1, 1UL << 20, 0},
+	{"sha512", HWCAP1, 1UL << 21, 0},
+	{"sve", HWCAP1, 1UL << 22, 0},
+	{"asimdfhm", HWCAP1, 1UL << 23, 0},
+	{"dit", HWCAP1, 1UL << 24, 0},
+	{"uscat", HWCAP1, 1UL << 25, 0},
+	{"ilrcpc", HWCAP1, 1UL << 26, 0},
+	{"flagm", HWCAP1, 1UL << 27, 0},
+	{"ssbs", HWCAP1, 1UL << 28, 0},
+	{"sb", HWCAP1, 1UL << 29, 0},
+	{"paca", HWCAP1, 1UL << 30, 0},
+	{"pacg", HWCAP1, 1UL << 31, 0},
+	{"dcpodp", HWCAP2, 1UL << 0, 0},
+	{"sve2", HWCAP2, 1UL << 1, 0},
+	{"sveaes", HWCAP2, 1UL << 2, 0},
+	{"svepmull", HWCAP2, 1UL << 3, 0},
+	{"svebitperm", HWCAP2, 1UL << 4, 0},
+	{"svesha3", HWCAP2, 1UL << 5, 0},
+	{"svesm4", HWCAP2, 1UL << 6, 0},
+	{"flagm2", HWCAP2, 1UL << 7, 0},
+	{"frint", HWCAP2, 1UL << 8, 0},
+	{"svei8mm", HWCAP2, 1UL << 9, 0},
+	{"svef32mm", HWCAP2, 1UL << 10, 0},
+	{"svef64mm", HWCAP2, 1UL << 11, 0},
+	{"svebf16", HWCAP2, 1UL << 12, 0},
+	{"i8mm", HWCAP2, 1UL << 13, 0},
+	{"bf16", HWCAP2, 1UL << 14, 0},
+	{"rng", HWCAP2, 1UL << 16, 0},
+	{"bti", HWCAP2, 1UL << 17, 0},
+	{"mte", HWCAP2, 1UL << 18, 0},
+	{"sme", HWCAP2, 1UL << 23, 0},
+	{NULL, 0, 0, 0},
+};
+
+/*
+ * Architecture versions by the user-visible features each one makes
+ * mandatory; the kernel reports no version, so these are inferred.
+ */
+static const struct level levels[] = {
+	{"armv8-a", "armv8-a", "fp asimd"},
+	{"armv8.1-a", "armv8.1-a", "atomics asimdrdm crc32"},
+	{"armv8.2-a", "armv8.2-a", "dcpop"},
+	{"armv8.3-a", "armv8.3-a", "fcma jscvt lrcpc"},
+	{"armv8.4-a", "armv8.4-a", "dit flagm ilrcpc uscat"},
+	{"armv8.5-a", "armv8.5-a", "dcpodp flagm2 frint sb ssbs"},
+	{"armv9-a", "armv9-a", "sve2"},
+	{NULL, NULL, NULL},
+};
+
+static int read_caps(unsigned long *caps, unsigned long *xstate)
+{
+	(void)xstate;
+	caps[HWCAP1] = getauxval(AT_HWCAP);
+	caps[HWCAP2] = getauxval(AT_HWCAP2);
+	return 0;
+}
+
+#elif defined(__linux__) && defined(__powerpc64__)
+enum { HWCAP1, HWCAP2 };
+
+static const struct feature features[] = {
+	{"altivec", HWCAP1, 0x10000000, 0},
+	{"vsx", HWCAP1, 0x00000080, 0},
+	{"arch_2_07", HWCAP2, 0x80000000, 0},
+	{"htm", HWCAP2, 0x40000000, 0},
+	{"vcrypto", HWCAP2, 0x02000000, 0},
+	{"arch_3_00", HWCAP2, 0x00800000, 0},
+	{"ieee128", HWCAP2, 0x00400000, 0},
+	{"darn", HWCAP2, 0x00200000, 0},
+	{"arch_3_1", HWCAP2, 0x00040000, 0},
+	{"mma", HWCAP2, 0x00020000, 0},
+	{NULL, 0, 0, 0},
+};
+
+static const struct level levels[] = {
+	{"power8", "power8", "altivec vsx arch_2_07"},
+	{"power9", "power9", "arch_3_00"},
+	{"power10", "power10", "arch_3_1"},
+	{NULL, NULL, NULL},
+};
+
+static int read_caps(unsigned long *caps, unsigned long *xstate)
+{
+	(void)xstate;
+	caps[HWCAP1] = getauxval(AT_HWCAP);
+	caps[HWCAP2] = getauxval(AT_HWCAP2);
+	return 0;
+}
+
+#elif defined(__linux__) && defined(__riscv) && __riscv_xlen == 64
+// One bit per single-letter extension, 'a' first
+#define RV(c) (1UL << ((c) - 'a'))
+
+static const struct feature features[] = {
+	{"i", 0, RV('i'), 0},
+	{"m", 0, RV('m'), 0},
+	{"a", 0, RV('a'), 0},
+	{"f", 0, RV('f'), 0},
+	{"d", 0, RV('d'), 0},
+	{"c", 0, RV('c'), 0},
+	{"v", 0, RV('v'), 0},
+	{NULL, 0, 0, 0},
+};
+
+static const struct level levels[] = {
+	{"rv64i", "rv64i", "i"},
+	{"rva20u64", "rv64gc", "m a f d c"},
+	{NULL, NULL, NULL},
+};
+
+static int read_caps(unsigned long *caps, unsigned long *xstate)
+{
+	(void)xstate;
+	caps[0] = getauxval(AT_HWCAP);
+	return 0;
+}
+
+#else
+static const struct feature features[] = { {NULL, 0, 0, 0} };
+static const struct level levels[] = { {NULL, NULL, NULL} };
+
+static int read_caps(unsigned long *caps, unsigned long *xstate)
+{
+	(void)caps;
+	(void)xstate;
+	return -1;
+}
+#endif
+
+static int has_feature(const unsigned long *caps, unsigned long xstate,
+		       const struct feature *f)
+{
+	if (!(caps[f->word] & f->bit))
+		return 0;
+	return (xstate & f->xstate) == (unsigned long)f->xstate;
+}
+
+// Check every space-separated name in list against the detected features
+static int has_all(const unsigned long *caps, unsigned long xstate,
+		   const char *list)
+{
+	while (*list) {
+		size_t len = strcspn(list, " ");
+		int found = 0;
+
+		for (const struct feature *f = features; f->name; f++) {
+			if (strlen(f->name) == len &&
+			    strncmp(f->name, list, len) == 0) {
+				found = has_feature(caps, xstate, f);
+				break;
+			}
+		}
+		if (!found)
+			return 0;
+		list += len;
+		list += strspn(list, " ");
+	}
+	return 1;
+}
+
+/*
+ * Print the level, the -march string and/or the feature flags of the
+ * running CPU.  Levels are cumulative: the highest one whose requirements
+ * and those of every level below it are met wins.
+ */
+static int print_cpu(int show_level, int show_march, int show_features)
+{
+	unsigned long caps[CAP_WORDS] = { 0 }, xstate = 0;
+	const struct level *best = NULL;
+
+	if (read_caps(caps, &xstate) < 0 || !levels[0].name) {
+		fprintf(stderr, "CPU features not supported on this system\n");
+		return 1;
+	}
+	for (const struct level *l = levels; l->name; l++) {
+		if (!has_all(caps, xstate, l->requires))
+			break;
+		best = l;
+	}
+	if (!best) {
+		fprintf(stderr, "CPU below the %s baseline\n", levels[0].name);
+		return 1;
+	}
+
+	if (show_level)
+		printf("%s\n", best->name);
+	if (show_march) {
+		printf("%s", best->march);
+#if defined(__aarch64__)
+		// SVE is optional before armv9-a
+		if (strcmp(best->name, "armv9-a") != 0 &&
+		    has_all(caps, xstate, "sve"))
+			printf("+sve");
+#elif defined(__riscv)
+		if (has_all(caps, xstate, "v"))
+			printf("v");
+#endif
+		printf("\n");
+	}
+	if (show_features) {
+		for (const struct feature *f = features; f->name; f++) {
+			if (has_feature(caps, xstate, f))
+				printf("%s\n", f->name);
+		}
+	}
+	return 0;
+}
+
+#ifdef __linux__
+#define SYS_CPU "/sys/devices/system/cpu"
+#define SYS_NODE "/sys/devices/system/node"
+
+// Read a small sysfs file without its trailing newline; -1 if unreadable
+static int read_sys(const char *path, char *buf, size_t size)
+{
+	int fd = open(path, O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, size - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+	while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+		n--;
+	buf[n] = '\0';
+	return n;
+}
+
+static long read_sys_long(const char *path, long fallback)
+{
+	char buf[64];
+
+	if (read_sys(path, buf, sizeof(buf)) <= 0)
+		return fallback;
+	return strtol(buf, NULL, 10);
+}
+
+/*
+ * Parse a kernel CPU list ("0-3,8,10-11") into set; ids at or above
+ * ncpus are ignored.  Returns the highest id listed, -1 if none.
+ */
+static int parse_cpulist(const char *s, cpu_set_t *set, size_t setsize,
+			 int ncpus)
+{
+	int max = -1;
+
+	while (*s) {
+		char *end;
+		long lo = strtol(s, &end, 10), hi = lo;
+
+		if (end == s)
+			break;
+		if (*end == '-')
+			hi = strtol(end + 1, &end, 10);
+		for (long c = lo; c <= hi; c++) {
+			if (set && c < ncpus)
+				CPU_SET_S(c, setsize, set);
+		}
+		if (hi > max)
+			max = hi;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return max;
+}
+
+// The CPUs this process may run on, as sysfs and the affinity mask see them
+struct topology {
+	int ncpus;		// possible CPU ids
+	size_t setsize;
+	cpu_set_t *allowed;	// online and in the affinity mask
+	int *core;		// per CPU: lowest CPU among its SMT siblings
+	int *package;
+	int *node;
+};
+
+static int load_topology(struct topology *t)
+{
+	char path[128], buf[4096];
+	cpu_set_t *online;
+
+	if (read_sys(SYS_CPU "/possible", buf, sizeof(buf)) <= 0 &&
+	    read_sys(SYS_CPU "/online", buf, sizeof(buf)) <= 0)
+		return -1;
+	t->ncpus = parse_cpulist(buf, NULL, 0, 0) + 1;
+	if (t->ncpus < 1)
+		return -1;
+	t->setsize = CPU_ALLOC_SIZE(t->ncpus);
+	t->allowed = CPU_ALLOC(t->ncpus);
+	online = CPU_ALLOC(t->ncpus);
+	t->core = calloc(t->ncpus, sizeof(int));
+	t->package = calloc(t->ncpus, sizeof(int));
+	t->node = calloc(t->ncpus, sizeof(int));
+	if (!t->allowed || !online || !t->core || !t->package || !t->node)
+		return -1;
+
+	CPU_ZERO_S(t->setsize, online);
+	if (read_sys(SYS_CPU "/online", buf, sizeof(buf)) > 0)
+		parse_cpulist(buf, online, t->setsize, t->ncpus);
+	else
+		for (int c = 0; c < t->ncpus; c++)
+			CPU_SET_S(c, t->setsize, online);
+	// Without a usable mask every online CPU counts as allowed
+	if (sched_getaffinity(0, t->setsize, t->allowed) < 0)
+		CPU_ZERO_S(t->setsize, t->allowed);
+	if (CPU_COUNT_S(t->setsize, t->allowed) == 0)
+		CPU_OR_S(t->setsize, t->allowed, t->allowed, online);
+	else
+		CPU_AND_S(t->setsize, t->allowed, t->allowed, online);
+	CPU_FREE(online);
+
+	for (int c = 0; c < t->ncpus; c++) {
+		if (!CPU_ISSET_S(c, t->setsize, t->allowed))
+			continue;
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%d/topology/thread_siblings_list", c);
+		t->core[c] = c;
+		if (read_sys(path, buf, sizeof(buf)) > 0)
+			t->core[c] = atoi(buf);
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%d/topology/physical_package_id", c);
+		t->package[c] = read_sys_long(path, 0);
+	}
+
+	// Machines without NUMA have no node directory: everything is node 0
+	if (read_sys(SYS_NODE "/online", buf, sizeof(buf)) > 0) {
+		cpu_set_t *cpus = CPU_ALLOC(t->ncpus);
+		int nmax = parse_cpulist(buf, NULL, 0, 0);
+		if (!cpus)
+			return -1;
+		for (int n = 0; n <= nmax; n++) {
+			snprintf(path, sizeof(path), SYS_NODE "/node%d/cpulist",
+				 n);
+			if (read_sys(path, buf, sizeof(buf)) < 0)
+				continue;
+			CPU_ZERO_S(t->setsize, cpus);
+			parse_cpulist(buf, cpus, t->setsize, t->ncpus);
+			for (int c = 0; c < t->ncpus; c++) {
+				if (CPU_ISSET_S(c, t->setsize, cpus))
+					t->node[c] = n;
+			}
+		}
+		CPU_FREE(cpus);
+	}
+	return 0;
+}
+
+// Allowed CPUs, distinct cores and the widest core among CPUs in node
+struct cpu_count {
+	int cpus;
+	int cores;
+	int threads;		// most allowed SMT siblings in one core
+};
+
+static struct cpu_count count_cpus(const struct topology *t, int node)
+{
+	struct cpu_count n = { 0, 0, 0 };
+	int *per_core = calloc(t->ncpus, sizeof(int));
+
+	if (!per_core)
+		return n;
+	for (int c = 0; c < t->ncpus; c++) {
+		if (!CPU_ISSET_S(c, t->setsize, t->allowed) ||
+		    (node >= 0 && t->node[c] != node))
+			continue;
+		n.cpus++;
+		int core = t->core[c] < t->ncpus ? t->core[c] : c;
+		if (per_core[core]++ == 0)
+			n.cores++;
+		if (per_core[core] > n.threads)
+			n.threads = per_core[core];
+	}
+	free(per_core);
+	return n;
+}
+
+static int count_packages(const struct topology *t)
+{
+	int n = 0;
+
+	for (int c = 0; c < t->ncpus; c++) {
+		int seen = 0;
+		if (!CPU_ISSET_S(c, t->setsize, t->allowed))
+			continue;
+		for (int d = 0; d < c && !seen; d++)
+			seen = CPU_ISSET_S(d, t->setsize, t->allowed) &&
+			    t->package[d] == t->package[c];
+		n += !seen;
+	}
+	return n;
+}
+
+// Allowed CPUs of node (every node if node < 0) as a kernel CPU list
+static void format_cpulist(const struct topology *t, int node, char *buf,
+			   size_t size)
+{
+	size_t len = 0;
+
+	buf[0] = '\0';
+	for (int c = 0; c < t->ncpus && len < size; c++) {
+		if (!CPU_ISSET_S(c, t->setsize, t->allowed) ||
+		    (node >= 0 && t->node[c] != node))
+			continue;
+		int last = c;
+		while (last + 1 < t->ncpus &&
+		       CPU_ISSET_S(last + 1, t->setsize, t->allowed) &&
+		       (node < 0 || t->node[last + 1] == node))
+			last++;
+		if (last == c)
+			len += snprintf(buf + len, size - len, "%s%d",
+					len ? "," : "", c);
+		else
+			len += snprintf(buf + len, size - len, "%s%d-%d",
+					len ? "," : "", c, last);
+		c = last;
+	}
+}
+
+// Parse "48K", "2048K" or "32M" as bytes
+static long parse_size(const char *s)
+{
+	char *end;
+	long v = strtol(s, &end, 10);
+
+	if (*end == 'K')
+		v <<= 10;
+	else if (*end == 'M')
+		v <<= 20;
+	else if (*end == 'G')
+		v <<= 30;
+	return v;
+}
+
+struct cache {
+	char name[24];		// L1d, L1i, L2, ...
+	long size;
+	long line;
+	int shared;		// online CPUs sharing it
+};
+
+#define MAX_CACHES 8
+
+// The caches of the first allowed CPU, as the kernel lists them
+static int load_caches(const struct topology *t, struct cache *caches)
+{
+	char path[128], buf[4096];
+	int cpu = 0, n = 0;
+
+	while (cpu < t->ncpus && !CPU_ISSET_S(cpu, t->setsize, t->allowed))
+		cpu++;
+	for (int i = 0; n < MAX_CACHES; i++) {
+		struct cache *k = &caches[n];
+		char type[16];
+		long level;
+
+		snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/level",
+			 cpu, i);
+		level = read_sys_long(path, -1);
+		if (level < 0)
+			break;
+		snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/type",
+			 cpu, i);
+		if (read_sys(path, type, sizeof(type)) < 0)
+			continue;
+		snprintf(k->name, sizeof(k->name), "L%ld%s", level,
+			 strcmp(type, "Data") == 0 ? "d" :
+			 strcmp(type, "Instruction") == 0 ? "i" : "");
+		snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/size",
+			 cpu, i);
+		k->size = read_sys(path, buf, sizeof(buf)) > 0 ?
+		    parse_size(buf) : 0;
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%d/cache/index%d/coherency_line_size",
+			 cpu, i);
+		k->line = read_sys_long(path, 0);
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, i);
+		k->shared = 1;
+		if (read_sys(path, buf, sizeof(buf)) > 0) {
+			cpu_set_t *set = CPU_ALLOC(t->ncpus);
+			if (set) {
+				CPU_ZERO_S(t->setsize, set);
+				parse_cpulist(buf, set, t->setsize, t->ncpus);
+				k->shared = CPU_COUNT_S(t->setsize, set);
+				CPU_FREE(set);
+			}
+		}
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Print the topology of the CPUs in the affinity mask.  The recommended
+ * workers per node is one per physical core there: SMT siblings share a
+ * core's execution units, so a second busy worker on one gains little.
+ */
+static int print_topology(int json)
+{
+	struct topology t;
+	struct cache caches[MAX_CACHES];
+	char list[4096];
+
+	if (load_topology(&t) < 0) {
+		fprintf(stderr, "CPU topology not available on this system\n");
+		return 1;
+	}
+	struct cpu_count all = count_cpus(&t, -1);
+	int packages = count_packages(&t);
+	int ncaches = load_caches(&t, caches);
+	int maxnode = 0, nnodes = 0;
+
+	for (int c = 0; c < t.ncpus; c++) {
+		if (CPU_ISSET_S(c, t.setsize, t.allowed) && t.node[c] > maxnode)
+			maxnode = t.node[c];
+	}
+	for (int n = 0; n <= maxnode; n++)
+		nnodes += count_cpus(&t, n).cpus > 0;
+	format_cpulist(&t, -1, list, sizeof(list));
+
+	if (json) {
+		printf("{\"cpus\":%d,\"cpu_list\":\"%s\",\"cores\":%d,"
+		       "\"threads_per_core\":%d,\"packages\":%d,\"nodes\":[",
+		       all.cpus, list, all.cores, all.threads, packages);
+	} else {
+		printf("CPUs:             %d (%s)\n", all.cpus, list);
+		printf("Cores:            %d\n", all.cores);
+		printf("Threads per core: %d\n", all.threads);
+		printf("Packages:         %d\n", packages);
+		printf("NUMA nodes:       %d\n", nnodes);
+	}
+	for (int n = 0, first = 1; n <= maxnode; n++) {
+		struct cpu_count c = count_cpus(&t, n);
+		if (c.cpus == 0)
+			continue;
+		format_cpulist(&t, n, list, sizeof(list));
+		if (json)
+			printf("%s{\"node\":%d,\"cpu_list\":\"%s\",\"cpus\":%d,"
+			       "\"cores\":%d,\"workers\":%d}", first ? "" : ",",
+			       n, list, c.cpus, c.cores, c.cores);
+		else
+			printf("Node %d:           %d CPUs (%s), %d cores, "
+			       "%d workers\n", n, c.cpus, list, c.cores,
+			       c.cores);
+		first = 0;
+	}
+	if (json)
+		printf("],\"caches\":[");
+	for (int i = 0; i < ncaches; i++) {
+		struct cache *k = &caches[i];
+		char label[sizeof(k->name) + 8];
+
+		if (json) {
+			printf("%s{\"name\":\"%s\",\"size\":%ld,\"line\":%ld,"
+			       "\"shared_cpus\":%d}", i ? "," : "", k->name,
+			       k->size, k->line, k->shared);
+			continue;
+		}
+		snprintf(label, sizeof(label), "%.*s cache:",
+			 (int)sizeof(k->name) - 1, k->name);
+		printf("%-18s%ld KiB, %ld-byte lines, shared by %d CPUs\n",
+		       label, k->size >> 10, k->line, k->shared);
+	}
+	if (json)
+		printf("],\"workers\":%d}\n", all.cores);
+	else
+		printf("Workers:          %d\n", all.cores);
+
+	CPU_FREE(t.allowed);
+	free(t.core);
+	free(t.package);
+	free(t.node);
+	return 0;
+}
+
+/*
+ * Find the directory of this process's cgroup for a controller: in the
+ * cgroup2 hierarchy if it has the controller enabled, else in the v1
+ * hierarchy mounted for it.  *top is the length of the mount point, the
+ * highest directory worth reading when walking up to the ancestors.
+ * Returns the hierarchy version, 0 if there is none.
+ */
+static int cgroup_dir(const char *controller, char *dir, size_t size,
+		      size_t *top)
+{
+	char line[4096], v2[PATH_MAX] = "", v1[PATH_MAX] = "";
+	int version = 0;
+	FILE *f = fopen("/proc/self/cgroup", "r");
+
+	if (!f)
+		return 0;
+	// "0::/path" for cgroup2, "N:ctrl,ctrl:/path" for v1
+	while (fgets(line, sizeof(line), f)) {
+		char *ctrls = strchr(line, ':'), *path;
+		if (!ctrls || !(path = strchr(ctrls + 1, ':')))
+			continue;
+		*path++ = '\0';
+		path[strcspn(path, "\n")] = '\0';
+		if (strcmp(ctrls + 1, "") == 0) {
+			snprintf(v2, sizeof(v2), "%s", path);
+			continue;
+		}
+		for (char *c = strtok(ctrls + 1, ","); c; c = strtok(NULL, ",")) {
+			if (strcmp(c, controller) == 0)
+				snprintf(v1, sizeof(v1), "%s", path);
+		}
+	}
+	fclose(f);
+
+	f = fopen("/proc/self/mountinfo", "r");
+	if (!f)
+		return 0;
+	// ID PARENT DEV ROOT MOUNTPOINT OPTIONS [TAGS...] - TYPE SOURCE SUPER
+	while (fgets(line, sizeof(line), f)) {
+		char root[PATH_MAX], mnt[PATH_MAX], type[32], super[256];
+		char buf[PATH_MAX + 32];
+		const char *path, *sep = strstr(line, " - ");
+		int v;
+
+		if (!sep || sscanf(line, "%*s %*s %*s %4095s %4095s", root,
+				   mnt) != 2 ||
+		    sscanf(sep, " - %31s %*s %255s", type, super) != 2)
+			continue;
+		if (strcmp(type, "cgroup2") == 0 && v2[0]) {
+			// Only if the controller is enabled in this hierarchy
+			snprintf(buf, sizeof(buf), "%s/cgroup.controllers",
+				 mnt);
+			if (read_sys(buf, super, sizeof(super)) < 0)
+				continue;
+			int found = 0;
+			for (char *c = strtok(super, " "); c && !found;
+			     c = strtok(NULL, " "))
+				found = strcmp(c, controller) == 0;
+			if (!found)
+				continue;
+			path = v2;
+			v = 2;
+		} else if (strcmp(type, "cgroup") == 0 && v1[0] &&
+			   version < 2) {
+			int found = 0;
+			for (char *c = strtok(super, ","); c && !found;
+			     c = strtok(NULL, ","))
+				found = strcmp(c, controller) == 0;
+			if (!found)
+				continue;
+			path = v1;
+			v = 1;
+		} else {
+			continue;
+		}
+		// The mount shows the hierarchy from root down; inside a
+		// container the process's own path may lie above it
+		size_t rlen = strcmp(root, "/") == 0 ? 0 : strlen(root);
+		if (strncmp(path, root, rlen) != 0 ||
+		    (path[rlen] != '/' && path[rlen] != '\0'))
+			path = "";
+		else
+			path += rlen;
+		snprintf(dir, size, "%s%s", mnt, strcmp(path, "/") ? path : "");
+		// The last match wins: later mounts hide earlier ones
+		*top = strlen(mnt);
+		version = v;
+	}
+	fclose(f);
+	return version;
+}
+
+// Drop the last path component; 0 once dir is at the top
+static int cgroup_parent(char *dir, size_t top)
+{
+	char *slash = strrchr(dir, '/');
+
+	if (strlen(dir) <= top || !slash || (size_t)(slash - dir) < top)
+		return 0;
+	*slash = '\0';
+	return 1;
+}
+
+// Read a limit in bytes; "max" and v1's page-rounded LONG_MAX as -1
+static long long read_bytes(const char *dir, const char *file)
+{
+	char path[PATH_MAX + 64], buf[64];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	if (read_sys(path, buf, sizeof(buf)) <= 0 || strcmp(buf, "max") == 0)
+		return -1;
+	long long v = strtoll(buf, NULL, 10);
+	return v >= (1LL << 62) ? -1 : v;
+}
+
+static long long min_limit(long long a, long long b)
+{
+	if (a < 0)
+		return b;
+	if (b < 0)
+		return a;
+	return a < b ? a : b;
+}
+
+struct limits {
+	int cpu_version;	// cgroup version of each controller, 0 if none
+	int cpuset_version;
+	int memory_version;
+	int affinity;		// CPUs in the affinity mask
+	int cpuset;		// CPUs in the cgroup's effective cpuset, or 0
+	long long quota;	// CPU time per period, -1 if unlimited
+	long long period;
+	long long memory_max;	// bytes, -1 if unlimited
+	long long memory_high;
+	long long memory_total;	// physical memory
+};
+
+/*
+ * Collect the limits of this process's cgroup and every ancestor: the
+ * tightest CPU quota and memory limit along the way applies.
+ */
+static void load_limits(struct limits *l)
+{
+	char dir[PATH_MAX], buf[4096];
+	size_t top;
+	struct topology t;
+	long pages = sysconf(_SC_PHYS_PAGES), page = sysconf(_SC_PAGESIZE);
+
+	memset(l, 0, sizeof(*l));
+	l->quota = l->memory_max = l->memory_high = -1;
+	l->memory_total = pages > 0 && page > 0 ? (long long)pages * page : -1;
+	if (load_topology(&t) == 0) {
+		l->affinity = CPU_COUNT_S(t.setsize, t.allowed);
+		CPU_FREE(t.allowed);
+		free(t.core);
+		free(t.package);
+		free(t.node);
+	}
+	if (l->affinity < 1) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		l->affinity = n > 0 ? n : 1;
+	}
+
+	l->cpu_version = cgroup_dir("cpu", dir, sizeof(dir), &top);
+	do {
+		long long q = -1, p = 0;
+		char path[PATH_MAX + 32];
+
+		if (l->cpu_version == 2) {
+			snprintf(path, sizeof(path), "%s/cpu.max", dir);
+			if (read_sys(path, buf, sizeof(buf)) > 0 &&
+			    strncmp(buf, "max", 3) != 0)
+				sscanf(buf, "%lld %lld", &q, &p);
+		} else if (l->cpu_version == 1) {
+			snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+			q = read_sys_long(path, -1);
+			snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+			p = read_sys_long(path, 0);
+		}
+		// Keep the smaller quota/period ratio
+		if (q > 0 && p > 0 &&
+		    (l->quota < 0 || q * l->period < l->quota * p)) {
+			l->quota = q;
+			l->period = p;
+		}
+	} while (l->cpu_version && cgroup_parent(dir, top));
+
+	l->cpuset_version = cgroup_dir("cpuset", dir, sizeof(dir), &top);
+	if (l->cpuset_version) {
+		char path[PATH_MAX + 32];
+		snprintf(path, sizeof(path), "%s/%s", dir,
+			 l->cpuset_version == 2 ? "cpuset.cpus.effective" :
+			 "cpuset.effective_cpus");
+		if (read_sys(path, buf, sizeof(buf)) > 0) {
+			int n = parse_cpulist(buf, NULL, 0, 0) + 1;
+			cpu_set_t *set = CPU_ALLOC(n);
+			if (set) {
+				CPU_ZERO_S(CPU_ALLOC_SIZE(n), set);
+				parse_cpulist(buf, set, CPU_ALLOC_SIZE(n), n);
+				l->cpuset = CPU_COUNT_S(CPU_ALLOC_SIZE(n), set);
+				CPU_FREE(set);
+			}
+		}
+	}
+
+	l->memory_version = cgroup_dir("memory", dir, sizeof(dir), &top);
+	do {
+		if (l->memory_version == 2) {
+			l->memory_max = min_limit(l->memory_max,
+						  read_bytes(dir, "memory.max"));
+			l->memory_high = min_limit(l->memory_high,
+						   read_bytes(dir,
+							      "memory.high"));
+		} else if (l->memory_version == 1) {
+			l->memory_max = min_limit(l->memory_max,
+						  read_bytes(dir,
+							     "memory.limit_in_bytes"));
+		}
+	} while (l->memory_version && cgroup_parent(dir, top));
+}
+
+/*
+ * Print what the process can actually use: CPUs as the affinity mask,
+ * the cpuset and the CPU quota (rounded up) allow, and memory as the
+ * smallest of physical memory, memory.max and memory.high.  Unlimited
+ * values are empty in shell output and null in JSON.
+ */
+static int print_limits(int json)
+{
+	struct limits l;
+	int cpus;
+	long long memory;
+
+	load_limits(&l);
+	cpus = l.affinity;
+	if (l.cpuset > 0 && l.cpuset < cpus)
+		cpus = l.cpuset;
+	if (l.quota > 0) {
+		long long q = (l.quota + l.period - 1) / l.period;
+		if (q < cpus)
+			cpus = q > 0 ? q : 1;
+	}
+	memory = min_limit(min_limit(l.memory_total, l.memory_max),
+			   l.memory_high);
+
+	const struct {
+		const char *name;
+		long long v;
+	} vals[] = {
+		{"cpus", cpus},
+		{"affinity_cpus", l.affinity},
+		{"cpuset_cpus", l.cpuset > 0 ? l.cpuset : -1},
+		{"cpu_quota_millis", l.quota > 0 ?
+		 l.quota * 1000 / l.period : -1},
+		{"memory", memory},
+		{"memory_max", l.memory_max},
+		{"memory_high", l.memory_high},
+		{"memory_total", l.memory_total},
+		{"cgroup_cpu", l.cpu_version},
+		{"cgroup_memory", l.memory_version},
+	};
+	size_t n = sizeof(vals) / sizeof(vals[0]);
+
+	if (json)
+		printf("{");
+	for (size_t i = 0; i < n; i++) {
+		if (json) {
+			printf("%s\"%s\":", i ? "," : "", vals[i].name);
+			if (vals[i].v < 0)
+				printf("null");
+			else
+				printf("%lld", vals[i].v);
+			continue;
+		}
+		printf("UARCH_");
+		for (const char *c = vals[i].name; *c; c++)
+			putchar(*c >= 'a' && *c <= 'z' ? *c - 'a' + 'A' : *c);
+		if (vals[i].v < 0)
+			printf("=\n");
+		else
+			printf("=%lld\n", vals[i].v);
+	}
+	if (json)
+		printf("}\n");
+	return 0;
+}
+#else
+static int print_topology(int json)
+{
+	(void)json;
+	fprintf(stderr, "CPU topology not available on this system\n");
+	return 1;
+}
+
+static int print_limits(int json)
+{
+	(void)json;
+	fprintf(stderr, "cgroup limits not available on this system\n");
+	return 1;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 	struct utsname un;
 	int show_original = 0;
+	int show_level = 0, show_march = 0, show_features = 0;
+	int topology = 0, limits = 0, json = 0;
 	int opt;
+	static const struct option longopts[] = {
+		{"topology", no_argument, NULL, 'T'},
+		{"limits", no_argument, NULL, 'L'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
 
-	while ((opt = getopt(argc, argv, "ah")) != -1) {
+	while ((opt = getopt_long(argc, argv, "alfmjh", longopts, NULL)) != -1) {
 		switch (opt) {
+		case 'T':
+			topology = 1;
+			break;
+		case 'L':
+			limits = 1;
+			break;
+		case 'j':
+			json = 1;
+			break;
 		case 'a':
 			show_original = 1;
 			break;
+		case 'l':
+			show_level = 1;
+			break;
+		case 'm':
+			show_march = 1;
+			break;
+		case 'f':
+			show_features = 1;
+			break;
 		case 'h':
 		default:
 			usage(argv[0]);
 		}
 	}
 
+	if (topology || limits) {
+		if (optind < argc || show_original || show_level ||
+		    show_march || show_features || (topology && limits)) {
+			usage(argv[0]);
+		}
+		return topology ? print_topology(json) : print_limits(json);
+	}
+	if (json) {
+		usage(argv[0]);
+	}
+	// CPU mode: describes the running CPU, not an architecture name
+	if (show_level || show_march || show_features) {
+		if (optind < argc || show_original) {
+			usage(argv[0]);
+		}
+		return print_cpu(show_level, show_march, show_features);
+	}
 	// Converter mode: arch name given as argument
 	if (optind < argc) {
 		print_arch(argv[optind], show_original);
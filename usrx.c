@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,14 +10,32 @@
 #include <libgen.h>
 #include <errno.h>
 #include <crypt.h>
+#include <pthread.h>
+#include <sched.h>
 #include <termios.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "acct_common.h"
+#include "acct_index.h"
+#include "acct_table.h"
+#include "hash_common.h"
+#include "out_common.h"
+
+// Account files, mapped once in main()
+static struct acct_db db;
 
 static void usage(const char *progname)
 {
 	fprintf(stderr, "Usage: %s COMMAND [OPTIONS] USER\n", progname);
+	fprintf(stderr, "       %s dump [-i]\n", progname);
+	fprintf(stderr, "       %s members [OPTIONS] GROUP|GID\n", progname);
+	fprintf(stderr, "       %s index build [PATH]\n", progname);
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr,
-		"  -j     Output in JSON format (only for info command)\n");
+		"  -o FMT Output as json, ndjson, tsv or text (info, groups,\n");
+	fprintf(stderr, "         members, dump)\n");
+	fprintf(stderr, "  -j     Same as -o json\n");
 	fprintf(stderr,
 		"  -i     Skip encrypted password in output (when insecure)\n");
 	fprintf(stderr, "Commands:\n");
@@ -28,6 +47,13 @@ static void usage(const char *progname)
 	fprintf(stderr, "  gid    - print primary group ID\n");
 	fprintf(stderr, "  group  - print primary group name\n");
 	fprintf(stderr, "  groups - print all groups\n");
+	fprintf(stderr,
+		"  members - print every user in a group, by primary gid or\n");
+	fprintf(stderr, "            member list\n");
+	fprintf(stderr,
+		"  dump   - print every user as one JSON object per line\n");
+	fprintf(stderr,
+		"           (same as info --all; shadow included for root)\n");
 	fprintf(stderr, "Root-only commands:\n");
 	fprintf(stderr, "  passwd - print encrypted password\n");
 	fprintf(stderr, "  days   - print password aging information\n");
@@ -35,294 +61,906 @@ static void usage(const char *progname)
 		"  check USER [PASSWORD] - verify if password is correct\n");
 	fprintf(stderr,
 		"                          (reads from stdin if PASSWORD not provided)\n");
+	fprintf(stderr,
+		"  check --batch - verify user<TAB>password lines from stdin,\n");
+	fprintf(stderr,
+		"                  printing user<TAB>ok|fail|unknown|invalid\n");
+	fprintf(stderr,
+		"  hashaudit [-t] [-s] - rate every shadow hash by algorithm and\n");
+	fprintf(stderr,
+		"                        cost, then total each pair; -t times one\n");
+	fprintf(stderr,
+		"                        verification per pair, -s prints totals only\n");
+	fprintf(stderr,
+		"  index build [PATH] - write the account index used by suex\n");
+	fprintf(stderr, "                       and sush (default %s)\n",
+		ACCT_INDEX_FILE);
 
 	exit(1);
 }
 
+// Standard output, written one record at a time
+static struct out out = {.fd = STDOUT_FILENO };
+
 static void print_shadow_days(const struct spwd *sp)
 {
-	printf("Last password change (days since Jan 1, 1970): %ld\n",
-	       sp->sp_lstchg);
-	printf("Minimum days between password changes: %ld\n", sp->sp_min);
-	printf("Maximum days between password changes: %ld\n", sp->sp_max);
-	printf("Warning days before password expires: %ld\n", sp->sp_warn);
-	printf
-	    ("Days after password expires until account becomes inactive: %ld\n",
-	     sp->sp_inact);
-	printf("Account expiration date (days since Jan 1, 1970): %ld\n",
-	       sp->sp_expire);
+	struct acct_spent spe;
+
+	acct_sp_view(sp, &spe);
+	out_shadow_days(&out, &spe);
 }
 
-// Helper function to print JSON string with proper escaping
-static void print_json_string(const char *str)
+static void print_groups(const char *username, gid_t primary_gid,
+			 enum out_format format)
 {
-	printf("\"");
-	for (const char *p = str; *p; p++) {
-		switch (*p) {
-		case '"':
-			printf("\\\"");
-			break;
-		case '\\':
-			printf("\\\\");
-			break;
-		case '\b':
-			printf("\\b");
-			break;
-		case '\f':
-			printf("\\f");
-			break;
-		case '\n':
-			printf("\\n");
-			break;
-		case '\r':
-			printf("\\r");
-			break;
-		case '\t':
-			printf("\\t");
-			break;
-		default:
-			if ((unsigned char)*p >= 32 && (unsigned char)*p <= 126) {
-				putchar(*p);
-			} else {
-				printf("\\u%04x", (unsigned char)*p);
-			}
-		}
+	int n;
+	struct acct_gname *g;
+
+	if (acct_getgroupnames(&db, username, primary_gid, &g, &n) < 0) {
+		fprintf(stderr, "Failed to get groups\n");
+		return;
 	}
-	printf("\"");
+	out_groups(&out, format, g, n);
+	acct_gnames_free(g, n);
 }
 
-// Helper function to get groups for a user
-static gid_t *get_user_groups(const char *username, gid_t primary_gid,
-			      int *ngroups)
+/*
+ * Print everyone in a group: users with it as their primary group, who
+ * never appear in its member list, as well as the listed ones.
+ */
+static int print_members(const char *group, enum out_format format)
 {
-	*ngroups = 0;
+	struct acct_grent gr;
+	struct acct_member *m;
+	int n;
 
-	// Get number of groups
-	getgrouplist(username, primary_gid, NULL, ngroups);
-
-	gid_t *groups = malloc(*ngroups * sizeof(gid_t));
-	if (groups == NULL) {
-		return NULL;
+	if (acct_getmembers(&db, group, &gr, &m, &n) < 0) {
+		if (errno == ENOENT) {
+			fprintf(stderr, "Group '%s' not found\n", group);
+		} else {
+			fprintf(stderr, "Failed to get members\n");
+		}
+		return 1;
 	}
+	out_members(&out, format, m, n);
+	free(m);
 
-	if (getgrouplist(username, primary_gid, groups, ngroups) == -1) {
-		free(groups);
-		return NULL;
+	if (out_flush(&out) < 0) {
+		fprintf(stderr, "Failed to write output\n");
+		return 1;
 	}
-
-	return groups;
+	return 0;
 }
 
-static void print_groups(const char *username, gid_t primary_gid)
+/*
+ * Print every user, by default as one JSON object per line.  The whole
+ * database is loaded once, so nothing is looked up per user.  -o json
+ * prints one array, text the info blocks separated by blank lines.
+ */
+static int dump_users(enum out_format format, int skip_password)
 {
-	int ngroups;
-	gid_t *groups = get_user_groups(username, primary_gid, &ngroups);
+	struct acct_table t;
+	struct acct_gname *g = NULL;
+	int cap = 0;
+	int is_root = (getuid() == 0);
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
 
-	if (groups == NULL) {
-		fprintf(stderr, "Failed to get groups\n");
-		return;
+	if (acct_table_load(&t, &db, ncpu > 0 ? ncpu : 1) < 0) {
+		fprintf(stderr, "Failed to load account database\n");
+		return 1;
 	}
 
-	printf("Groups: ");
-	int first = 1;
-	for (int i = 0; i < ngroups; i++) {
-		if (groups[i] == primary_gid && !first) {
-			continue;
+	for (size_t i = 0; i < t.nusers; i++) {
+		const struct acct_user *u = &t.users[i];
+		const struct acct_grent *gr = acct_table_group(&t, u->pw.gid);
+		int nmem, n = 0;
+		const gid_t *mem = acct_table_memberships(&t, u, &nmem);
+
+		if (nmem + 1 > cap) {
+			struct acct_gname *tmp = realloc(g, (nmem + 1) *
+							  sizeof(*g));
+			if (tmp == NULL) {
+				fprintf(stderr, "Memory allocation failed\n");
+				free(g);
+				acct_table_free(&t);
+				return 1;
+			}
+			g = tmp;
+			cap = nmem + 1;
 		}
-		struct group *gr = getgrgid(groups[i]);
-		if (gr != NULL) {
-			if (!first) {
-				printf(", ");
+
+		// Same list as getgrouplist(): primary first, no repeats
+		for (int j = -1; j < nmem; j++) {
+			gid_t gid = j < 0 ? u->pw.gid : mem[j];
+			int dup = 0;
+
+			if (j >= 0 && gid == u->pw.gid) {
+				continue;
+			}
+			for (int k = 0; k < n && !dup; k++) {
+				dup = g[k].gid == gid;
+			}
+			const struct acct_grent *e = acct_table_group(&t, gid);
+			if (dup || e == NULL) {
+				continue;
 			}
-			printf("%s(%d)", gr->gr_name, groups[i]);
-			first = 0;
+			g[n].gid = gid;
+			g[n].name = e->name;
+			g[n].storage = NULL;
+			n++;
 		}
+
+		struct out_user rec = {
+			.pw = &u->pw,
+			.group = gr ? &gr->name : NULL,
+			.groups = g,
+			.ngroups = n,
+			.sp = is_root ? acct_table_shadow(&t, u) : NULL,
+			.show_shadow = is_root,
+			.skip_password = skip_password,
+		};
+		if (format == OUT_JSON) {
+			out_puts(&out, i > 0 ? ",\n" : "[\n");
+			out_user_json(&out, &rec, 1);
+		} else {
+			if (format == OUT_TEXT && i > 0) {
+				out_puts(&out, "\n");
+			}
+			out_user(&out, format, &rec);
+		}
+		out_end_record(&out);
+	}
+	if (format == OUT_JSON) {
+		out_puts(&out, t.nusers > 0 ? "\n]\n" : "[]\n");
 	}
-	printf("\n");
 
-	free(groups);
+	free(g);
+	acct_table_free(&t);
+	if (out_flush(&out) < 0) {
+		fprintf(stderr, "Failed to write output\n");
+		return 1;
+	}
+	return 0;
 }
 
-static void print_groups_json(const char *username, gid_t primary_gid)
+/*
+ * Write the index suex and sush read instead of scanning the files.  It
+ * goes stale as soon as passwd, group or shadow change, so rebuild it
+ * after account changes.
+ */
+static int build_index(const char *path)
 {
-	int ngroups;
-	gid_t *groups = get_user_groups(username, primary_gid, &ngroups);
+	struct acct_table t;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
 
-	if (groups == NULL) {
-		printf("[]");
-		return;
+	if (getuid() != 0) {
+		fprintf(stderr, "This command requires root privileges\n");
+		return 1;
+	}
+	// A missing shadow file is recorded as missing
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP | ACCT_SHADOW);
+	if (!db.passwd.data || !db.group.data) {
+		fprintf(stderr, "Failed to read %s and %s\n", ACCT_PASSWD_FILE,
+			ACCT_GROUP_FILE);
+		return 1;
+	}
+	if (acct_table_load(&t, &db, ncpu > 0 ? ncpu : 1) < 0) {
+		fprintf(stderr, "Failed to load account database\n");
+		return 1;
 	}
 
-	printf("[");
-	int first = 1;
-	for (int i = 0; i < ngroups; i++) {
-		if (groups[i] == primary_gid && !first) {
-			continue;
-		}
-		struct group *gr = getgrgid(groups[i]);
-		if (gr != NULL) {
-			if (!first) {
-				printf(",");
-			}
-			printf("{\"name\":");
-			print_json_string(gr->gr_name);
-			printf(",\"gid\":%d}", groups[i]);
-			first = 0;
-		}
+	char *dir = strdup(path);
+	if (dir == NULL) {
+		fprintf(stderr, "Memory allocation failed\n");
+		acct_table_free(&t);
+		return 1;
 	}
-	printf("]");
+	if (mkdir(dirname(dir), 0755) < 0 && errno != EEXIST) {
+		fprintf(stderr, "Failed to create %s: %s\n", dir,
+			strerror(errno));
+		free(dir);
+		acct_table_free(&t);
+		return 1;
+	}
+	free(dir);
 
-	free(groups);
+	int ret = acct_index_write(&t, &db, path);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to write %s: %s\n", path,
+			strerror(errno));
+	}
+	acct_table_free(&t);
+	return ret < 0 ? 1 : 0;
 }
 
-static void print_user_info_json(const char *username, int skip_password)
+static void print_user_info(const char *username, enum out_format format,
+			    int skip_password)
 {
 	struct passwd *pw;
 	struct group *gr;
-	struct spwd *sp;
+	struct spwd *sp = NULL;
+	struct acct_pwent pwe;
+	struct acct_spent spe;
+	struct acct_str group;
+	struct acct_gname *groups = NULL;
 	int is_root = (getuid() == 0);
+	int ngroups;
 
-	pw = getpwnam(username);
+	pw = acct_getpwnam(&db, username);
 	if (pw == NULL) {
-		printf("{\"error\":\"User '%s' not found\"}\n", username);
+		fprintf(stderr, "User '%s' not found\n", username);
 		return;
 	}
+	acct_pw_view(pw, &pwe);
 
-	printf("{\n");
-	printf("  \"user\":");
-	print_json_string(pw->pw_name);
-	printf(",\n");
-
-	gr = getgrgid(pw->pw_gid);
+	gr = acct_getgrgid(&db, pw->pw_gid);
 	if (gr != NULL) {
-		printf("  \"group\":");
-		print_json_string(gr->gr_name);
-		printf(",\n");
+		group.s = gr->gr_name;
+		group.len = strlen(gr->gr_name);
+	}
+	if (acct_getgroupnames(&db, username, pw->pw_gid, &groups,
+			       &ngroups) < 0) {
+		// Text output leaves the groups out, JSON lists none
+		if (format == OUT_TEXT) {
+			fprintf(stderr, "Failed to get groups\n");
+		}
+		groups = NULL;
+		ngroups = -1;
+	}
+	if (is_root) {
+		sp = acct_getspnam(&db, username);
+		if (sp != NULL) {
+			acct_sp_view(sp, &spe);
+		}
 	}
 
-	printf("  \"uid\":%u,\n", pw->pw_uid);
-	printf("  \"gid\":%u,\n", pw->pw_gid);
+	struct out_user u = {
+		.pw = &pwe,
+		.group = gr ? &group : NULL,
+		.groups = groups,
+		.ngroups = ngroups,
+		.sp = sp ? &spe : NULL,
+		.show_shadow = is_root,
+		.skip_password = skip_password,
+	};
+	out_user(&out, format, &u);
 
-	printf("  \"home\":");
-	print_json_string(pw->pw_dir);
-	printf(",\n");
-	printf("  \"shell\":");
-	print_json_string(pw->pw_shell);
-	printf(",\n");
+	acct_gnames_free(groups, ngroups > 0 ? ngroups : 0);
+	free(sp);
+	free(gr);
+	free(pw);
+}
 
-	if (pw->pw_gecos && strlen(pw->pw_gecos) > 0) {
-		printf("  \"gecos\":");
-		print_json_string(pw->pw_gecos);
-		printf(",\n");
+static int verify_password(const char *username, const char *password)
+{
+	struct spwd *sp;
+	char *encrypted;
+
+	if (getuid() != 0) {
+		fprintf(stderr, "This command requires root privileges\n");
+		return 1;
 	}
 
-	printf("  \"groups\":");
-	print_groups_json(username, pw->pw_gid);
+	sp = acct_getspnam(&db, username);
+	if (sp == NULL) {
+		fprintf(stderr, "Failed to get shadow entry for '%s'\n",
+			username);
+		return 1;
+	}
+	// Encrypt the provided password with the salt from the shadow file
+	encrypted = crypt(password, sp->sp_pwdp);
+	if (encrypted == NULL) {
+		fprintf(stderr, "crypt() failed\n");
+		free(sp);
+		return 1;
+	}
+	// Compare the encrypted password with the one from shadow file
+	int result = strcmp(encrypted, sp->sp_pwdp) == 0 ? 0 : 1;
+	free(sp);
+	return result;
+}
 
-	if (is_root) {
-		sp = getspnam(username);
-		if (sp != NULL) {
-			printf(",\n  \"shadow\": {\n");
-			if (!skip_password) {
-				printf("    \"encrypted_password\":");
-				print_json_string(sp->sp_pwdp);
-				printf(",\n");
-			}
-			printf("    \"last_change\":%ld,\n", sp->sp_lstchg);
-			printf("    \"min_days\":%ld,\n", sp->sp_min);
-			printf("    \"max_days\":%ld,\n", sp->sp_max);
-			printf("    \"warn_days\":%ld,\n", sp->sp_warn);
-			printf("    \"inactive_days\":%ld,\n", sp->sp_inact);
-			printf("    \"expiration\":%ld\n", sp->sp_expire);
-			printf("  }");
+/*
+ * check --batch reads "user<TAB>password" lines in chunks of up to
+ * BATCH_BYTES and BATCH_LINES, verifies each chunk on a thread pool and
+ * prints one "user<TAB>result" line per input line, in input order.
+ * Input is read with read() into one fixed buffer, so passwords exist
+ * only there and in each thread's crypt_data, and both are wiped.
+ */
+#define BATCH_BYTES (1 << 20)
+#define BATCH_LINES 4096
+#define BATCH_MAX_THREADS 256
+
+enum check_result {
+	CHECK_MATCH,
+	CHECK_FAIL,
+	CHECK_UNKNOWN,
+	CHECK_INVALID,
+};
+
+static const char *const check_results[] = {
+	[CHECK_MATCH] = "ok",
+	[CHECK_FAIL] = "fail",
+	[CHECK_UNKNOWN] = "unknown",
+	[CHECK_INVALID] = "invalid",
+};
+
+struct check_job {
+	const char *user;
+	size_t ulen;
+	const char *password;	// NUL-terminated, in the input buffer
+	enum check_result result;
+};
+
+struct check_batch {
+	const struct acct_table *t;
+	struct check_job *jobs;
+	size_t njobs;
+	size_t next;		// next job to take, shared by the workers
+};
+
+static enum check_result check_one(const struct acct_table *t,
+				   const struct check_job *job,
+				   struct crypt_data *cd)
+{
+	char setting[512];
+
+	if (!job->password) {
+		return CHECK_INVALID;
+	}
+	const struct acct_user *u = acct_table_user(t, job->user, job->ulen);
+	const struct acct_spent *sp = u ? acct_table_shadow(t, u) : NULL;
+	if (sp == NULL) {
+		return CHECK_UNKNOWN;
+	}
+	// The mapped field is not NUL-terminated; hashes are short
+	if (sp->pwdp.len >= sizeof(setting)) {
+		return CHECK_FAIL;
+	}
+	memcpy(setting, sp->pwdp.s, sp->pwdp.len);
+	setting[sp->pwdp.len] = '\0';
+
+	const char *encrypted = crypt_r(job->password, setting, cd);
+	if (encrypted == NULL || strlen(encrypted) != sp->pwdp.len ||
+	    memcmp(encrypted, sp->pwdp.s, sp->pwdp.len) != 0) {
+		return CHECK_FAIL;
+	}
+	return CHECK_MATCH;
+}
+
+static void *check_worker(void *arg)
+{
+	struct check_batch *b = arg;
+	// crypt_data is large with libxcrypt, so not on the stack
+	struct crypt_data *cd = calloc(1, sizeof(*cd));
+
+	for (;;) {
+		size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+		if (i >= b->njobs) {
+			break;
 		}
+		b->jobs[i].result = cd ? check_one(b->t, &b->jobs[i], cd)
+		    : CHECK_FAIL;
+	}
+	if (cd) {
+		explicit_bzero(cd, sizeof(*cd));
+		free(cd);
 	}
-	printf("\n}\n");
+	return NULL;
 }
 
-static void print_user_info_text(const char *username, int skip_password)
+static void check_jobs(struct check_batch *b, int nthreads)
 {
-	struct passwd *pw;
-	struct group *gr;
-	struct spwd *sp;
-	int is_root = (getuid() == 0);
+	pthread_t tids[BATCH_MAX_THREADS];
+	int started = 0;
 
-	pw = getpwnam(username);
-	if (pw == NULL) {
-		fprintf(stderr, "User '%s' not found\n", username);
-		return;
+	b->next = 0;
+	if ((size_t)nthreads > b->njobs) {
+		nthreads = b->njobs;
 	}
+	for (int i = 1; i < nthreads; i++) {
+		if (pthread_create(&tids[started], NULL, check_worker, b) != 0) {
+			break;
+		}
+		started++;
+	}
+	// The main thread works too, so a failed pthread_create() only
+	// means fewer workers
+	check_worker(b);
+	for (int i = 0; i < started; i++) {
+		pthread_join(tids[i], NULL);
+	}
+}
 
-	printf("User Information for '%s':\n", username);
-	printf("------------------------\n");
-	printf("Username: %s\n", pw->pw_name);
-	printf("User ID: %u\n", pw->pw_uid);
-	printf("Primary group ID: %u\n", pw->pw_gid);
+// CPUs this process may run on, which can be fewer than are online
+static int available_cpus(void)
+{
+	cpu_set_t set;
 
-	gr = getgrgid(pw->pw_gid);
-	if (gr != NULL) {
-		printf("Primary group name: %s\n", gr->gr_name);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		return CPU_COUNT(&set);
 	}
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
 
-	printf("Home directory: %s\n", pw->pw_dir);
-	printf("Shell: %s\n", pw->pw_shell);
+// Split "user<TAB>password" in place; a line without a tab is invalid
+static void parse_check_line(char *line, size_t len, struct check_job *job)
+{
+	if (len > 0 && line[len - 1] == '\r') {
+		len--;
+	}
+	line[len] = '\0';
+	char *tab = memchr(line, '\t', len);
+	job->user = line;
+	job->ulen = tab ? (size_t)(tab - line) : 0;
+	job->password = tab ? tab + 1 : NULL;
+}
 
-	if (pw->pw_gecos && strlen(pw->pw_gecos) > 0) {
-		printf("GECOS: %s\n", pw->pw_gecos);
+static void print_check_results(const struct check_job *jobs, size_t n,
+				int *all_matched)
+{
+	for (size_t i = 0; i < n; i++) {
+		out_tsv_field(&out, jobs[i].user, jobs[i].ulen);
+		out_puts(&out, "\t");
+		out_puts(&out, check_results[jobs[i].result]);
+		out_puts(&out, "\n");
+		out_end_record(&out);
+		if (jobs[i].result != CHECK_MATCH) {
+			*all_matched = 0;
+		}
 	}
+}
 
-	print_groups(username, pw->pw_gid);
+/*
+ * Verify every line of stdin against shadow, loaded once.  Exits 0 when
+ * every password matched, like check for a single user, 1 otherwise.
+ */
+static int check_batch(void)
+{
+	struct acct_table t;
+	struct check_batch b = {.t = &t };
+	int nthreads = available_cpus();
+	int all_matched = 1, eof = 0, skipping = 0, ret = 0;
+	size_t len = 0;
 
-	if (is_root) {
-		printf("\nShadow Information (root only):\n");
-		printf("-----------------------------\n");
-		sp = getspnam(username);
-		if (sp != NULL) {
-			if (!skip_password) {
-				printf("Encrypted password: %s\n", sp->sp_pwdp);
+	if (getuid() != 0) {
+		fprintf(stderr, "This command requires root privileges\n");
+		return 1;
+	}
+	if (nthreads > BATCH_MAX_THREADS) {
+		nthreads = BATCH_MAX_THREADS;
+	}
+	acct_open(&db, ACCT_PASSWD | ACCT_SHADOW);
+	if (acct_table_load(&t, &db, nthreads) < 0) {
+		fprintf(stderr, "Failed to load account database\n");
+		return 1;
+	}
+	char *buf = malloc(BATCH_BYTES + 1);
+	b.jobs = malloc(BATCH_LINES * sizeof(*b.jobs));
+	if (buf == NULL || b.jobs == NULL) {
+		fprintf(stderr, "Memory allocation failed\n");
+		free(buf);
+		free(b.jobs);
+		acct_table_free(&t);
+		return 1;
+	}
+
+	while (!eof || len > 0) {
+		while (!eof && len < BATCH_BYTES) {
+			ssize_t n = read(STDIN_FILENO, buf + len,
+					 BATCH_BYTES - len);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n < 0) {
+				fprintf(stderr, "Failed to read stdin: %s\n",
+					strerror(errno));
+				ret = 1;
+			}
+			if (n <= 0) {
+				eof = 1;
+			} else {
+				len += n;
 			}
-			printf("Password Aging Information:\n");
-			print_shadow_days(sp);
-		} else {
-			printf("No shadow information available\n");
 		}
+
+		// Complete lines, plus an unterminated last one at EOF
+		size_t used = 0;
+		b.njobs = 0;
+		while (used < len && b.njobs < BATCH_LINES) {
+			char *line = buf + used;
+			char *nl = memchr(line, '\n', len - used);
+			if (nl == NULL && !eof) {
+				break;
+			}
+			size_t llen = nl ? (size_t)(nl - line) : len - used;
+			used += llen + (nl != NULL);
+			if (skipping) {
+				// The rest of a line longer than the buffer
+				skipping = 0;
+				continue;
+			}
+			parse_check_line(line, llen, &b.jobs[b.njobs++]);
+		}
+		if (used == 0 && len == BATCH_BYTES) {
+			// No newline in a full buffer: report the line once
+			// and drop it up to its newline
+			if (!skipping) {
+				buf[len] = '\0';
+				parse_check_line(buf, 0, &b.jobs[b.njobs++]);
+			}
+			skipping = 1;
+			used = len;
+		}
+
+		check_jobs(&b, nthreads);
+		print_check_results(b.jobs, b.njobs, &all_matched);
+
+		// Wipe the consumed passwords before reusing the buffer
+		explicit_bzero(buf, used);
+		memmove(buf, buf + used, len - used);
+		explicit_bzero(buf + len - used, used);
+		len -= used;
 	}
+
+	explicit_bzero(buf, BATCH_BYTES + 1);
+	free(buf);
+	free(b.jobs);
+	acct_table_free(&t);
+	if (out_flush(&out) < 0) {
+		fprintf(stderr, "Failed to write output\n");
+		return 1;
+	}
+	return ret || !all_matched;
 }
 
-static void print_user_info(const char *username, int json_output,
-			    int skip_password)
+/*
+ * hashaudit: classify every shadow hash by algorithm and cost.  With -t
+ * one hash of each algorithm/cost pair is computed on the check pool's
+ * threads and its CPU time reported for every account using that pair.
+ */
+struct audit_pair {
+	struct hash_info h;
+	const char *setting;	// the first hash seen with this pair
+	size_t setting_len;
+	int accounts;
+	long verify_ns;		// -1 when not timed or unsupported
+};
+
+struct audit_account {
+	struct acct_str name;
+	int pair;
+	int locked;
+};
+
+struct audit_timing {
+	struct audit_pair *pairs;
+	int npairs;
+	int next;
+};
+
+static long thread_cpu_ns(void)
 {
-	if (json_output) {
-		print_user_info_json(username, skip_password);
-	} else {
-		print_user_info_text(username, skip_password);
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void *audit_worker(void *arg)
+{
+	struct audit_timing *at = arg;
+	struct crypt_data *cd = calloc(1, sizeof(*cd));
+	char setting[512];
+
+	for (;;) {
+		int i = __atomic_fetch_add(&at->next, 1, __ATOMIC_RELAXED);
+		if (i >= at->npairs || cd == NULL) {
+			break;
+		}
+		struct audit_pair *p = &at->pairs[i];
+		if (p->h.rating == HASH_NONE || p->h.rating == HASH_DISABLED ||
+		    p->setting_len >= sizeof(setting)) {
+			continue;
+		}
+		memcpy(setting, p->setting, p->setting_len);
+		setting[p->setting_len] = '\0';
+
+		long start = thread_cpu_ns();
+		const char *hash = crypt_r("hashaudit", setting, cd);
+		long ns = thread_cpu_ns() - start;
+		// Failures come back as NULL or "*0"/"*1" depending on libc
+		p->verify_ns = hash && hash[0] != '*' ? ns : -1;
 	}
+	free(cd);
+	return NULL;
 }
 
-static int verify_password(const char *username, const char *password)
+static void time_pairs(struct audit_pair *pairs, int npairs)
 {
-	struct spwd *sp;
-	char *encrypted;
+	struct audit_timing at = {.pairs = pairs, .npairs = npairs };
+	pthread_t tids[BATCH_MAX_THREADS];
+	int nthreads = available_cpus(), started = 0;
+
+	if (nthreads > npairs) {
+		nthreads = npairs;
+	}
+	if (nthreads > BATCH_MAX_THREADS) {
+		nthreads = BATCH_MAX_THREADS;
+	}
+	for (int i = 1; i < nthreads; i++) {
+		if (pthread_create(&tids[started], NULL, audit_worker, &at) != 0) {
+			break;
+		}
+		started++;
+	}
+	audit_worker(&at);
+	for (int i = 0; i < started; i++) {
+		pthread_join(tids[i], NULL);
+	}
+}
+
+// Milliseconds with three decimals, as a JSON number or text
+static void out_ms(long ns)
+{
+	char frac[4];
+	long us = ns / 1000;
+
+	out_long(&out, us / 1000);
+	frac[0] = '.';
+	frac[1] = '0' + us % 1000 / 100;
+	frac[2] = '0' + us % 100 / 10;
+	frac[3] = '0' + us % 10;
+	out_put(&out, frac, 4);
+}
+
+// s left-aligned in width columns, for the text table
+static void out_column(const char *s, size_t len, size_t width)
+{
+	static const char spaces[] = "                        ";
+
+	out_put(&out, s, len);
+	if (len < width) {
+		out_put(&out, spaces, width - len < sizeof(spaces) - 1 ?
+			width - len : sizeof(spaces) - 1);
+	}
+	out_put(&out, " ", 1);
+}
+
+/*
+ * One report line: an account when name is set, else an algorithm/cost
+ * pair with its number of accounts.  Pair lines are marked in NDJSON
+ * with "summary":true and in TSV with "*" for the user.
+ */
+static void print_audit_row(enum out_format format,
+			    const struct acct_str *name,
+			    const struct audit_pair *p, int locked, int timed,
+			    int first)
+{
+	const char *rating = hash_rating_name(p->h.rating);
+	const char *lock = locked ? "yes" : "no";
+
+	switch (format) {
+	case OUT_JSON:
+	case OUT_NDJSON:
+		if (format == OUT_JSON) {
+			out_puts(&out, first ? "\n" : ",\n");
+		}
+		out_put(&out, "{", 1);
+		if (!name && format == OUT_NDJSON) {
+			out_puts(&out, "\"summary\":true,");
+		}
+		if (name) {
+			out_puts(&out, "\"user\":");
+			out_json_string(&out, name->s, name->len);
+			out_put(&out, ",", 1);
+		}
+		out_puts(&out, "\"algorithm\":\"");
+		out_puts(&out, p->h.algo);
+		out_puts(&out, "\",\"cost\":");
+		out_json_string(&out, p->h.cost, strlen(p->h.cost));
+		out_puts(&out, ",\"rating\":\"");
+		out_puts(&out, rating);
+		out_puts(&out, "\"");
+		if (name) {
+			out_puts(&out, ",\"locked\":");
+			out_puts(&out, locked ? "true" : "false");
+		} else {
+			out_puts(&out, ",\"accounts\":");
+			out_long(&out, p->accounts);
+		}
+		if (timed) {
+			out_puts(&out, ",\"verify_ms\":");
+			if (p->verify_ns >= 0) {
+				out_ms(p->verify_ns);
+			} else {
+				out_puts(&out, "null");
+			}
+		}
+		out_puts(&out, format == OUT_JSON ? "}" : "}\n");
+		break;
+	case OUT_TSV:
+	case OUT_TEXT:
+		if (format == OUT_TEXT && first) {
+			if (name) {
+				out_column("USER", 4, 16);
+			}
+			out_column("ALGORITHM", 9, 13);
+			out_column("COST", 4, 10);
+			out_column("RATING", 6, 8);
+			out_column(name ? "LOCKED" : "ACCOUNTS", name ? 6 : 8,
+				   8);
+			out_puts(&out, timed ? "VERIFY_MS\n" : "\n");
+		}
+		if (format == OUT_TSV) {
+			if (name) {
+				out_tsv_field(&out, name->s, name->len);
+			} else {
+				out_put(&out, "*", 1);
+			}
+			out_put(&out, "\t", 1);
+			out_puts(&out, p->h.algo);
+			out_put(&out, "\t", 1);
+			out_puts(&out, p->h.cost);
+			out_put(&out, "\t", 1);
+			out_puts(&out, rating);
+			out_put(&out, "\t", 1);
+			if (name) {
+				out_puts(&out, lock);
+			} else {
+				out_long(&out, p->accounts);
+			}
+		} else {
+			char count[24];
+			if (name) {
+				out_column(name->s, name->len, 16);
+			}
+			out_column(p->h.algo, strlen(p->h.algo), 13);
+			out_column(p->h.cost[0] ? p->h.cost : "-",
+				   p->h.cost[0] ? strlen(p->h.cost) : 1, 10);
+			out_column(rating, strlen(rating), 8);
+			if (name) {
+				out_column(lock, strlen(lock), 8);
+			} else {
+				snprintf(count, sizeof(count), "%d",
+					 p->accounts);
+				out_column(count, strlen(count), 8);
+			}
+		}
+		if (timed) {
+			if (format == OUT_TSV) {
+				out_put(&out, "\t", 1);
+			}
+			if (p->verify_ns >= 0) {
+				out_ms(p->verify_ns);
+			} else if (format == OUT_TEXT) {
+				out_put(&out, "-", 1);
+			}
+		}
+		out_put(&out, "\n", 1);
+		break;
+	}
+	out_end_record(&out);
+}
+
+/*
+ * Report every shadow entry, then the algorithm/cost pairs and how many
+ * accounts use each; summary_only leaves out the entries.  JSON is one
+ * object with an "accounts" and a "summary" array.
+ */
+static int hash_audit(enum out_format format, int timed, int summary_only)
+{
+	struct acct_iter it;
+	struct acct_spent e;
+	struct audit_account *acc = NULL;
+	struct audit_pair *pairs = NULL;
+	size_t nacc = 0, acc_cap = 0;
+	int npairs = 0, pair_cap = 0;
 
 	if (getuid() != 0) {
 		fprintf(stderr, "This command requires root privileges\n");
 		return 1;
 	}
-
-	sp = getspnam(username);
-	if (sp == NULL) {
-		fprintf(stderr, "Failed to get shadow entry for '%s'\n",
-			username);
+	if (acct_open(&db, ACCT_SHADOW) < 0 || !db.shadow.data) {
+		fprintf(stderr, "Failed to read %s\n", ACCT_SHADOW_FILE);
 		return 1;
 	}
-	// Encrypt the provided password with the salt from the shadow file
-	encrypted = crypt(password, sp->sp_pwdp);
-	if (encrypted == NULL) {
-		fprintf(stderr, "crypt() failed\n");
+
+	acct_iter_init(&it, &db.shadow);
+	while (acct_next_sp(&it, &e)) {
+		struct hash_info h;
+		int i;
+
+		hash_parse(e.pwdp.s, e.pwdp.len, &h);
+		for (i = 0; i < npairs; i++) {
+			if (pairs[i].h.algo == h.algo &&
+			    strcmp(pairs[i].h.cost, h.cost) == 0) {
+				break;
+			}
+		}
+		if (i == npairs) {
+			if (npairs == pair_cap) {
+				pair_cap = pair_cap ? pair_cap * 2 : 16;
+				void *tmp = realloc(pairs,
+						    pair_cap * sizeof(*pairs));
+				if (tmp == NULL) {
+					goto nomem;
+				}
+				pairs = tmp;
+			}
+			// Time the hash itself, without any '!' lock prefix
+			size_t skip = 0;
+			while (skip < e.pwdp.len && e.pwdp.s[skip] == '!') {
+				skip++;
+			}
+			pairs[npairs].h = h;
+			pairs[npairs].setting = e.pwdp.s + skip;
+			pairs[npairs].setting_len = e.pwdp.len - skip;
+			pairs[npairs].accounts = 0;
+			pairs[npairs].verify_ns = -1;
+			npairs++;
+		}
+		pairs[i].accounts++;
+
+		if (nacc == acc_cap) {
+			acc_cap = acc_cap ? acc_cap * 2 : 256;
+			void *tmp = realloc(acc, acc_cap * sizeof(*acc));
+			if (tmp == NULL) {
+				goto nomem;
+			}
+			acc = tmp;
+		}
+		acc[nacc].name = e.name;
+		acc[nacc].pair = i;
+		acc[nacc].locked = h.locked;
+		nacc++;
+	}
+
+	if (timed && npairs > 0) {
+		time_pairs(pairs, npairs);
+	}
+	if (format == OUT_JSON) {
+		out_puts(&out, "{\n");
+	}
+	if (!summary_only) {
+		if (format == OUT_JSON) {
+			out_puts(&out, "\"accounts\": [");
+		}
+		for (size_t i = 0; i < nacc; i++) {
+			print_audit_row(format, &acc[i].name,
+					&pairs[acc[i].pair], acc[i].locked,
+					timed, i == 0);
+		}
+		if (format == OUT_JSON) {
+			out_puts(&out, nacc > 0 ? "\n],\n" : "],\n");
+		} else if (format == OUT_TEXT && nacc > 0) {
+			out_puts(&out, "\n");
+		}
+	}
+	if (format == OUT_JSON) {
+		out_puts(&out, "\"summary\": [");
+	}
+	for (int i = 0; i < npairs; i++) {
+		print_audit_row(format, NULL, &pairs[i], 0, timed, i == 0);
+	}
+	if (format == OUT_JSON) {
+		out_puts(&out, npairs > 0 ? "\n]\n}\n" : "]\n}\n");
+	}
+
+	free(acc);
+	free(pairs);
+	if (out_flush(&out) < 0) {
+		fprintf(stderr, "Failed to write output\n");
 		return 1;
 	}
-	// Compare the encrypted password with the one from shadow file
-	return strcmp(encrypted, sp->sp_pwdp) == 0 ? 0 : 1;
+	return 0;
+
+ nomem:
+	fprintf(stderr, "Memory allocation failed\n");
+	free(acc);
+	free(pairs);
+	return 1;
 }
 
 static char *read_password(void)
@@ -379,8 +1017,105 @@ static char *read_password(void)
 	return password;
 }
 
+static enum out_format parse_format(char *progname, const char *name)
+{
+	int format = out_parse_format(name);
+
+	if (format < 0) {
+		fprintf(stderr, "Unknown output format '%s'\n", name);
+		usage(basename(progname));
+	}
+	return format;
+}
+
+// Check if the info/dump arguments ask for every user
+static int wants_all_users(int argc, char *argv[])
+{
+	if (strcmp(argv[1], "dump") == 0) {
+		return 1;
+	}
+	if (strcmp(argv[1], "info") != 0) {
+		return 0;
+	}
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--all") == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
+	if (argc < 2) {
+		usage(basename(argv[0]));
+	}
+	if (strcmp(argv[1], "index") == 0) {
+		if (argc < 3 || argc > 4 || strcmp(argv[2], "build") != 0) {
+			usage(basename(argv[0]));
+		}
+		return build_index(argc == 4 ? argv[3] : ACCT_INDEX_FILE);
+	}
+	if (strcmp(argv[1], "hashaudit") == 0) {
+		enum out_format format = OUT_TEXT;
+		int timed = 0, summary_only = 0;
+
+		for (int i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "-t") == 0) {
+				timed = 1;
+			} else if (strcmp(argv[i], "-s") == 0) {
+				summary_only = 1;
+			} else if (strcmp(argv[i], "-j") == 0) {
+				format = OUT_JSON;
+			} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+				format = parse_format(argv[0], argv[++i]);
+			} else {
+				usage(basename(argv[0]));
+			}
+		}
+		return hash_audit(format, timed, summary_only);
+	}
+	if (strcmp(argv[1], "members") == 0) {
+		enum out_format format = OUT_TEXT;
+		int i = 2;
+
+		for (; i < argc - 1; i++) {
+			if (strcmp(argv[i], "-j") == 0) {
+				format = OUT_JSON;
+			} else if (strcmp(argv[i], "-o") == 0 && i + 2 < argc) {
+				format = parse_format(argv[0], argv[++i]);
+			} else {
+				break;
+			}
+		}
+		if (i != argc - 1) {
+			usage(basename(argv[0]));
+		}
+		acct_open(&db, ACCT_PASSWD | ACCT_GROUP);
+		return print_members(argv[i], format);
+	}
+	if (strcmp(argv[1], "check") == 0 && argc == 3 &&
+	    strcmp(argv[2], "--batch") == 0) {
+		return check_batch();
+	}
+	// Bulk mode: every user as NDJSON, no USER argument
+	if (wants_all_users(argc, argv)) {
+		enum out_format format = OUT_NDJSON;
+		int skip_password = 0;
+
+		for (int i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "-i") == 0) {
+				skip_password = 1;
+			} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+				format = parse_format(argv[0], argv[++i]);
+			} else if (strcmp(argv[i], "-j") != 0 &&
+				   strcmp(argv[i], "--all") != 0) {
+				usage(basename(argv[0]));
+			}
+		}
+		acct_open(&db, ACCT_PASSWD | ACCT_GROUP | ACCT_SHADOW);
+		return dump_users(format, skip_password);
+	}
 	if (argc < 3) {
 		usage(basename(argv[0]));
 	}
@@ -390,20 +1125,23 @@ int main(int argc, char *argv[])
 	struct passwd *pw;
 	struct group *gr;
 	struct spwd *sp;
-	int json_output = 0;
+	enum out_format format = OUT_TEXT;
 	int skip_password = 0;
 	int arg_offset = 0;
 
-	// Handle flags for info command
-	if (strcmp(cmd, "info") == 0) {
+	// Handle flags for the info and groups commands
+	if (strcmp(cmd, "info") == 0 || strcmp(cmd, "groups") == 0) {
 		int i = 2;
 		while (i < argc - 1) {	// Leave room for username
 			if (strcmp(argv[i], "-j") == 0) {
-				json_output = 1;
+				format = OUT_JSON;
 				arg_offset++;
 			} else if (strcmp(argv[i], "-i") == 0) {
 				skip_password = 1;
 				arg_offset++;
+			} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc - 1) {
+				format = parse_format(argv[0], argv[++i]);
+				arg_offset += 2;
 			} else {
 				break;
 			}
@@ -417,14 +1155,17 @@ int main(int argc, char *argv[])
 	// Get username from correct position
 	username = argv[2 + arg_offset];
 
-	pw = getpwnam(username);
+	// Map the account files once for every lookup below
+	acct_open(&db, ACCT_PASSWD | ACCT_GROUP | ACCT_SHADOW);
+
+	pw = acct_getpwnam(&db, username);
 	if (pw == NULL) {
 		fprintf(stderr, "User '%s' not found\n", username);
 		return 1;
 	}
 
 	if (strcmp(cmd, "info") == 0) {
-		print_user_info(username, json_output, skip_password);
+		print_user_info(username, format, skip_password);
 	} else if (strcmp(cmd, "home") == 0) {
 		printf("%s\n", pw->pw_dir);
 	} else if (strcmp(cmd, "shell") == 0) {
@@ -436,12 +1177,12 @@ int main(int argc, char *argv[])
 	} else if (strcmp(cmd, "gid") == 0) {
 		printf("%u\n", pw->pw_gid);
 	} else if (strcmp(cmd, "group") == 0) {
-		gr = getgrgid(pw->pw_gid);
+		gr = acct_getgrgid(&db, pw->pw_gid);
 		if (gr != NULL) {
 			printf("%s\n", gr->gr_name);
 		}
 	} else if (strcmp(cmd, "groups") == 0) {
-		print_groups(username, pw->pw_gid);
+		print_groups(username, pw->pw_gid, format);
 	} else if (strcmp(cmd, "passwd") == 0 || strcmp(cmd, "days") == 0) {
 		if (getuid() != 0) {
 			fprintf(stderr,
@@ -449,7 +1190,7 @@ int main(int argc, char *argv[])
 			return 1;
 		}
 
-		sp = getspnam(username);
+		sp = acct_getspnam(&db, username);
 		if (sp == NULL) {
 			fprintf(stderr, "Failed to get shadow entry for '%s'\n",
 				username);
@@ -495,5 +1236,9 @@ int main(int argc, char *argv[])
 		usage(basename(argv[0]));
 	}
 
+	if (out_flush(&out) < 0) {
+		fprintf(stderr, "Failed to write output\n");
+		return 1;
+	}
 	return 0;
 }